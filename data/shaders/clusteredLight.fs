@@ -0,0 +1,142 @@
+#version 440
+
+// Cluster grid, must match ClusteredLighting
+const uint CLUSTER_X = 16;
+const uint CLUSTER_Y = 9;
+const uint CLUSTER_Z = 24;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 64;
+
+struct PointLight
+{
+    vec4 position; // w = radius
+    vec4 color;
+};
+
+// Camera uniform block
+layout(std140, binding = 0) uniform CameraBlock
+{
+    mat4 viewProj;
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+    vec2 resolution;
+    mat4 invViewProj;
+};
+
+// Persistent light pool
+layout(std430, binding = 2) readonly buffer LightBlock
+{
+    PointLight lights[];
+};
+
+// Per cluster light count + fixed size lists of pool indices
+layout(std430, binding = 3) readonly buffer ClusterBlock
+{
+    uint clusterCounts[CLUSTER_COUNT];
+    uint clusterLights[];
+};
+
+// Geometry buffer textures
+layout(binding = 0) uniform sampler2D gPos;
+layout(binding = 1) uniform sampler2D gNorm;
+layout(binding = 2) uniform sampler2D gColorSpec;
+
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Depth texture, only read with the compact geometry buffer
+layout(binding = 4) uniform sampler2D gDepth;
+
+// Octahedral normal decoding for the compact geometry buffer
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// World space position of a pixel, reconstructed from depth with the compact geometry buffer
+vec3 ReadPosition(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gPos, texCoords).xyz;
+
+    vec4 ndc = vec4(texCoords * 2.0 - 1.0, texture(gDepth, texCoords).r * 2.0 - 1.0, 1.0);
+    vec4 world = invViewProj * ndc;
+    return world.xyz / world.w;
+}
+
+// World space normal of a pixel
+vec3 ReadNormal(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gNorm, texCoords).xyz;
+    return OctDecode(texture(gNorm, texCoords).rg);
+}
+
+// Depth slicing
+uniform float clusterNear;
+uniform float clusterFar;
+
+in vec2 texCoords;
+
+out vec4 outColor;
+
+void main()
+{
+    // Skip empty pixels (sky), they have no normal / are at the far plane
+    if (compactGBuffer == 0)
+    {
+        vec3 storedNorm = texture(gNorm, texCoords).xyz;
+        if (dot(storedNorm, storedNorm) < 0.25) discard;
+    }
+    else if (texture(gDepth, texCoords).r >= 1.0) discard;
+
+    // Grab data from geometry buffer
+    vec3 fragPos = ReadPosition(texCoords);
+    vec3 fragNorm = ReadNormal(texCoords);
+    vec4 colorSpec = texture(gColorSpec, texCoords);
+    vec3 fragAlbedo = colorSpec.rgb;
+
+    // Constant material properties, same as the light volume pass
+    float specularStrength = colorSpec.a;
+    float shininess = 128;
+
+    // Find the cluster this pixel belongs to
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    uvec2 tile = min(uvec2(texCoords * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    uint slice = uint(clamp(floor(log(depth / clusterNear) / log(clusterFar / clusterNear) * CLUSTER_Z), 0.0, CLUSTER_Z - 1));
+    uint cluster = tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+
+    vec3 viewDir = normalize(cameraPos.xyz - fragPos);
+    vec3 result = vec3(0.0);
+
+    // Shade with each light in the cluster
+    uint count = clusterCounts[cluster];
+    uint listStart = cluster * MAX_LIGHTS_PER_CLUSTER;
+    for (uint i = 0; i < count; i++)
+    {
+        PointLight light = lights[clusterLights[listStart + i]];
+        vec3 lightDir = normalize(light.position.xyz - fragPos);
+
+        // Diffuse lighting
+        float diffuseAmount = max(dot(fragNorm, lightDir), 0);
+        vec3 diffuse = diffuseAmount * light.color.rgb * fragAlbedo;
+
+        // Specular reflections
+        vec3 halfDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(fragNorm, halfDir), 0), shininess);
+        vec3 specular = specularStrength * spec * light.color.rgb;
+
+        // Attenuation
+        float attenuation = clamp(1.0 - distance(fragPos, light.position.xyz) / light.position.w, 0.0, 1.0);
+        attenuation *= attenuation;
+
+        result += (diffuse + specular) * attenuation;
+    }
+
+    outColor = vec4(result, 1.0);
+}
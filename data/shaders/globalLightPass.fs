@@ -19,6 +19,7 @@ layout(std140, binding = 0) uniform CameraBlock
     mat4 proj;
     vec4 cameraPos;
     vec2 resolution;
+    mat4 invViewProj;
 };
 
 // Lighting uniform block
@@ -28,10 +29,16 @@ layout(std140, binding = 2) uniform GlobalLightBlock
     float ambient;
 };
 
+// Shadow cascades, must match ShadowCascades
+const int MAX_CASCADES = 3;
+
 // Light space uniform block
+// cascadeCount is 0 when shadows are disabled
 layout(std140, binding = 5) uniform LightSpaceBlock
 {
-    mat4 lightViewProj;
+    mat4 lightViewProj[MAX_CASCADES];
+    vec4 cascadeTexelScales;
+    int cascadeCount;
 };
 
 // Geometry buffer textures
@@ -39,7 +46,42 @@ layout(binding = 0) uniform sampler2D gPos;
 layout(binding = 1) uniform sampler2D gNorm;
 layout(binding = 2) uniform sampler2D gColorSpec;
 
-// Shadow depth map texture
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Depth texture, only read with the compact geometry buffer
+layout(binding = 4) uniform sampler2D gDepth;
+
+// Octahedral normal decoding for the compact geometry buffer
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// World space position of a pixel, reconstructed from depth with the compact geometry buffer
+vec3 ReadPosition(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gPos, texCoords).xyz;
+
+    vec4 ndc = vec4(texCoords * 2.0 - 1.0, texture(gDepth, texCoords).r * 2.0 - 1.0, 1.0);
+    vec4 world = invViewProj * ndc;
+    return world.xyz / world.w;
+}
+
+// World space normal of a pixel
+vec3 ReadNormal(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gNorm, texCoords).xyz;
+    return OctDecode(texture(gNorm, texCoords).rg);
+}
+
+// Shadow depth atlas, one square per cascade
 layout(binding = 3) uniform sampler2D shadowMap;
 
 in vec2 texCoords;
@@ -49,8 +91,8 @@ out vec4 outColor;
 void main()
 {
     // Grab data from geometry buffer
-    vec4 fragPos = texture(gPos, texCoords);
-    vec3 fragNorm = texture(gNorm, texCoords).xyz;
+    vec4 fragPos = vec4(ReadPosition(texCoords), 1.0);
+    vec3 fragNorm = ReadNormal(texCoords);
     vec4 colorSpec = texture(gColorSpec, texCoords);
     vec3 fragAlbedo = colorSpec.rgb;
 
@@ -77,16 +119,23 @@ void main()
     float specLight = pow(max(dot(fragNorm, lightHalfDir), 0), shininess);
     vec3 specular = specularStrength * (specLight * lightColor * influence);
 
-    // Transform fragment position to light space and project
-    vec4 posLightSpace = lightViewProj * vec4(fragPos.xyz, 1.0);
-    vec3 projCoords = posLightSpace.xyz / posLightSpace.w * 0.5 + 0.5;
-    float closest = texture(shadowMap, projCoords.xy).r;
-    float current = projCoords.z;
-
-    // Calculate final shadow value
+    // Find the smallest cascade containing the fragment, then compare against its square of the shadow atlas
     // NOTE: Ensures we don't shadow any surface facing away from the light
-    float bias = max(MIN_SHADOW_BIAS, MAX_SHADOW_BIAS * (1.0 - alignment));
-    float shadow = alignment < 0.001 ? 0.0 : (current < 1.0 && current - bias > closest) ? 0.5 : 0.0;
+    float shadow = 0.0;
+    for (int i = 0; i < cascadeCount; i++)
+    {
+        vec4 posLightSpace = lightViewProj[i] * vec4(fragPos.xyz, 1.0);
+        vec3 projCoords = posLightSpace.xyz / posLightSpace.w * 0.5 + 0.5;
+
+        // Stay half a texel inside so samples never bleed into the neighbouring cascade
+        vec2 margin = 0.5 / vec2(textureSize(shadowMap, 0)) * vec2(MAX_CASCADES, 1.0);
+        if (any(lessThan(projCoords.xy, margin)) || any(greaterThan(projCoords.xy, 1.0 - margin)) || projCoords.z >= 1.0) continue;
+
+        float closest = texture(shadowMap, vec2((projCoords.x + i) / MAX_CASCADES, projCoords.y)).r;
+        float bias = max(MIN_SHADOW_BIAS, MAX_SHADOW_BIAS * (1.0 - alignment)) * cascadeTexelScales[i];
+        shadow = alignment < 0.001 ? 0.0 : (projCoords.z - bias > closest) ? 0.5 : 0.0;
+        break;
+    }
 
     // Final color composition
     outColor = vec4(((ambient + diffuse) * fragAlbedo + specular) * (1.0 - shadow), 1.0);
@@ -7,6 +7,20 @@ layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoords;
 
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Octahedral normal encoding for the compact geometry buffer
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
 // Geometry buffer outputs
 layout(location = 0) out vec3 gPos;
 layout(location = 1) out vec3 gNorm;
@@ -16,6 +30,7 @@ void main()
 {
     // Store geometry data in gBuffer
     gPos = fragPos;
-    gNorm = normalize(normal);
+    vec3 n = normalize(normal);
+    gNorm = compactGBuffer != 0 ? vec3(OctEncode(n), 0.0) : n;
     gColorSpec = texture(tex, texCoords);
 }
\ No newline at end of file
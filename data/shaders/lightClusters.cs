@@ -0,0 +1,110 @@
+#version 440
+
+// Cluster grid, must match ClusteredLighting
+const uint CLUSTER_X = 16;
+const uint CLUSTER_Y = 9;
+const uint CLUSTER_Z = 24;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 64;
+
+// One invocation per cluster, lights are loaded into shared memory one batch at a time
+layout(local_size_x = 64) in;
+
+struct PointLight
+{
+    vec4 position; // w = radius
+    vec4 color;
+};
+
+// Camera uniform block
+layout(std140, binding = 0) uniform CameraBlock
+{
+    mat4 viewProj;
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+    vec2 resolution;
+};
+
+// Persistent light pool
+layout(std430, binding = 2) readonly buffer LightBlock
+{
+    PointLight lights[];
+};
+
+// Pool indices of the lights visible this frame
+layout(std430, binding = 4) readonly buffer VisibleLightBlock
+{
+    uint lightCount;
+    uint visibleLights[];
+};
+
+// Per cluster light count + fixed size lists of pool indices
+layout(std430, binding = 3) writeonly buffer ClusterBlock
+{
+    uint clusterCounts[CLUSTER_COUNT];
+    uint clusterLights[];
+};
+
+// Depth slicing
+uniform float cameraNear;
+uniform float clusterNear;
+uniform float clusterFar;
+
+// Current batch of lights in view space (xyz = center, w = radius) + their pool indices
+shared vec4 batch[64];
+shared uint batchIndices[64];
+
+// View space depth of the near side of a slice, the first slice always starts at the camera's near plane
+float SliceDepth(uint slice)
+{
+    if (slice == 0) return cameraNear;
+    return clusterNear * pow(clusterFar / clusterNear, float(slice) / float(CLUSTER_Z));
+}
+
+void main()
+{
+    uint cluster = gl_GlobalInvocationID.x;
+    bool active = cluster < CLUSTER_COUNT;
+    uvec3 id = uvec3(cluster % CLUSTER_X, (cluster / CLUSTER_X) % CLUSTER_Y, cluster / (CLUSTER_X * CLUSTER_Y));
+
+    // View space bounds of the cluster, built from the tile's corner rays at both slice depths
+    vec2 scale = 1.0 / vec2(proj[0][0], proj[1][1]);
+    vec2 tileMin = (vec2(id.xy) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0) * scale;
+    vec2 tileMax = (vec2(id.xy + 1) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0) * scale;
+    float nearDepth = SliceDepth(id.z);
+    float farDepth = SliceDepth(id.z + 1);
+    vec3 boundsMin = vec3(min(tileMin * nearDepth, tileMin * farDepth), -farDepth);
+    vec3 boundsMax = vec3(max(tileMax * nearDepth, tileMax * farDepth), -nearDepth);
+
+    uint count = 0;
+    uint listStart = cluster * MAX_LIGHTS_PER_CLUSTER;
+
+    for (uint batchStart = 0; batchStart < lightCount; batchStart += 64)
+    {
+        // Each invocation transforms one light of the batch
+        uint index = batchStart + gl_LocalInvocationIndex;
+        if (index < lightCount)
+        {
+            PointLight light = lights[visibleLights[index]];
+            batch[gl_LocalInvocationIndex] = vec4((view * vec4(light.position.xyz, 1.0)).xyz, light.position.w);
+            batchIndices[gl_LocalInvocationIndex] = visibleLights[index];
+        }
+        barrier();
+
+        // Sphere / box test against every light in the batch
+        uint batchSize = min(64u, lightCount - batchStart);
+        for (uint i = 0; active && i < batchSize; i++)
+        {
+            vec3 offset = clamp(batch[i].xyz, boundsMin, boundsMax) - batch[i].xyz;
+            if (dot(offset, offset) <= batch[i].w * batch[i].w && count < MAX_LIGHTS_PER_CLUSTER)
+            {
+                clusterLights[listStart + count] = batchIndices[i];
+                count++;
+            }
+        }
+        barrier();
+    }
+
+    if (active) clusterCounts[cluster] = count;
+}
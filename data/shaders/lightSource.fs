@@ -7,6 +7,20 @@ layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 texCoords1;
 layout(location = 4) in vec2 texCoords2;
 
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Octahedral normal encoding for the compact geometry buffer
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
 // Geometry buffer outputs
 layout(location = 0) out vec3 gPos;
 layout(location = 1) out vec3 gNorm;
@@ -20,6 +34,6 @@ void main()
     // NOTE: Since all point lights are directly below the bulbs,
     // we can just pretend the normals all face down to get more
     // even lighting across the surface of the bulb.
-    gNorm = vec3(0.0, -1.0, 0.0);
+    gNorm = compactGBuffer != 0 ? vec3(OctEncode(vec3(0.0, -1.0, 0.0)), 0.0) : vec3(0.0, -1.0, 0.0);
     gColorSpec = vec4(1.0);
 }
\ No newline at end of file
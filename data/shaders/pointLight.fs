@@ -8,6 +8,7 @@ layout(std140, binding = 0) uniform CameraBlock
     mat4 proj;
     vec4 cameraPos;
     vec2 resolution;
+    mat4 invViewProj;
 };
 
 // Geometry buffer textures
@@ -15,6 +16,41 @@ layout(binding = 0) uniform sampler2D gPos;
 layout(binding = 1) uniform sampler2D gNorm;
 layout(binding = 2) uniform sampler2D gColorSpec;
 
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Depth texture, only read with the compact geometry buffer
+layout(binding = 4) uniform sampler2D gDepth;
+
+// Octahedral normal decoding for the compact geometry buffer
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// World space position of a pixel, reconstructed from depth with the compact geometry buffer
+vec3 ReadPosition(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gPos, texCoords).xyz;
+
+    vec4 ndc = vec4(texCoords * 2.0 - 1.0, texture(gDepth, texCoords).r * 2.0 - 1.0, 1.0);
+    vec4 world = invViewProj * ndc;
+    return world.xyz / world.w;
+}
+
+// World space normal of a pixel
+vec3 ReadNormal(vec2 texCoords)
+{
+    if (compactGBuffer == 0) return texture(gNorm, texCoords).xyz;
+    return OctDecode(texture(gNorm, texCoords).rg);
+}
+
 // Vertex inputs
 layout(location = 0) flat in vec4 lightPos;
 layout(location = 1) flat in vec4 lightColor;
@@ -28,8 +64,8 @@ void main()
     vec2 texCoords = gl_FragCoord.xy / resolution;
 
     // Grab data from geometry buffer
-    vec3 fragPos = texture(gPos, texCoords).xyz;
-    vec3 fragNorm = texture(gNorm, texCoords).xyz;
+    vec3 fragPos = ReadPosition(texCoords);
+    vec3 fragNorm = ReadNormal(texCoords);
     vec4 colorSpec = texture(gColorSpec, texCoords);
     vec3 fragAlbedo = colorSpec.rgb;
 
@@ -1,7 +1,5 @@
 #version 440
 
-const int MAX_INSTANCES = 512;
-
 // Light structure
 struct PointLight
 {
@@ -19,10 +17,16 @@ layout(std140, binding = 0) uniform CameraBlock
     vec2 resolution;
 };
 
-// Instance uniform block
-layout(std140, binding = 1) uniform InstanceBlock
+// Persistent light pool
+layout(std430, binding = 2) readonly buffer LightBlock
+{
+    PointLight lights[];
+};
+
+// Pool index of each instance
+layout(std430, binding = 1) readonly buffer InstanceBlock
 {
-    PointLight lights[MAX_INSTANCES];
+    uint lightIndices[];
 };
 
 // Vertex data
@@ -35,7 +39,7 @@ layout(location = 1) flat out vec4 lightColor;
 void main()
 {
     // Grab the current light instance
-    PointLight light = lights[gl_InstanceID];
+    PointLight light = lights[lightIndices[gl_InstanceID]];
 
     // Scale vertex position by instance radius
     gl_Position = viewProj * vec4(light.position.xyz + (vPos * light.position.w), 1.0);
@@ -2,11 +2,8 @@
 
 layout (location = 0) in vec3 vPos;
 
-// Light space uniform block
-layout(std140, binding = 5) uniform LightSpaceBlock
-{
-    mat4 viewProj;
-};
+// View projection of the shadow cascade being rendered
+uniform mat4 viewProj;
 
 void main()
 {
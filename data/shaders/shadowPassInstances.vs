@@ -1,10 +1,7 @@
 #version 440
 
-// Light space uniform block
-layout(std140, binding = 5) uniform LightSpaceBlock
-{
-    mat4 viewProj;
-};
+// View projection of the shadow cascade being rendered
+uniform mat4 viewProj;
 
 layout(std140, binding = 1) buffer InstanceBlock
 {
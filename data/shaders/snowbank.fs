@@ -3,9 +3,22 @@
 const float SNOW_DRIFTINESS = 0.6;
 
 in vec3 fragPos;
-in vec4 fragColor;
 in vec3 fragNorm;
 
+// Geometry buffer layout
+layout(std140, binding = 6) uniform GBufferBlock
+{
+    int compactGBuffer;
+};
+
+// Octahedral normal encoding for the compact geometry buffer
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
 // Geometry buffer outputs
 layout(location = 0) out vec3 gPos;
 layout(location = 1) out vec3 gNorm;
@@ -15,6 +28,7 @@ void main()
 {
     // Store geometry data in gBuffer
     gPos = fragPos;
-    gNorm = fragNorm;
+    vec3 n = fragNorm;
+    gNorm = compactGBuffer != 0 ? vec3(OctEncode(n), 0.0) : n;
     gColorSpec = vec4(1.0, 1.0, 1.0, 0.45);
 }
\ No newline at end of file
@@ -21,12 +21,12 @@ layout(std430, binding = 1) buffer InstanceSSBO
 // Snowbank height
 uniform float accumulationHeight;
 
-in vec3 vPos;
-in vec4 vColor;
-in vec3 vNorm;
+// Vertex data inputs
+// NOTE: The model is imported as POS_NORM, it has no vertex colors or UVs
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNorm;
 
 out vec3 fragPos;
-out vec4 fragColor;
 out vec3 fragNorm;
 
 // Function declarations
@@ -49,7 +49,6 @@ void main()
 
     // Send fragment outputs
     fragPos = pos;
-    fragColor = vColor;
     fragNorm = normalize(vNorm + vec3(offset, 0.0, 0.0));
 }
 
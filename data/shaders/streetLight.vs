@@ -17,10 +17,10 @@ layout(std430, binding = 1) buffer InstanceSSBO
 };
 
 // Vertex data inputs
-in vec3 vPos;
-in vec3 vColor;
-in vec3 vNorm;
-in vec2 vUv1;
+// NOTE: The model is imported as POS_NORM_UV, it has no vertex colors
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNorm;
+layout(location = 2) in vec2 vUv1;
 
 // Per-fragment outputs
 layout(location = 0) out vec3 fragPos;
@@ -34,7 +34,7 @@ void main()
 
     // Varying outputs
     fragPos = vPos + instancePosition[gl_InstanceID].xyz;
-    color = vColor;
+    color = vec3(0.0);
     normal = vNorm;
     texCoords1 = vUv1;
 }
\ No newline at end of file
@@ -1,4 +1,14 @@
 #include "app.hpp"
+#include "framesync.hpp"
+#include "glstate.hpp"
+#include "jobsystem.hpp"
+#include "log.hpp"
+#include "textureloader.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -7,13 +17,16 @@ namespace Phi
 {
     void FatalError(const char* const msg) 
     {
-        std::cout << "Fatal Error: " << msg << std::endl;
-        exit(1);
+        PHI_LOG_ERROR("Fatal: ", msg);
+
+        // Skip static destructors, the log writer, job and texture worker threads are still joinable
+        Log::Shutdown();
+        std::_Exit(1);
     }
 
     void Error(const char* const msg)
     {
-        std::cout << "Error: " << msg << std::endl;
+        PHI_LOG_ERROR(msg);
     }
 
     void ErrorCallback(int error, const char* const description)
@@ -24,7 +37,7 @@ namespace Phi
     void MouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
     {
         App* pApp = (App*)glfwGetWindowUserPointer(window);
-        pApp->mouseScroll = {(float)xoffset, (float)yoffset};
+        pApp->mouseScroll += glm::vec2((float)xoffset, (float)yoffset);
     }
 
     void WindowResizeCallback(GLFWwindow* window, int width, int height)
@@ -38,20 +51,35 @@ namespace Phi
 
     App::App(const std::string& name, int glMajVer, int glMinVer) : name(name), wWidth(defaultWidth), wHeight(defaultHeight)
     {
+        Trace::SetThreadName("Main");
+        PHI_TRACE_SCOPE("App Init");
+
+        // Start writing log messages in the background
+        Log::Init();
+
+        // Start the job workers, this thread becomes the main thread
+        JobSystem::Init();
+
         // Initialize GLFW
-        if (!glfwInit()) FatalError("Failed to initialize GLFW");
-        std::cout << "GLFW initialized successfully" << std::endl;
+        {
+            PHI_TRACE_SCOPE("GLFW Init");
+            if (!glfwInit()) FatalError("Failed to initialize GLFW");
+            PHI_LOG_INFO("GLFW initialized successfully");
+        }
 
         // Set callbacks
         glfwSetErrorCallback(ErrorCallback);
 
         // Create window
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glMajVer);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glMinVer);
-        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-        pWindow = glfwCreateWindow(defaultWidth, defaultHeight, name.c_str(), NULL, NULL);
-        if (!pWindow) FatalError("Failed to create window");
+        {
+            PHI_TRACE_SCOPE("Window Creation");
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glMajVer);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glMinVer);
+            glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            pWindow = glfwCreateWindow(defaultWidth, defaultHeight, name.c_str(), NULL, NULL);
+            if (!pWindow) FatalError("Failed to create window");
+        }
 
         // Set other callbacks
         glfwSetScrollCallback(pWindow, MouseScrollCallback);
@@ -65,34 +93,54 @@ namespace Phi
         glfwSwapInterval(0);
 
         // Initialize GLEW
-        GLenum err = glewInit();
-        if (GLEW_OK != err) FatalError((const char*)glewGetErrorString(err));
-        std::cout << "GLEW initialized successfully" << std::endl;
+        {
+            PHI_TRACE_SCOPE("GLEW Init");
+            GLenum err = glewInit();
+            if (GLEW_OK != err) FatalError((const char*)glewGetErrorString(err));
+            PHI_LOG_INFO("GLEW initialized successfully");
+        }
         
         // Output current OpenGL context version
-        std::cout << "OpenGL Context: " << glGetString(GL_VERSION) << std::endl;
+        PHI_LOG_INFO("OpenGL Context: ", glGetString(GL_VERSION));
 
         // Setup Dear ImGui context
+        PHI_TRACE_SCOPE("ImGui Init");
         IMGUI_CHECKVERSION();
         ImGui::CreateContext();
 
         // Setup Dear ImGui Platform/Renderer backends
         ImGui_ImplGlfw_InitForOpenGL(GetWindow(), true);
         ImGui_ImplOpenGL3_Init();
+
+        // Take a first input snapshot so the input helpers work before the first frame
+        PollInput();
     }
 
     App::~App()
     {
+        // Make sure the simulation thread is gone before anything it could touch
+        StopSimulation();
+
+        // Stop texture decoding while the context still exists
+        TextureLoader::Shutdown();
+        JobSystem::Shutdown();
+
         // Shutdown ImGui
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
-        std::cout << "ImGui shutdown successfully" << std::endl;
+        PHI_LOG_INFO("ImGui shutdown successfully");
 
         // De-init GLFW
         glfwDestroyWindow(pWindow);
         glfwTerminate();
-        std::cout << "GLFW terminated successfully" << std::endl;
+        PHI_LOG_INFO("GLFW terminated successfully");
+
+        // Dump everything traced during the run
+        if (Trace::enabled) Trace::Write();
+
+        // Write any remaining log messages
+        Log::Shutdown();
     }
 
     void App::Run()
@@ -122,6 +170,7 @@ namespace Phi
             
             // Poll for inputs
             glfwPollEvents();
+            PollInput();
 
             // Ensure framebuffer has non-zero size
             glfwGetFramebufferSize(pWindow, &wWidth, &wHeight);
@@ -133,17 +182,57 @@ namespace Phi
                 ImGui_ImplGlfw_NewFrame();
                 ImGui::NewFrame();
 
-                // Update and measure time
-                InternalUpdate(elapsedTime);
-                lastUpdate = (glfwGetTime() - currentTime);
-                
-                // Render and measure time
-                Render();
-                lastRender = (glfwGetTime() - lastUpdate - currentTime);
+                // Wait until the GPU is done with this frame's slot of the per-frame buffers
+                FrameSync::BeginFrame();
+
+                // Upload any textures that finished decoding, and run queued OpenGL work
+                TextureLoader::Update();
+                JobSystem::RunMainThreadJobs(mainThreadJobBudget);
+
+                if (pipelined)
+                {
+                    // Publish the frame simulated during the last Render(), then simulate the next one during this one
+                    // NOTE: The simulation measures lastUpdate itself
+                    Sync();
+                    StartSimulation(elapsedTime);
+
+                    double renderStart = glfwGetTime();
+                    Render();
+                    float renderTime = (float)(glfwGetTime() - renderStart);
+
+                    {
+                        PHI_TRACE_SCOPE("Wait For Simulation");
+                        WaitForSimulation();
+                    }
+                    lastRender = renderTime;
+                }
+                else
+                {
+                    // Update and measure time
+                    InternalUpdate(elapsedTime);
+                    lastUpdate = (glfwGetTime() - currentTime);
+                    
+                    // Render and measure time
+                    Sync();
+                    Render();
+                    lastRender = (glfwGetTime() - lastUpdate - currentTime);
+                }
 
                 // Finish ImGui rendering
                 ImGui::Render();
                 ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+                FrameSync::EndFrame();
+
+                // Apply cursor changes requested during the simulation
+                if (cursorMode)
+                {
+                    glfwSetInputMode(pWindow, GLFW_CURSOR, cursorMode);
+                    cursorMode = 0;
+                }
+
+                // ImGui changes state behind the cache's back, and the call counters are per frame
+                GLState::NewFrame();
+                JobSystem::NewFrame();
             }
 
             // Update samples
@@ -158,34 +247,129 @@ namespace Phi
                 sampleAccum -= sampleRate;
             }
 
-            // Reset mouse scroll
-            mouseScroll = glm::vec2(0.0f, 0.0f);
             glfwSwapBuffers(pWindow);
         }
+
+        StopSimulation();
     }
 
-    bool App::IsKeyDown(int key) const { return glfwGetKey(pWindow,key) == GLFW_PRESS; };
-    bool App::IsKeyJustDown(int key) const { return glfwGetKey(pWindow,key) == GLFW_PRESS && !keysDownLastFrame[key - GLFW_KEY_SPACE]; };
+    bool App::IsKeyDown(int key) const { return keysDown[key - GLFW_KEY_SPACE]; };
+    bool App::IsKeyJustDown(int key) const { return keysDown[key - GLFW_KEY_SPACE] && !keysDownLastFrame[key - GLFW_KEY_SPACE]; };
 
-    bool App::IsLMBDown() const { return glfwGetMouseButton(pWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS; };
-    bool App::IsRMBDown() const { return glfwGetMouseButton(pWindow, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS; };
-    bool App::IsMMBDown() const { return glfwGetMouseButton(pWindow, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS; };
+    bool App::IsLMBDown() const { return buttonsDown[GLFW_MOUSE_BUTTON_LEFT]; };
+    bool App::IsRMBDown() const { return buttonsDown[GLFW_MOUSE_BUTTON_RIGHT]; };
+    bool App::IsMMBDown() const { return buttonsDown[GLFW_MOUSE_BUTTON_MIDDLE]; };
 
-    glm::vec2 App::GetMousePos() const
+    glm::vec2 App::GetMousePos() const { return mousePos; };
+
+    // Samples the keyboard and mouse, so the simulation never has to call GLFW
+    void App::PollInput()
     {
+        for (int i = 0; i < NUM_KEYS; ++i)
+        {
+            keysDown[i] = glfwGetKey(pWindow, GLFW_KEY_SPACE + i) == GLFW_PRESS;
+        }
+        for (int i = 0; i < NUM_BUTTONS; ++i)
+        {
+            buttonsDown[i] = glfwGetMouseButton(pWindow, i) == GLFW_PRESS;
+        }
+
         double xpos, ypos;
         glfwGetCursorPos(pWindow, &xpos, &ypos);
-        return glm::vec2((float)xpos, (float)ypos);
+        mousePos = glm::vec2((float)xpos, (float)ypos);
     }
 
+    // Runs the simulation steps for a frame, then builds the GUI
     void App::InternalUpdate(float delta)
+    {
+        if (fixedTimestep > 0.0f)
+        {
+            // Run every whole step that fits, the remainder carries over to the next frame
+            stepAccumulator += delta;
+            int steps = 0;
+            while (stepAccumulator >= fixedTimestep && steps < maxStepsPerFrame)
+            {
+                Step(fixedTimestep);
+                stepAccumulator -= fixedTimestep;
+                steps++;
+            }
+
+            // Drop whatever couldn't be caught up on instead of falling further behind every frame
+            if (stepAccumulator >= fixedTimestep) stepAccumulator = std::fmod(stepAccumulator, fixedTimestep);
+            interpolation = stepAccumulator / fixedTimestep;
+        }
+        else
+        {
+            stepAccumulator = 0.0f;
+            Step(delta);
+            interpolation = 1.0f;
+        }
+
+        UpdateGUI();
+    }
+
+    void App::Step(float delta)
     {
         Update(delta);
 
-        // Update keys from last frame
-        for (int i = 0; i < NUM_KEYS; ++i)
+        // Key presses and scrolling are only seen by the first step after they happen
+        std::copy(std::begin(keysDown), std::end(keysDown), std::begin(keysDownLastFrame));
+        mouseScroll = glm::vec2(0.0f, 0.0f);
+    }
+
+    // Simulation thread entrypoint, runs one frame every time StartSimulation() is called
+    void App::SimulationLoop()
+    {
+        Trace::SetThreadName("Simulation");
+
+        std::unique_lock<std::mutex> lock(simMutex);
+        while (true)
+        {
+            simCondition.wait(lock, [this]() { return simPending || simStopping; });
+            if (simStopping) return;
+
+            lock.unlock();
+            {
+                PHI_TRACE_SCOPE("Simulation");
+                double startTime = glfwGetTime();
+                InternalUpdate(simDelta);
+                lastUpdate = (float)(glfwGetTime() - startTime);
+            }
+            lock.lock();
+
+            simPending = false;
+            simCondition.notify_all();
+        }
+    }
+
+    void App::StartSimulation(float delta)
+    {
+        // Spawned on first use, so apps that never enable pipelining don't pay for the thread
+        if (!simThread.joinable()) simThread = std::thread(&App::SimulationLoop, this);
+
+        {
+            std::lock_guard<std::mutex> lock(simMutex);
+            simDelta = delta;
+            simPending = true;
+        }
+        simCondition.notify_all();
+    }
+
+    void App::WaitForSimulation()
+    {
+        std::unique_lock<std::mutex> lock(simMutex);
+        simCondition.wait(lock, [this]() { return !simPending; });
+    }
+
+    void App::StopSimulation()
+    {
+        if (!simThread.joinable()) return;
+
         {
-            keysDownLastFrame[i] = IsKeyDown(GLFW_KEY_SPACE + i);
+            std::lock_guard<std::mutex> lock(simMutex);
+            simStopping = true;
         }
+        simCondition.notify_all();
+        simThread.join();
     }
 }
\ No newline at end of file
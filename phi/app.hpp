@@ -1,7 +1,10 @@
 #pragma once
 
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define GLEW_NO_GLU
@@ -28,6 +31,9 @@ namespace Phi
     void Error(const char* const msg);
 
     // Main app class, handles OpenGL context creation and input
+    // Every frame runs Update() (simulation), UpdateGUI(), then Sync() and Render() on the main thread
+    // In pipelined mode, Update() and UpdateGUI() for the next frame run on a simulation thread while
+    // Render() draws the current one, Sync() is the only point where both sides may touch shared state
     class App
     {
         public:
@@ -39,10 +45,21 @@ namespace Phi
             virtual void Update(float delta) = 0;
             virtual void Render() = 0;
 
+            // Builds ImGui windows, called once per frame after Update()
+            virtual void UpdateGUI() {};
+
+            // Hands the simulation's state over to the renderer, called on the main thread
+            // while neither the simulation nor Render() are running
+            virtual void Sync() {};
+
             // Accessors
             GLFWwindow* GetWindow() const { return pWindow; };
             glm::vec2 GetWindowSize() const { return {wWidth, wHeight}; };
 
+            // How far the current frame is between the last two fixed steps, in [0, 1)
+            // Always 1 without a fixed timestep
+            float GetInterpolation() const { return interpolation; };
+
         protected:
 
             // App details
@@ -70,6 +87,19 @@ namespace Phi
             static inline float sampleRate = 1.0f / perfSamplesPerSecond;
             static inline float fpsUpdateRate = 1.0f / 2.0f;
 
+            // Time per frame spent on main thread jobs (JobSystem::RunOnMainThread()), in ms
+            float mainThreadJobBudget = 2.0f;
+
+            // Frame pipelining
+            // NOTE: When pipelined, Update() and UpdateGUI() must not touch OpenGL or GLFW directly,
+            // the input helpers below are safe since they read a snapshot taken on the main thread
+            bool pipelined = false;
+
+            // When > 0, Update() is called with this delta instead, as many times as fit into the elapsed time
+            // Steps that can't be caught up on after maxStepsPerFrame are dropped
+            float fixedTimestep = 0.0f;
+            int maxStepsPerFrame = 8;
+
             // Input helpers
             bool IsKeyDown(int key) const;
             bool IsKeyJustDown(int key) const;
@@ -79,15 +109,43 @@ namespace Phi
             glm::vec2 GetMousePos() const;
             glm::vec2 GetMouseScroll() const { return mouseScroll; };
 
+            // Shows / captures the cursor once the frame's simulation has finished
+            void SetCursorMode(int mode) { cursorMode = mode; };
+
         private:
             
             // Internal methods
             void InternalUpdate(float delta);
+            void Step(float delta);
+            void PollInput();
+
+            // Simulation thread (pipelined mode)
+            // The main thread hands it one frame at a time and waits for it before the next Sync()
+            void SimulationLoop();
+            void StartSimulation(float delta);
+            void WaitForSimulation();
+            void StopSimulation();
+            std::thread simThread;
+            std::mutex simMutex;
+            std::condition_variable simCondition;
+            bool simPending = false;
+            bool simStopping = false;
+            float simDelta = 0.0f;
+
+            // Fixed timestep state
+            float stepAccumulator = 0.0f;
+            float interpolation = 1.0f;
 
             // Internal input handling data
-            glm::vec2 mouseScroll;
+            // NOTE: Sampled once per frame on the main thread, scroll accumulates until a step consumes it
+            glm::vec2 mouseScroll{0.0f};
+            glm::vec2 mousePos{0.0f};
             static const int NUM_KEYS = GLFW_KEY_LAST - GLFW_KEY_SPACE;
+            static const int NUM_BUTTONS = GLFW_MOUSE_BUTTON_LAST + 1;
+            bool keysDown[NUM_KEYS] = { false };
             bool keysDownLastFrame[NUM_KEYS] = { false };
+            bool buttonsDown[NUM_BUTTONS] = { false };
+            int cursorMode = 0;
 
             // Friends who should have access to private data
             friend void WindowResizeCallback(GLFWwindow* window, int width, int height);
@@ -4,7 +4,7 @@ namespace Phi
 {
     // Constructor
     Camera::Camera() : position(0), direction(0, 0, -1), up(0, 1, 0), right(1, 0, 0),
-                        ubo(BufferType::Dynamic, UBO_SIZE)
+                        ubo(BufferType::DynamicPerFrame, UBO_FRAME_SIZE)
     {
         // Bind UBO to binding point 0
         ubo.BindBase(GL_UNIFORM_BUFFER, 0);
@@ -47,6 +47,15 @@ namespace Phi
         UpdateView();
     }
 
+    // Sets the camera's yaw and pitch in degrees, then updates the view matrix
+    void Camera::SetRotation(float yaw, float pitch)
+    {
+        this->yaw = yaw;
+        this->pitch = glm::clamp(pitch, -89.0f, 89.0f);
+
+        UpdateView();
+    }
+
     // Zooms the camera by amount, updating the projection matrix
     void Camera::Zoom(float amount)
     {
@@ -99,8 +108,9 @@ namespace Phi
         // Combine view and projection into one matrix
         glm::mat4 viewProj = proj * view;
 
-        // Ensure we don't write when commands are reading
-        ubo.Sync();
+        // Reserve space in this frame's section of the UBO
+        GLintptr offset = ubo.Allocate(UBO_SIZE);
+        if (offset < 0) return;
 
         // Write camera matrix data to UBO
         ubo.Write(viewProj);
@@ -108,9 +118,9 @@ namespace Phi
         ubo.Write(proj);
         ubo.Write(glm::vec4(position, 1));
         ubo.Write(glm::vec4(width, height, 0.0f, 0.0f));
-        ubo.SwapSections();
+        ubo.Write(glm::inverse(viewProj));
 
         // Bind UBO to binding point 0
-        ubo.BindRange(GL_UNIFORM_BUFFER, 0, UBO_SIZE * ubo.GetCurrentSection(), UBO_SIZE);
+        ubo.BindRange(GL_UNIFORM_BUFFER, 0, offset, UBO_SIZE);
     }
 }
\ No newline at end of file
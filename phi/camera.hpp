@@ -7,6 +7,7 @@
 
 #include <GL/glew.h> // OpenGL types / functions
 
+#include "frustum.hpp"
 #include "gpubuffer.hpp"
 
 namespace Phi
@@ -34,6 +35,7 @@ namespace Phi
 
             // View manipulation
             void Rotate(float yawOffset, float pitchOffset);
+            void SetRotation(float yaw, float pitch);
             void Zoom(float amount);
 
             // Needs to be public so caller can tell the camera when the window size changes
@@ -50,7 +52,17 @@ namespace Phi
             inline const glm::vec3& GetRight() const { return right; };
             inline int GetWidth() const { return width; };
             inline int GetHeight() const { return height; };
+            inline float GetNear() const { return near; };
+            inline float GetFar() const { return far; };
+            inline float GetYaw() const { return yaw; };
+            inline float GetPitch() const { return pitch; };
             inline GPUBuffer& GetUBO() { return ubo; };
+            inline const glm::mat4& GetView() const { return view; };
+            inline const glm::mat4& GetProj() const { return proj; };
+            inline glm::mat4 GetViewProj() const { return proj * view; };
+
+            // Returns the current view frustum in world space, for culling
+            inline Frustum GetFrustum() const { return Frustum(proj * view); };
 
             // Public so ImGUI may directly control camera properties
             float fov = 60.0f;
@@ -84,6 +96,10 @@ namespace Phi
             GPUBuffer ubo;
 
             // Constants
-            static const int UBO_SIZE = sizeof(glm::mat4) * 3 + sizeof(glm::vec4) * 2;
+            // Layout: viewProj, view, proj, position, resolution, inverse viewProj (for reconstructing positions from depth)
+            static const int UBO_SIZE = sizeof(glm::mat4) * 4 + sizeof(glm::vec4) * 2;
+
+            // Room for a few updates per frame, including alignment padding
+            static const int UBO_FRAME_SIZE = 4096;
     };
 }
\ No newline at end of file
@@ -1,37 +1,20 @@
 #include "cubemap.hpp"
+#include "log.hpp"
 
 namespace Phi
 {
     // Constructor
     // faces should contain 6 file paths (relative to project directory)
     // to image files in the order: right, left, top, bottom, front, back
+    // Alternatively, faces can hold a single texture container (.phtex) with all 6 faces, which is loaded immediately
+    // Otherwise the faces are decoded by TextureLoader, until they are uploaded every face is a 1x1 grey placeholder
     Cubemap::Cubemap(const std::vector<std::string>& faces)
     {
         // Generate resources
         glGenTextures(1, &textureID);
 
         // Bind the texture
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-        // Load the face files from the list of filenames
-        int width, height, channelCount;
-        for (unsigned int i = 0; i < faces.size(); i++)
-        {
-            // Load the face image data
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channelCount, STBI_rgb_alpha);
-
-            if (data)
-            {
-                // Send image data to texture target
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-                stbi_image_free(data);
-            }
-            else
-            {
-                stbi_image_free(data);
-                std::cout << "ERROR: Couldn't load cubemap texture: " << faces[i].c_str() << std::endl;
-            }
-        }
+        GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
         // Set default texture parameters
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -40,14 +23,53 @@ namespace Phi
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+        // Pre-baked container, use its mip chain
+        int width, height;
+        bool container = faces.size() == 1 && TextureFile::IsContainer(faces[0]);
+        if (container && TextureLoader::LoadContainer(GL_TEXTURE_CUBE_MAP, faces[0], false, width, height))
+        {
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            GLState::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+            return;
+        }
+
+        // Placeholder faces
+        const unsigned char placeholder[4] = {128, 128, 128, 255};
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        }
+
         // Unbind before returning
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        GLState::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        if (container) return;
+
+        // Replace all faces at once, so the cubemap never has faces of different sizes
+        TextureLoader::Load(this, faces, false, [this](const std::vector<TextureLoader::Image>& images)
+        {
+            for (const TextureLoader::Image& image : images)
+            {
+                if (!image.width || image.width != images[0].width || image.height != images[0].height)
+                {
+                    PHI_LOG_ERROR("Cubemap faces are missing or differ in size");
+                    return;
+                }
+            }
+
+            GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+            for (unsigned int i = 0; i < images.size(); i++)
+            {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, images[i].width, images[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, images[i].data);
+            }
+            GLState::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        });
     }
 
     // Destructor
     Cubemap::~Cubemap()
     {
-        glDeleteTextures(1, &textureID);
+        TextureLoader::Cancel(this);
+        GLState::DeleteTexture(textureID);
     }
 
     // Bind this cubemap's texture to GL_TEXTURE_CUBE_MAP on a given texture unit
@@ -58,12 +80,11 @@ namespace Phi
         // OpenGL 3.x requires a minimum of 16 units per stage
         if (texUnit < 0 || texUnit > 15)
         {
-            std::cout << "ERROR: Invalid texture unit passed to Cubemap::Bind" << std::endl;
+            PHI_LOG_ERROR("Invalid texture unit passed to Cubemap::Bind");
             return;
         }
 
         // Set active unit and bind texture
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        GLState::BindTexture(GL_TEXTURE_CUBE_MAP, textureID, texUnit);
     }
 }
\ No newline at end of file
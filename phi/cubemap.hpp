@@ -5,7 +5,9 @@
 #include <string>
 
 #include <GL/glew.h> // OpenGL types / functions
-#include <stb_image.h>
+
+#include "glstate.hpp"
+#include "textureloader.hpp"
 
 namespace Phi
 {
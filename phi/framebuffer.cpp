@@ -1,4 +1,5 @@
 #include "framebuffer.hpp"
+#include "log.hpp"
 
 namespace Phi
 {
@@ -40,7 +41,7 @@ namespace Phi
 
         if (status != GL_FRAMEBUFFER_COMPLETE)
         {
-            std::cout << "ERROR: Framebuffer incomplete: 0x" << status << std::endl;
+            PHI_LOG_ERROR("Framebuffer incomplete: 0x", status);
             return false;
         }
 
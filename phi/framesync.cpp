@@ -0,0 +1,66 @@
+#include "framesync.hpp"
+
+#include <chrono>
+
+#include "log.hpp"
+#include "trace.hpp"
+
+namespace Phi
+{
+    void FrameSync::BeginFrame()
+    {
+        GLsync& fence = fences[frameIndex];
+        if (!fence) return;
+
+        Wait(fence);
+        glDeleteSync(fence);
+        fence = 0;
+
+        // The slot's last frame is done, and fences signal in order so every frame before it is too
+        completedFrames = frameNumber - FRAMES_IN_FLIGHT + 1;
+    }
+
+    void FrameSync::EndFrame()
+    {
+        if (fences[frameIndex]) glDeleteSync(fences[frameIndex]);
+        fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        lastStallCount = stallCount;
+        lastStallMs = stallMs;
+        stallCount = 0;
+        stallMs = 0.0f;
+
+        frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+        frameNumber++;
+    }
+
+    bool FrameSync::Wait(GLsync sync)
+    {
+        // Most of the time the GPU is already done and there is nothing to wait for
+        GLenum result = glClientWaitSync(sync, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) return true;
+
+        // Flush so the fence is guaranteed to signal, then sleep in the driver until it does
+        if (result != GL_WAIT_FAILED)
+        {
+            PHI_TRACE_SCOPE("GPU Stall");
+            auto startTime = std::chrono::steady_clock::now();
+            result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+            stallMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            stallCount++;
+        }
+
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            PHI_LOG_ERROR("Timed out waiting for the GPU");
+            return false;
+        }
+        if (result == GL_WAIT_FAILED)
+        {
+            PHI_LOG_ERROR("Failed to wait for a fence sync");
+            return false;
+        }
+
+        return true;
+    }
+}
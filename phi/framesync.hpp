@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include <GL/glew.h> // OpenGL types / functions
+
+namespace Phi
+{
+    // Tracks the frames the GPU is still working on
+    // Every frame is fenced once by EndFrame(), and BeginFrame() waits for the frame that last used the same slot,
+    // so per-frame buffers (BufferType::DynamicPerFrame) can write to the current slot's slice without fences of their own
+    // Every fence wait goes through Wait(), which blocks in the driver instead of spinning and measures the stall
+    // NOTE: App calls BeginFrame() / EndFrame() every frame
+    class FrameSync
+    {
+        // Interface
+        public:
+
+            // Static interface only
+            FrameSync() = delete;
+
+            // Frames the CPU may get ahead of the GPU
+            static const int FRAMES_IN_FLIGHT = 3;
+
+            // Waits until the GPU has finished the frame that last used this frame's slot
+            static void BeginFrame();
+
+            // Fences the frame's commands, publishes this frame's stall stats and moves to the next slot
+            static void EndFrame();
+
+            // Blocks until sync is signaled, returns false if the wait failed or timed out
+            // Time spent blocking is counted as a stall
+            static bool Wait(GLsync sync);
+
+            // Accessors
+            static inline int GetFrameIndex() { return frameIndex; };
+            static inline uint64_t GetFrameNumber() { return frameNumber; };
+
+            // Every frame numbered below this is known to be finished on the GPU
+            // NOTE: Data last used by the GPU during frame n can be reused once n < GetCompletedFrames()
+            static inline uint64_t GetCompletedFrames() { return completedFrames; };
+
+            // Number of waits that blocked, and the time spent blocking, during the last complete frame
+            static inline int GetStallCount() { return lastStallCount; };
+            static inline float GetStallTime() { return lastStallMs; };
+
+        // Data / implementation
+        private:
+
+            // Longest a single wait may block before giving up, in nanoseconds
+            static const GLuint64 WAIT_TIMEOUT = 1'000'000'000;
+
+            // One fence per slot
+            static inline GLsync fences[FRAMES_IN_FLIGHT] = {0};
+            static inline int frameIndex = 0;
+            static inline uint64_t frameNumber = 0;
+            static inline uint64_t completedFrames = 0;
+
+            // Stalls during the current / last frame
+            static inline int stallCount = 0;
+            static inline float stallMs = 0.0f;
+            static inline int lastStallCount = 0;
+            static inline float lastStallMs = 0.0f;
+    };
+}
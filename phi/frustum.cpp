@@ -0,0 +1,127 @@
+#include "frustum.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHI_FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Phi
+{
+    // Appends a box to the list
+    void AABBList::Add(const glm::vec3& min, const glm::vec3& max)
+    {
+        minX.push_back(min.x);
+        minY.push_back(min.y);
+        minZ.push_back(min.z);
+        maxX.push_back(max.x);
+        maxY.push_back(max.y);
+        maxZ.push_back(max.z);
+    }
+
+    // Removes all boxes, keeping the allocated memory
+    void AABBList::Clear()
+    {
+        minX.clear();
+        minY.clear();
+        minZ.clear();
+        maxX.clear();
+        maxY.clear();
+        maxZ.clear();
+    }
+
+    // Extracts and normalizes the frustum planes from the rows of viewProj
+    Frustum::Frustum(const glm::mat4& viewProj)
+    {
+        // GLM matrices are column major, so build the rows first
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+        {
+            row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        }
+
+        planes[0] = row[3] + row[0];
+        planes[1] = row[3] - row[0];
+        planes[2] = row[3] + row[1];
+        planes[3] = row[3] - row[1];
+        planes[4] = row[3] + row[2];
+        planes[5] = row[3] - row[2];
+
+        for (glm::vec4& plane : planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    // Tests the corner of the box furthest along each plane's normal (the "positive vertex")
+    // If it is behind any plane, the whole box is outside
+    bool Frustum::Intersects(const glm::vec3& min, const glm::vec3& max) const
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            float distance = glm::max(plane.x * min.x, plane.x * max.x) +
+                             glm::max(plane.y * min.y, plane.y * max.y) +
+                             glm::max(plane.z * min.z, plane.z * max.z) + plane.w;
+
+            if (distance < 0.0f) return false;
+        }
+
+        return true;
+    }
+
+    // Culls a list of boxes against the frustum
+    int Frustum::Cull(const AABBList& boxes, std::vector<uint8_t>& visible) const
+    {
+        size_t count = boxes.Size();
+        visible.resize(count);
+
+        int visibleCount = 0;
+        size_t i = 0;
+
+#ifdef PHI_FRUSTUM_SSE
+        // Same positive vertex test as Intersects(), for 4 boxes at a time
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 minX = _mm_loadu_ps(&boxes.minX[i]);
+            __m128 minY = _mm_loadu_ps(&boxes.minY[i]);
+            __m128 minZ = _mm_loadu_ps(&boxes.minZ[i]);
+            __m128 maxX = _mm_loadu_ps(&boxes.maxX[i]);
+            __m128 maxY = _mm_loadu_ps(&boxes.maxY[i]);
+            __m128 maxZ = _mm_loadu_ps(&boxes.maxZ[i]);
+
+            // All lanes start inside, each plane can only clear lanes
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& plane : planes)
+            {
+                __m128 a = _mm_set1_ps(plane.x);
+                __m128 b = _mm_set1_ps(plane.y);
+                __m128 c = _mm_set1_ps(plane.z);
+
+                __m128 distance = _mm_set1_ps(plane.w);
+                distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(a, minX), _mm_mul_ps(a, maxX)));
+                distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(b, minY), _mm_mul_ps(b, maxY)));
+                distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(c, minZ), _mm_mul_ps(c, maxZ)));
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                uint8_t result = (mask >> lane) & 1;
+                visible[i + lane] = result;
+                visibleCount += result;
+            }
+        }
+#endif
+
+        // Remaining boxes (or all of them without SSE)
+        for (; i < count; i++)
+        {
+            bool result = Intersects({boxes.minX[i], boxes.minY[i], boxes.minZ[i]}, {boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]});
+            visible[i] = result;
+            visibleCount += result;
+        }
+
+        return visibleCount;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Phi
+{
+    // Axis aligned bounding box
+    struct AABB
+    {
+        glm::vec3 min{0.0f};
+        glm::vec3 max{0.0f};
+    };
+
+    // Structure-of-arrays list of axis aligned bounding boxes
+    // Each component is stored contiguously so many boxes can be tested at once with SIMD
+    struct AABBList
+    {
+        std::vector<float> minX, minY, minZ;
+        std::vector<float> maxX, maxY, maxZ;
+
+        void Add(const glm::vec3& min, const glm::vec3& max);
+        void Clear();
+        inline size_t Size() const { return minX.size(); };
+    };
+
+    // View frustum described by 6 normalized planes (ax + by + cz + d >= 0 is inside)
+    // Works for both perspective and orthographic projections
+    class Frustum
+    {
+        // Interface
+        public:
+
+            Frustum() = default;
+
+            // Extracts the planes from a combined view projection matrix (Gribb / Hartmann)
+            Frustum(const glm::mat4& viewProj);
+
+            // Returns true if the box is at least partially inside the frustum
+            bool Intersects(const glm::vec3& min, const glm::vec3& max) const;
+
+            // Tests every box in boxes, visible[i] is set to 1 if box i is at least partially inside
+            // Returns the number of visible boxes
+            // NOTE: Vectorized with SSE when available, 4 boxes are tested per iteration
+            int Cull(const AABBList& boxes, std::vector<uint8_t>& visible) const;
+
+            // Accessors
+            inline const glm::vec4& GetPlane(int index) const { return planes[index]; };
+
+        // Data / implementation
+        private:
+
+            // Left, right, bottom, top, near, far
+            glm::vec4 planes[6]{};
+    };
+}
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "framesync.hpp"
+#include "mesh.hpp"
+#include "gpubuffer.hpp"
+#include "log.hpp"
+#include "vertex.hpp"
+#include "vertexattributes.hpp"
+#include "shader.hpp"
+
+namespace Phi
+{
+    // GPU-resident storage for static meshes that share a vertex format
+    // Meshes are uploaded once with Allocate(), and only a small list of draw commands is
+    // submitted per frame, instead of re-streaming all vertex data like RenderBatch does
+    // Usage:
+    // 1. Create GeometryPool instance with initial capacity (grows automatically if needed)
+    // 2. Allocate() each mesh once, store the returned Allocation
+    // 3. Every Frame:
+    //  a. AddDraw() all the allocations you want to draw
+    //  b. Flush()
+    // 4. Free() allocations when the mesh is no longer needed
+    //
+    // Limitations:
+    // 1. Does not support textures
+    // 2. Meshes must be indexed triangle lists
+    template <typename Vertex>
+    class GeometryPool
+    {
+        // Interface
+        public:
+
+            // Location of a single mesh inside the pool
+            struct Allocation
+            {
+                GLuint firstVertex = 0;
+                GLuint vertexCount = 0;
+                GLuint firstIndex = 0;
+                GLuint indexCount = 0;
+
+                inline bool IsValid() const { return indexCount > 0; };
+            };
+
+            // maxCommands is the number of draw commands per frame, across every Flush() (grows if needed)
+            GeometryPool(size_t maxVertices, size_t maxIndices, size_t maxCommands = 4096);
+            ~GeometryPool();
+
+            // Delete copy constructor/assignment
+            GeometryPool(const GeometryPool&) = delete;
+            GeometryPool& operator=(const GeometryPool&) = delete;
+
+            // Delete move constructor/assignment
+            GeometryPool(GeometryPool&& other) = delete;
+            void operator=(GeometryPool&& other) = delete;
+
+            // Storage methods
+            // NOTE: Freed space is only reused once the GPU has finished all draws issued before Free()
+            Allocation Allocate(const Mesh<Vertex>& mesh);
+            void Free(Allocation& allocation);
+
+            // Rendering methods
+            void AddDraw(const Allocation& allocation);
+            void Flush(const Shader& shader);
+
+            // Accessors
+            inline size_t GetVertexCapacity() const { return maxVertices; };
+            inline size_t GetIndexCapacity() const { return maxIndices; };
+            inline size_t GetUsedVertices() const { return usedVertices; };
+            inline size_t GetUsedIndices() const { return usedIndices; };
+            inline size_t GetSizeInBytes() const { return maxVertices * sizeof(Vertex) + maxIndices * sizeof(GLuint); };
+
+        // Data / implementation
+        private:
+
+            // Matches the layout expected by glMultiDrawElementsIndirect
+            struct DrawCommand
+            {
+                GLuint count;
+                GLuint instanceCount;
+                GLuint firstIndex;
+                GLint baseVertex;
+                GLuint baseInstance;
+            };
+
+            // Ranges freed during a frame, waiting for the GPU to finish it
+            struct RetiredRanges
+            {
+                uint64_t frame = 0;
+                std::vector<Allocation> allocations;
+            };
+
+            // Free list helpers, ranges are stored as offset -> count and coalesced on release
+            static bool TakeRange(std::map<GLuint, GLuint>& freeList, GLuint count, GLuint& offset);
+            static void ReleaseRange(std::map<GLuint, GLuint>& freeList, GLuint offset, GLuint count);
+
+            // Returns retired ranges to the free lists once FrameSync knows their frames are complete
+            void ReclaimRetired();
+
+            // Grows the vertex or index storage to hold at least the given capacity
+            void Grow(size_t newMaxVertices, size_t newMaxIndices);
+            void CreateVertexAttributes();
+
+            // State / stats
+            size_t maxVertices;
+            size_t maxIndices;
+            size_t maxCommands;
+            size_t usedVertices = 0;
+            size_t usedIndices = 0;
+            GLenum mode = GL_TRIANGLES;
+
+            // Allocation state
+            std::map<GLuint, GLuint> freeVertices;
+            std::map<GLuint, GLuint> freeIndices;
+            std::vector<RetiredRanges> retired;
+
+            // Draw commands for the current flush
+            std::vector<DrawCommand> commands;
+
+            // OpenGL Resources
+            GPUBuffer* vertexBuffer = nullptr;
+            GPUBuffer* indexBuffer = nullptr;
+            GPUBuffer* commandBuffer = nullptr;
+            VertexAttributes* vertexAttributes = nullptr;
+    };
+
+    // Templated code implementation
+
+    template <typename Vertex>
+    GeometryPool<Vertex>::GeometryPool(size_t maxVertices, size_t maxIndices, size_t maxCommands)
+        : maxVertices(maxVertices), maxIndices(maxIndices), maxCommands(maxCommands)
+    {
+        // Initialize resources
+        // NOTE: Storage is single-buffered, allocations never overlap anything the GPU is reading
+        vertexBuffer = new GPUBuffer(BufferType::Dynamic, maxVertices * sizeof(Vertex));
+        indexBuffer = new GPUBuffer(BufferType::Dynamic, maxIndices * sizeof(GLuint));
+        commandBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxCommands * sizeof(DrawCommand));
+        CreateVertexAttributes();
+
+        // The entire pool starts out free
+        freeVertices[0] = maxVertices;
+        freeIndices[0] = maxIndices;
+
+        commands.reserve(maxCommands);
+    }
+
+    template <typename Vertex>
+    GeometryPool<Vertex>::~GeometryPool()
+    {
+        // Free all OpenGL resources
+        delete vertexBuffer;
+        delete indexBuffer;
+        delete commandBuffer;
+        delete vertexAttributes;
+    }
+
+    template <typename Vertex>
+    typename GeometryPool<Vertex>::Allocation GeometryPool<Vertex>::Allocate(const Mesh<Vertex>& mesh)
+    {
+        const std::vector<Vertex>& meshVerts = mesh.GetVertices();
+        const std::vector<GLuint>& meshInds = mesh.GetIndices();
+
+        Allocation allocation;
+        if (meshVerts.empty() || meshInds.empty()) return allocation;
+
+        // Pick up any space the GPU is done with before searching
+        ReclaimRetired();
+
+        // Find space for the mesh, growing the pool if there is none
+        if (!TakeRange(freeVertices, meshVerts.size(), allocation.firstVertex))
+        {
+            Grow(std::max(maxVertices * 2, maxVertices + meshVerts.size()), maxIndices);
+            TakeRange(freeVertices, meshVerts.size(), allocation.firstVertex);
+        }
+        if (!TakeRange(freeIndices, meshInds.size(), allocation.firstIndex))
+        {
+            Grow(maxVertices, std::max(maxIndices * 2, maxIndices + meshInds.size()));
+            TakeRange(freeIndices, meshInds.size(), allocation.firstIndex);
+        }
+        allocation.vertexCount = meshVerts.size();
+        allocation.indexCount = meshInds.size();
+
+        // Upload the mesh data, indices stay relative to the mesh (baseVertex is applied when drawing)
+        vertexBuffer->SetOffset(allocation.firstVertex * sizeof(Vertex));
+        vertexBuffer->Write(meshVerts.data(), meshVerts.size() * sizeof(Vertex));
+        indexBuffer->SetOffset(allocation.firstIndex * sizeof(GLuint));
+        indexBuffer->Write(meshInds.data(), meshInds.size() * sizeof(GLuint));
+
+        usedVertices += allocation.vertexCount;
+        usedIndices += allocation.indexCount;
+
+        return allocation;
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::Free(Allocation& allocation)
+    {
+        if (!allocation.IsValid()) return;
+
+        // Draws already submitted may still read this range, so defer reuse until this frame is complete
+        uint64_t frame = FrameSync::GetFrameNumber();
+        if (retired.empty() || retired.back().frame != frame) retired.push_back({frame, {}});
+        retired.back().allocations.push_back(allocation);
+        usedVertices -= allocation.vertexCount;
+        usedIndices -= allocation.indexCount;
+
+        allocation = Allocation{};
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::AddDraw(const Allocation& allocation)
+    {
+        if (!allocation.IsValid()) return;
+
+        commands.push_back({allocation.indexCount, 1, allocation.firstIndex, (GLint)allocation.firstVertex, 0});
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::Flush(const Shader& shader)
+    {
+        if (commands.empty()) return;
+
+        // Grow the command buffer if this flush would overflow the current frame's section
+        // NOTE: Frames still in flight keep reading the old buffer, OpenGL only frees it once they are done
+        size_t commandBytes = commands.size() * sizeof(DrawCommand);
+        if (!commandBuffer->CanAllocate(commandBytes))
+        {
+            delete commandBuffer;
+            maxCommands = std::max(maxCommands * 2, commands.size());
+            commandBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxCommands * sizeof(DrawCommand));
+        }
+
+        GLintptr offset = commandBuffer->Allocate(commandBytes);
+        if (offset >= 0)
+        {
+            commandBuffer->Write(commands.data(), commandBytes);
+
+            // Bind resources
+            vertexAttributes->Bind();
+            commandBuffer->Bind(GL_DRAW_INDIRECT_BUFFER);
+            shader.Use();
+
+            // Issue draw call
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)offset, commands.size(), 0);
+        }
+
+        // Reset counters
+        commands.clear();
+    }
+
+    template <typename Vertex>
+    bool GeometryPool<Vertex>::TakeRange(std::map<GLuint, GLuint>& freeList, GLuint count, GLuint& offset)
+    {
+        // First fit
+        for (auto it = freeList.begin(); it != freeList.end(); ++it)
+        {
+            if (it->second >= count)
+            {
+                offset = it->first;
+                GLuint remaining = it->second - count;
+                freeList.erase(it);
+                if (remaining > 0) freeList[offset + count] = remaining;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::ReleaseRange(std::map<GLuint, GLuint>& freeList, GLuint offset, GLuint count)
+    {
+        auto next = freeList.lower_bound(offset);
+
+        // Merge with the following range
+        if (next != freeList.end() && offset + count == next->first)
+        {
+            count += next->second;
+            next = freeList.erase(next);
+        }
+
+        // Merge with the preceding range
+        if (next != freeList.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += count;
+                return;
+            }
+        }
+
+        freeList[offset] = count;
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::ReclaimRetired()
+    {
+        // Ranges are retired in frame order, so stop at the first frame that may still be in flight
+        size_t reclaimed = 0;
+        for (; reclaimed < retired.size(); reclaimed++)
+        {
+            RetiredRanges& ranges = retired[reclaimed];
+            if (ranges.frame >= FrameSync::GetCompletedFrames()) break;
+
+            for (const Allocation& allocation : ranges.allocations)
+            {
+                ReleaseRange(freeVertices, allocation.firstVertex, allocation.vertexCount);
+                ReleaseRange(freeIndices, allocation.firstIndex, allocation.indexCount);
+            }
+        }
+
+        retired.erase(retired.begin(), retired.begin() + reclaimed);
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::Grow(size_t newMaxVertices, size_t newMaxIndices)
+    {
+        // Copy the existing contents into larger buffers
+        if (newMaxVertices > maxVertices)
+        {
+            GPUBuffer* newBuffer = new GPUBuffer(BufferType::Dynamic, newMaxVertices * sizeof(Vertex));
+            GLState::BindBuffer(GL_COPY_READ_BUFFER, vertexBuffer->GetName());
+            GLState::BindBuffer(GL_COPY_WRITE_BUFFER, newBuffer->GetName());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, maxVertices * sizeof(Vertex));
+
+            delete vertexBuffer;
+            vertexBuffer = newBuffer;
+            ReleaseRange(freeVertices, maxVertices, newMaxVertices - maxVertices);
+            maxVertices = newMaxVertices;
+        }
+
+        if (newMaxIndices > maxIndices)
+        {
+            GPUBuffer* newBuffer = new GPUBuffer(BufferType::Dynamic, newMaxIndices * sizeof(GLuint));
+            GLState::BindBuffer(GL_COPY_READ_BUFFER, indexBuffer->GetName());
+            GLState::BindBuffer(GL_COPY_WRITE_BUFFER, newBuffer->GetName());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, maxIndices * sizeof(GLuint));
+
+            delete indexBuffer;
+            indexBuffer = newBuffer;
+            ReleaseRange(freeIndices, maxIndices, newMaxIndices - maxIndices);
+            maxIndices = newMaxIndices;
+        }
+
+        // The copies must land before any new data is written through the mapped pointers
+        // NOTE: Growing is rare (only when the view distance increases), so a full stall is acceptable
+        glFinish();
+
+        // The VAO references the old buffers
+        delete vertexAttributes;
+        CreateVertexAttributes();
+
+        PHI_LOG_INFO("GeometryPool grown to ", maxVertices, " vertices, ", maxIndices, " indices");
+    }
+
+    template <typename Vertex>
+    void GeometryPool<Vertex>::CreateVertexAttributes()
+    {
+        vertexAttributes = nullptr;
+
+        // VAO creation (Depends on vertex format)
+        if (std::is_same_v<Vertex, VertexPos>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColor>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNorm>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv1Uv2>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV1_UV2, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_UV, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosNorm>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosNormUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM_UV, vertexBuffer, indexBuffer);
+        }
+        else if (std::is_same_v<Vertex, VertexPosUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_UV, vertexBuffer, indexBuffer);
+        }
+
+        if (!vertexAttributes)
+        {
+            FatalError("GeometryPool Constructor: Custom vertex format is not supported yet, please use one of the internal vertex formats");
+        }
+    }
+}
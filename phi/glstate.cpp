@@ -0,0 +1,299 @@
+#include "glstate.hpp"
+
+namespace Phi
+{
+    // Maps a generic buffer target to its cache slot, or -1 if untracked
+    int GLState::BufferTargetIndex(GLenum target)
+    {
+        switch (target)
+        {
+            case GL_ARRAY_BUFFER:           return 0;
+            case GL_COPY_READ_BUFFER:       return 1;
+            case GL_COPY_WRITE_BUFFER:      return 2;
+            case GL_DRAW_INDIRECT_BUFFER:   return 3;
+            case GL_UNIFORM_BUFFER:         return 4;
+            case GL_SHADER_STORAGE_BUFFER:  return 5;
+            default:                        return -1;
+        }
+    }
+
+    // Maps an indexed buffer target to its cache slot, or -1 if untracked
+    int GLState::IndexedTargetIndex(GLenum target)
+    {
+        switch (target)
+        {
+            case GL_UNIFORM_BUFFER:         return 0;
+            case GL_SHADER_STORAGE_BUFFER:  return 1;
+            default:                        return -1;
+        }
+    }
+
+    // Maps a capability to its cache slot, or -1 if untracked
+    int GLState::CapabilityIndex(GLenum capability)
+    {
+        switch (capability)
+        {
+            case GL_DEPTH_TEST:     return 0;
+            case GL_BLEND:          return 1;
+            case GL_CULL_FACE:      return 2;
+            case GL_SCISSOR_TEST:   return 3;
+            default:                return -1;
+        }
+    }
+
+    // Sets the current program
+    void GLState::UseProgram(GLuint program)
+    {
+        EnsureInitialized();
+        if (!Check(GLState::program == program)) return;
+
+        glUseProgram(program);
+        GLState::program = program;
+    }
+
+    // Binds a vertex array object
+    void GLState::BindVertexArray(GLuint vao)
+    {
+        EnsureInitialized();
+        if (!Check(vertexArray == vao)) return;
+
+        glBindVertexArray(vao);
+        vertexArray = vao;
+    }
+
+    // Binds a buffer to a generic target
+    void GLState::BindBuffer(GLenum target, GLuint buffer)
+    {
+        EnsureInitialized();
+        int slot = BufferTargetIndex(target);
+        if (!Check(slot != -1 && buffers[slot] == buffer)) return;
+
+        glBindBuffer(target, buffer);
+        if (slot != -1) buffers[slot] = buffer;
+    }
+
+    // Binds an entire buffer to an indexed target
+    // NOTE: Also binds the generic target, as OpenGL does
+    void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        EnsureInitialized();
+        int slot = IndexedTargetIndex(target);
+        bool tracked = slot != -1 && index < MAX_INDEXED_BINDINGS;
+
+        // A base binding is cached as a range with size 0
+        IndexedBinding* binding = tracked ? &indexedBuffers[slot][index] : nullptr;
+        if (!Check(binding && binding->buffer == buffer && binding->offset == 0 && binding->size == 0)) return;
+
+        glBindBufferBase(target, index, buffer);
+        if (binding) *binding = {buffer, 0, 0};
+
+        int genericSlot = BufferTargetIndex(target);
+        if (genericSlot != -1) buffers[genericSlot] = buffer;
+    }
+
+    // Binds a range of a buffer to an indexed target
+    // NOTE: Also binds the generic target, as OpenGL does
+    void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        EnsureInitialized();
+        int slot = IndexedTargetIndex(target);
+        bool tracked = slot != -1 && index < MAX_INDEXED_BINDINGS;
+
+        IndexedBinding* binding = tracked ? &indexedBuffers[slot][index] : nullptr;
+        if (!Check(binding && binding->buffer == buffer && binding->offset == offset && binding->size == size)) return;
+
+        glBindBufferRange(target, index, buffer, offset, size);
+        if (binding) *binding = {buffer, offset, size};
+
+        int genericSlot = BufferTargetIndex(target);
+        if (genericSlot != -1) buffers[genericSlot] = buffer;
+    }
+
+    // Selects a texture unit, returns false if the unit is not tracked
+    bool GLState::ActiveTexture(int unit)
+    {
+        bool tracked = unit >= 0 && unit < MAX_TEXTURE_UNITS;
+        if (Check(tracked && activeUnit == unit))
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = tracked ? unit : -1;
+        }
+        return tracked;
+    }
+
+    // Binds a texture to a texture unit
+    void GLState::BindTexture(GLenum target, GLuint texture, int unit)
+    {
+        EnsureInitialized();
+
+        // Only check the cache first, so a redundant bind doesn't even change the active unit
+        GLuint* cache = nullptr;
+        if (unit >= 0 && unit < MAX_TEXTURE_UNITS)
+        {
+            if (target == GL_TEXTURE_2D) cache = &textures2D[unit];
+            else if (target == GL_TEXTURE_CUBE_MAP) cache = &texturesCube[unit];
+        }
+        if (!Check(cache && *cache == texture)) return;
+
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+        if (cache) *cache = texture;
+    }
+
+    // Binds a texture to the currently active texture unit
+    void GLState::BindTexture(GLenum target, GLuint texture)
+    {
+        EnsureInitialized();
+
+        // The active unit is unknown until something selects one
+        if (activeUnit == -1)
+        {
+            ActiveTexture(0);
+        }
+        BindTexture(target, texture, activeUnit);
+    }
+
+    // Enables a capability
+    void GLState::Enable(GLenum capability)
+    {
+        EnsureInitialized();
+        int slot = CapabilityIndex(capability);
+        if (!Check(slot != -1 && capabilities[slot] == 1)) return;
+
+        glEnable(capability);
+        if (slot != -1) capabilities[slot] = 1;
+    }
+
+    // Disables a capability
+    void GLState::Disable(GLenum capability)
+    {
+        EnsureInitialized();
+        int slot = CapabilityIndex(capability);
+        if (!Check(slot != -1 && capabilities[slot] == 0)) return;
+
+        glDisable(capability);
+        if (slot != -1) capabilities[slot] = 0;
+    }
+
+    // Sets the depth comparison function
+    void GLState::DepthFunc(GLenum func)
+    {
+        EnsureInitialized();
+        if (!Check(depthFunc == func)) return;
+
+        glDepthFunc(func);
+        depthFunc = func;
+    }
+
+    // Enables / disables depth writes
+    void GLState::DepthMask(GLboolean mask)
+    {
+        EnsureInitialized();
+        if (!Check(depthMask == (int)mask)) return;
+
+        glDepthMask(mask);
+        depthMask = mask;
+    }
+
+    // Sets the blend factors
+    void GLState::BlendFunc(GLenum src, GLenum dst)
+    {
+        EnsureInitialized();
+        if (!Check(blendSrc == src && blendDst == dst)) return;
+
+        glBlendFunc(src, dst);
+        blendSrc = src;
+        blendDst = dst;
+    }
+
+    // Sets which faces are culled
+    void GLState::CullFace(GLenum mode)
+    {
+        EnsureInitialized();
+        if (!Check(cullMode == mode)) return;
+
+        glCullFace(mode);
+        cullMode = mode;
+    }
+
+    // Deletes a program
+    // NOTE: A deleted program stays in use until another is bound, but its name may be reused after that
+    void GLState::DeleteProgram(GLuint program)
+    {
+        glDeleteProgram(program);
+        if (GLState::program == program) GLState::program = UNKNOWN;
+    }
+
+    // Deletes a vertex array, reverting the binding to 0 if it was bound
+    void GLState::DeleteVertexArray(GLuint vao)
+    {
+        glDeleteVertexArrays(1, &vao);
+        if (vertexArray == vao) vertexArray = 0;
+    }
+
+    // Deletes a buffer, OpenGL resets every binding of it to 0
+    void GLState::DeleteBuffer(GLuint buffer)
+    {
+        glDeleteBuffers(1, &buffer);
+
+        for (GLuint& binding : buffers)
+        {
+            if (binding == buffer) binding = 0;
+        }
+        for (auto& target : indexedBuffers)
+        {
+            for (IndexedBinding& binding : target)
+            {
+                if (binding.buffer == buffer) binding = {0, 0, 0};
+            }
+        }
+    }
+
+    // Deletes a texture, OpenGL resets every binding of it to 0
+    void GLState::DeleteTexture(GLuint texture)
+    {
+        glDeleteTextures(1, &texture);
+
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            if (textures2D[i] == texture) textures2D[i] = 0;
+            if (texturesCube[i] == texture) texturesCube[i] = 0;
+        }
+    }
+
+    // Forgets all cached state
+    void GLState::Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (GLuint& binding : buffers) binding = UNKNOWN;
+        for (auto& target : indexedBuffers)
+        {
+            for (IndexedBinding& binding : target) binding = {UNKNOWN, 0, 0};
+        }
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            textures2D[i] = UNKNOWN;
+            texturesCube[i] = UNKNOWN;
+        }
+        activeUnit = -1;
+        for (int& capability : capabilities) capability = -1;
+        depthFunc = UNKNOWN;
+        depthMask = -1;
+        blendSrc = UNKNOWN;
+        blendDst = UNKNOWN;
+        cullMode = UNKNOWN;
+        initialized = true;
+    }
+
+    // Invalidates the cache and starts counting calls for a new frame
+    // NOTE: Called by App after ImGui has rendered, since its backend uses raw GL calls
+    void GLState::NewFrame()
+    {
+        Invalidate();
+        lastIssued = issued;
+        lastElided = elided;
+        issued = 0;
+        elided = 0;
+    }
+}
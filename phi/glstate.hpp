@@ -0,0 +1,124 @@
+#pragma once
+
+#include <GL/glew.h> // OpenGL types / functions
+
+namespace Phi
+{
+    // Shadow copy of the OpenGL state changed through Phi
+    // Binds / state changes that would not change anything are skipped, and every call is counted
+    // as either issued (sent to the driver) or elided, per frame
+    // NOTE: Code that changes tracked state with raw GL calls must call Invalidate() afterwards,
+    // and objects must be deleted through the Delete*() methods so their names can be safely reused
+    class GLState
+    {
+        // Interface
+        public:
+
+            // Static interface only
+            GLState() = delete;
+
+            // Object binding
+            static void UseProgram(GLuint program);
+            static void BindVertexArray(GLuint vao);
+            static void BindBuffer(GLenum target, GLuint buffer);
+            static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+            static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+            static void BindTexture(GLenum target, GLuint texture, int unit);
+
+            // Binds to the currently active texture unit (used when creating / updating textures)
+            static void BindTexture(GLenum target, GLuint texture);
+
+            // Fixed function state
+            // NOTE: Only GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE and GL_SCISSOR_TEST are cached, others are always issued
+            static void Enable(GLenum capability);
+            static void Disable(GLenum capability);
+            static void DepthFunc(GLenum func);
+            static void DepthMask(GLboolean mask);
+            static void BlendFunc(GLenum src, GLenum dst);
+            static void CullFace(GLenum mode);
+
+            // Object deletion, removes the object from every cached binding
+            static void DeleteProgram(GLuint program);
+            static void DeleteVertexArray(GLuint vao);
+            static void DeleteBuffer(GLuint buffer);
+            static void DeleteTexture(GLuint texture);
+
+            // Forgets all cached state, the next call of every kind is always issued
+            static void Invalidate();
+
+            // Invalidates the cache and starts counting calls for a new frame
+            static void NewFrame();
+
+            // Calls issued / elided during the last complete frame
+            static inline int GetIssuedCount() { return lastIssued; };
+            static inline int GetElidedCount() { return lastElided; };
+
+            // When disabled, every call is issued (for comparison)
+            static inline bool enabled = true;
+
+        // Data / implementation
+        private:
+
+            // Value of any binding whose state is unknown
+            static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+            // Limits of the tracked state, anything past them is always issued
+            static const int MAX_TEXTURE_UNITS = 32;
+            static const int MAX_INDEXED_BINDINGS = 16;
+
+            // Generic buffer binding targets that are tracked
+            // NOTE: GL_ELEMENT_ARRAY_BUFFER is VAO state, so it is never cached
+            static const int BUFFER_TARGET_COUNT = 6;
+            static int BufferTargetIndex(GLenum target);
+            static int IndexedTargetIndex(GLenum target);
+            static int CapabilityIndex(GLenum capability);
+
+            // Records a call, returning true if it must be issued
+            static inline bool Check(bool redundant)
+            {
+                if (redundant && enabled)
+                {
+                    elided++;
+                    return false;
+                }
+                issued++;
+                return true;
+            };
+
+            // Indexed buffer binding (UBO / SSBO)
+            struct IndexedBinding
+            {
+                GLuint buffer;
+                GLintptr offset;
+                GLsizeiptr size;
+            };
+
+            // Cached state
+            static inline GLuint program = UNKNOWN;
+            static inline GLuint vertexArray = UNKNOWN;
+            static inline GLuint buffers[BUFFER_TARGET_COUNT];
+            static inline IndexedBinding indexedBuffers[2][MAX_INDEXED_BINDINGS];
+            static inline GLuint textures2D[MAX_TEXTURE_UNITS];
+            static inline GLuint texturesCube[MAX_TEXTURE_UNITS];
+            static inline int activeUnit = -1;
+            static inline int capabilities[4];
+            static inline GLenum depthFunc = UNKNOWN;
+            static inline int depthMask = -1;
+            static inline GLenum blendSrc = UNKNOWN;
+            static inline GLenum blendDst = UNKNOWN;
+            static inline GLenum cullMode = UNKNOWN;
+            static inline bool initialized = false;
+
+            // Per-frame counters
+            static inline int issued = 0;
+            static inline int elided = 0;
+            static inline int lastIssued = 0;
+            static inline int lastElided = 0;
+
+            // Selects a texture unit, returns false if the unit is not tracked
+            static bool ActiveTexture(int unit);
+
+            // Sets up the cache the first time it is used
+            static inline void EnsureInitialized() { if (!initialized) Invalidate(); };
+    };
+}
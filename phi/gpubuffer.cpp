@@ -1,4 +1,7 @@
 #include "gpubuffer.hpp"
+#include "log.hpp"
+
+#include <algorithm>
 
 namespace Phi
 {
@@ -12,13 +15,28 @@ namespace Phi
             case BufferType::Dynamic:               numSections = 1;    break;
             case BufferType::DynamicDoubleBuffer:   numSections = 2;    break;
             case BufferType::DynamicTripleBuffer:   numSections = 3;    break;
+            case BufferType::DynamicPerFrame:       numSections = FrameSync::FRAMES_IN_FLIGHT; break;
+        }
+
+        // Per-frame sections must start on a range binding boundary
+        if (type == BufferType::DynamicPerFrame)
+        {
+            if (bindAlignment == 0)
+            {
+                GLint uniformAlignment = 1, storageAlignment = 1;
+                glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+                glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+                bindAlignment = std::max(std::max(uniformAlignment, storageAlignment), 1);
+            }
+            this->size = (size + bindAlignment - 1) / bindAlignment * bindAlignment;
+            size = this->size;
         }
 
         // Set the flags for buffer storage creation / mapping
         GLenum flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
         // Create an immutable data store
-        glBindBuffer(GL_ARRAY_BUFFER, id);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, id);
         glBufferStorage(GL_ARRAY_BUFFER, size * numSections, data, flags);
 
         // Map the buffer
@@ -30,13 +48,17 @@ namespace Phi
         }
 
         // Unbind
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     GPUBuffer::~GPUBuffer()
     {
-        // Delete OpenGL buffer object
-        glDeleteBuffers(1, &id);
+        // Delete any remaining fences and the OpenGL buffer object
+        for (GLsync sync : syncObj)
+        {
+            if (sync) glDeleteSync(sync);
+        }
+        GLState::DeleteBuffer(id);
     }
 
     bool GPUBuffer::Write(int value)
@@ -44,7 +66,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(GLint)))
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -60,7 +82,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(GLfloat)))
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -76,7 +98,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(glm::vec2))) 
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -93,7 +115,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(glm::vec3))) 
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -111,7 +133,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(glm::vec4))) 
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -130,7 +152,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(sizeof(glm::mat4))) 
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -153,7 +175,7 @@ namespace Phi
         // Ensure buffer has space for write
         if (!CanWrite(size)) 
         {
-            std::cout << "ERROR: Buffer write failed @" << this << ", would have overflowed" << std::endl;
+            PHI_LOG_ERROR("Buffer write failed @", this, ", would have overflowed");
             return false;
         }
 
@@ -167,21 +189,68 @@ namespace Phi
 
     void GPUBuffer::Bind(GLenum target) const
     {
-        glBindBuffer(target, id);
+        GLState::BindBuffer(target, id);
     }
 
     void GPUBuffer::BindBase(GLenum target, GLuint index) const
     {
-        glBindBufferBase(target, index, id);
+        GLState::BindBufferBase(target, index, id);
     }
 
     void GPUBuffer::BindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size)
     {
-        glBindBufferRange(target, index, id, offset, size);
+        GLState::BindBufferRange(target, index, id, offset, size);
+    }
+
+    GLintptr GPUBuffer::Allocate(size_t bytes, size_t alignment)
+    {
+        // Start over in a new frame's section, FrameSync has made sure the GPU is done with it
+        if (allocFrame != FrameSync::GetFrameNumber())
+        {
+            allocFrame = FrameSync::GetFrameNumber();
+            currentSection = FrameSync::GetFrameIndex() % numSections;
+            allocOffset = 0;
+        }
+
+        size_t offset = AlignedOffset(currentSection, allocOffset, alignment);
+        if (offset + bytes > size)
+        {
+            PHI_LOG_ERROR("Per-frame buffer @", this, " is full, couldn't allocate ", bytes, " bytes");
+
+            // Make sure nothing can be written until the next frame
+            pCurrent = pData + currentSection * size + size;
+            return -1;
+        }
+
+        allocOffset = offset + bytes;
+        pCurrent = pData + currentSection * size + offset;
+        return currentSection * size + offset;
+    }
+
+    bool GPUBuffer::CanAllocate(size_t bytes, size_t alignment) const
+    {
+        // A new frame's section is empty
+        if (allocFrame != FrameSync::GetFrameNumber())
+        {
+            return AlignedOffset(FrameSync::GetFrameIndex() % numSections, 0, alignment) + bytes <= size;
+        }
+
+        return AlignedOffset(currentSection, allocOffset, alignment) + bytes <= size;
+    }
+
+    size_t GPUBuffer::AlignedOffset(GLuint section, size_t used, size_t alignment) const
+    {
+        // Sections start on a range binding boundary, other alignments are relative to the start of the buffer
+        if (alignment == 0) return (used + bindAlignment - 1) / bindAlignment * bindAlignment;
+
+        size_t start = section * size;
+        return (start + used + alignment - 1) / alignment * alignment - start;
     }
 
     void GPUBuffer::Lock()
     {
+        if (type == BufferType::DynamicPerFrame) return;
+
         // If already locked, delete old sync
         if (syncObj[currentSection])
         {
@@ -199,11 +268,7 @@ namespace Phi
         if (syncObj[currentSection])
         {
             // Wait for the sync object to be signaled
-            while (true)
-            {
-                GLenum response = glClientWaitSync(syncObj[currentSection], GL_SYNC_FLUSH_COMMANDS_BIT, 1);
-                if (response == GL_ALREADY_SIGNALED || response == GL_CONDITION_SATISFIED) return;
-            }
+            FrameSync::Wait(syncObj[currentSection]);
 
             // Delete and reset the sync object
             glDeleteSync(syncObj[currentSection]);
@@ -213,6 +278,8 @@ namespace Phi
 
     void GPUBuffer::SwapSections()
     {
+        if (type == BufferType::DynamicPerFrame) return;
+
         // Update current section
         currentSection++;
         if (currentSection >= numSections) currentSection = 0;
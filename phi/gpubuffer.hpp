@@ -8,6 +8,9 @@
 
 #include <GL/glew.h> // OpenGL types / functions
 
+#include "framesync.hpp"
+#include "glstate.hpp"
+
 #include "app.hpp" // Error functions
 
 namespace Phi
@@ -16,13 +19,16 @@ namespace Phi
     // Static is best for data you only update once at construction
     // Dynamic is best for data you must update every frame but don't have the space for double/triple buffering
     // Double/triple buffers make use of SwapSection() to write to different sections of the buffer
+    // Per-frame buffers have one section per frame in flight, and Allocate() from the current frame's section,
+    // FrameSync guarantees the GPU is done with it, so they need no Lock() / Sync() / SwapSections()
     // NOTE: With double/triple buffering, Lock() only locks the current section of the buffer
     enum class BufferType
     {
         Static,
         Dynamic,
         DynamicDoubleBuffer,
-        DynamicTripleBuffer
+        DynamicTripleBuffer,
+        DynamicPerFrame
     };
     
     // Buffer object RAII wrapper
@@ -57,12 +63,19 @@ namespace Phi
             bool Write(const glm::mat4& value);
             bool Write(const void* const data, GLuint size);
 
+            // Per-frame buffers only: reserves bytes in the current frame's section and moves the write offset there
+            // Returns the reservation's offset from the start of the buffer, or -1 if the section is full
+            // The offset is aligned for range binding, or to a multiple of alignment if given (e.g. sizeof(Vertex) for base vertices)
+            GLintptr Allocate(size_t bytes, size_t alignment = 0);
+            bool CanAllocate(size_t bytes, size_t alignment = 0) const;
+
             // Binding methods
             void Bind(GLenum target) const;
             void BindBase(GLenum target, GLuint index) const;
             void BindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size);
 
             // Synchronization
+            // NOTE: No-ops for per-frame buffers
             void Lock(); // Insert a fence sync for all rendering commands
             void Sync(); // Wait until our sync object has been signaled
             void SwapSections(); // Increase the buffer section, wraps to [0, numSections)
@@ -74,13 +87,20 @@ namespace Phi
             inline GLuint GetOffset() const { return (pCurrent - (pData + currentSection * size)); };
             inline size_t GetSize() const { return size; };
 
+            // Mapped memory at the current offset (e.g. the start of the last Allocate()), for writing from several threads at once
+            // NOTE: Direct writes don't move the current offset
+            inline unsigned char* GetCurrentData() const { return pCurrent; };
+
             // Helper method to ensure buffer writes are safe
             inline bool CanWrite(GLuint bytes) const { return (pCurrent + bytes) <= (pData + currentSection * size + size); };
 
         // Data / implementation
         private:
             
-            static const int MAX_SECTIONS = 3;
+            static const int MAX_SECTIONS = FrameSync::FRAMES_IN_FLIGHT > 3 ? FrameSync::FRAMES_IN_FLIGHT : 3;
+
+            // Offset alignment that satisfies both uniform and storage buffer range binding
+            static inline GLint bindAlignment = 0;
             
             // Buffer state / data
             BufferType type;
@@ -92,6 +112,13 @@ namespace Phi
             unsigned char* pData = nullptr;
             unsigned char* pCurrent = nullptr;
 
+            // Per-frame allocation state
+            uint64_t allocFrame = UINT64_MAX;
+            size_t allocOffset = 0;
+
+            // Offset (within section) of the next allocation with the given alignment, after used bytes
+            size_t AlignedOffset(GLuint section, size_t used, size_t alignment) const;
+
             // OpenGL object handles
             GLuint id = 0;
             GLsync syncObj[MAX_SECTIONS] = {0};
@@ -0,0 +1,303 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+#include "log.hpp"
+
+namespace Phi
+{
+    // Index of the calling thread's deque, -1 for threads that aren't workers
+    static thread_local int workerIndex = -1;
+
+    void JobSystem::Init(int workerCount)
+    {
+        if (!workers.empty()) return;
+
+        if (workerCount <= 0)
+        {
+            workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        }
+
+        mainThreadID = std::this_thread::get_id();
+        stopping = false;
+
+        for (int i = 0; i < workerCount; ++i)
+        {
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for (int i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back(&JobSystem::WorkerLoop, i);
+        }
+
+        PHI_LOG_INFO("Job system started with ", workerCount, " worker(s)");
+    }
+
+    void JobSystem::Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+        queues.clear();
+        queuedCount = 0;
+
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        mainThreadJobs.clear();
+    }
+
+    void JobSystem::Schedule(const char* name, JobFn fn, Counter* counter)
+    {
+        if (counter) counter->count++;
+        Push({name, std::move(fn), counter, false});
+    }
+
+    void JobSystem::RunOnMainThread(const char* name, JobFn fn, Counter* counter)
+    {
+        if (counter) counter->count++;
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        mainThreadJobs.push_back({name, std::move(fn), counter, true});
+    }
+
+    void JobSystem::Then(Counter& dependency, const char* name, JobFn fn, Counter* counter, bool mainThread)
+    {
+        // The job counts as pending from now on, not from when it is queued
+        if (counter) counter->count++;
+        Job job{name, std::move(fn), counter, mainThread};
+
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.count > 0)
+            {
+                dependency.continuations.push_back(std::move(job));
+                return;
+            }
+        }
+
+        if (mainThread)
+        {
+            std::lock_guard<std::mutex> lock(mainThreadMutex);
+            mainThreadJobs.push_back(std::move(job));
+        }
+        else
+        {
+            Push(std::move(job));
+        }
+    }
+
+    void JobSystem::ParallelFor(const char* name, int begin, int end, int grainSize, const std::function<void(int, int)>& fn)
+    {
+        grainSize = std::max(grainSize, 1);
+
+        Counter counter;
+        for (int rangeBegin = begin; rangeBegin < end; rangeBegin += grainSize)
+        {
+            int rangeEnd = std::min(rangeBegin + grainSize, end);
+            Schedule(name, [&fn, rangeBegin, rangeEnd]() { fn(rangeBegin, rangeEnd); }, &counter);
+        }
+        Wait(counter);
+    }
+
+    void JobSystem::Wait(Counter& counter)
+    {
+        bool mainThread = std::this_thread::get_id() == mainThreadID;
+
+        while (counter.count > 0)
+        {
+            Job job;
+            if (TryPop(job) || (mainThread && TryPopMainThread(job)))
+            {
+                Execute(job);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        // The last job may still be inside Finish(), don't return until it has released the counter
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    int JobSystem::RunMainThreadJobs(float budgetMs)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        int count = 0;
+
+        Job job;
+        while (TryPopMainThread(job))
+        {
+            Execute(job);
+            count++;
+
+            float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            if (ms >= budgetMs) break;
+        }
+
+        return count;
+    }
+
+    void JobSystem::NewFrame()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        lastStats.clear();
+        for (auto& [name, stats] : currentStats)
+        {
+            lastStats.push_back(stats);
+        }
+        std::sort(lastStats.begin(), lastStats.end(), [](const JobStats& a, const JobStats& b) { return a.totalMs > b.totalMs; });
+
+        currentStats.clear();
+    }
+
+    std::vector<JobSystem::JobStats> JobSystem::GetStats()
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return lastStats;
+    }
+
+    int JobSystem::GetMainThreadJobCount()
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        return (int)mainThreadJobs.size();
+    }
+
+    // Runs jobs until Shutdown(), sleeping whenever every deque is empty
+    void JobSystem::WorkerLoop(int index)
+    {
+        workerIndex = index;
+        Trace::SetThreadName("Job Worker " + std::to_string(index));
+
+        while (true)
+        {
+            Job job;
+            if (TryPop(job))
+            {
+                Execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            workAvailable.wait(lock, []() { return stopping || queuedCount > 0; });
+            if (stopping) return;
+        }
+    }
+
+    void JobSystem::Push(Job&& job)
+    {
+        // Workers keep their own jobs, other threads spread theirs across the workers
+        int index = workerIndex >= 0 ? workerIndex : (int)(nextQueue++ % queues.size());
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->jobs.push_back(std::move(job));
+        }
+        queuedCount++;
+
+        // Taking the lock ensures a worker can't miss the wake up between checking queuedCount and sleeping
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        workAvailable.notify_one();
+    }
+
+    bool JobSystem::TryPop(Job& job)
+    {
+        if (queuedCount == 0) return false;
+
+        // Newest job from our own deque first, it is the most likely to still be in cache
+        if (workerIndex >= 0)
+        {
+            WorkQueue& queue = *queues[workerIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                queuedCount--;
+                return true;
+            }
+        }
+
+        // Steal the oldest job from another worker
+        int count = (int)queues.size();
+        int start = workerIndex >= 0 ? workerIndex + 1 : 0;
+        for (int i = 0; i < count; ++i)
+        {
+            WorkQueue& queue = *queues[(start + i) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                queuedCount--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool JobSystem::TryPopMainThread(Job& job)
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        if (mainThreadJobs.empty()) return false;
+
+        job = std::move(mainThreadJobs.front());
+        mainThreadJobs.pop_front();
+        return true;
+    }
+
+    void JobSystem::Execute(Job& job)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        {
+            PHI_TRACE_SCOPE(job.name);
+            job.fn();
+        }
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            JobStats& stats = currentStats[job.name];
+            stats.name = job.name;
+            stats.count++;
+            stats.totalMs += ms;
+            stats.maxMs = std::max(stats.maxMs, ms);
+        }
+
+        Finish(job.counter);
+    }
+
+    void JobSystem::Finish(Counter* counter)
+    {
+        if (!counter) return;
+
+        // Continuations are moved out while holding the lock, the counter may be destroyed as soon as it is released
+        std::vector<Job> continuations;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (--counter->count == 0) continuations.swap(counter->continuations);
+        }
+
+        for (Job& job : continuations)
+        {
+            if (job.mainThread)
+            {
+                std::lock_guard<std::mutex> lock(mainThreadMutex);
+                mainThreadJobs.push_back(std::move(job));
+            }
+            else
+            {
+                Push(std::move(job));
+            }
+        }
+    }
+}
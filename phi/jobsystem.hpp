@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace Phi
+{
+    // Work-stealing thread pool
+    // Every worker owns a deque of jobs: it pushes / pops its own jobs at the back, and steals from
+    // the front of the other workers' deques when it runs out
+    // Usage:
+    // 1. Schedule() jobs from any thread, optionally tracked by a Counter
+    // 2. Wait() on the counter, the waiting thread runs jobs itself until the counter reaches 0
+    // 3. Work that needs the OpenGL context is queued with RunOnMainThread(), and executed
+    //    by RunMainThreadJobs() within a time budget (App does this every frame)
+    class JobSystem
+    {
+        // A single unit of work, defined below
+        struct Job;
+
+        // Interface
+        public:
+
+            // Static interface only
+            JobSystem() = delete;
+
+            using JobFn = std::function<void()>;
+
+            // Counts the unfinished jobs scheduled with it, continuations are scheduled once it reaches 0
+            // NOTE: Must outlive every job it tracks, Wait() on it before destroying it
+            class Counter
+            {
+                public:
+
+                    Counter() = default;
+
+                    // Delete copy constructor/assignment
+                    Counter(const Counter&) = delete;
+                    Counter& operator=(const Counter&) = delete;
+
+                    // Delete move constructor/assignment
+                    Counter(Counter&& other) = delete;
+                    void operator=(Counter&& other) = delete;
+
+                    inline int GetCount() const { return count.load(); };
+                    inline bool IsDone() const { return count.load() == 0; };
+
+                private:
+
+                    friend class JobSystem;
+
+                    std::atomic<int> count = 0;
+                    std::mutex mutex;
+                    std::vector<Job> continuations;
+            };
+
+            // Time spent in every job of the same name during a frame
+            struct JobStats
+            {
+                std::string name;
+                int count = 0;
+                float totalMs = 0.0f;
+                float maxMs = 0.0f;
+            };
+
+            // Spawns the workers, the calling thread becomes the main thread
+            // If workerCount is 0, one worker is spawned per hardware thread (leaving one for the main thread)
+            // NOTE: Called by App, other threads must not schedule jobs before this
+            static void Init(int workerCount = 0);
+
+            // Stops and joins the workers, jobs that have not started are discarded
+            static void Shutdown();
+
+            // Queues a job on the workers
+            // name must be a string literal, it is used for timing / tracing
+            static void Schedule(const char* name, JobFn fn, Counter* counter = nullptr);
+
+            // Queues a job on the main thread
+            static void RunOnMainThread(const char* name, JobFn fn, Counter* counter = nullptr);
+
+            // Queues a job (on the workers or the main thread) once every job tracked by dependency has finished
+            // The job is queued immediately if dependency is already done
+            static void Then(Counter& dependency, const char* name, JobFn fn, Counter* counter = nullptr, bool mainThread = false);
+
+            // Splits [begin, end) into ranges of at most grainSize and calls fn(rangeBegin, rangeEnd) for each on the workers
+            // Returns once every range has finished, the calling thread runs ranges too
+            static void ParallelFor(const char* name, int begin, int end, int grainSize, const std::function<void(int, int)>& fn);
+
+            // Runs jobs on the calling thread until every job tracked by counter has finished
+            // On the main thread, main thread jobs are run as well
+            static void Wait(Counter& counter);
+
+            // Runs main thread jobs until the queue is empty or budgetMs has passed (always at least one job)
+            // Returns the number of jobs run
+            static int RunMainThreadJobs(float budgetMs);
+
+            // Publishes this frame's job timings and starts a new frame (App does this every frame)
+            static void NewFrame();
+
+            // Job timings of the last complete frame, sorted by total time
+            static std::vector<JobStats> GetStats();
+
+            // Accessors
+            static inline int GetWorkerCount() { return (int)workers.size(); };
+            static int GetMainThreadJobCount();
+
+        // Data / implementation
+        private:
+
+            // A single unit of work
+            struct Job
+            {
+                const char* name;
+                JobFn fn;
+                Counter* counter;
+                bool mainThread;
+            };
+
+            // A worker's deque
+            struct WorkQueue
+            {
+                std::mutex mutex;
+                std::deque<Job> jobs;
+            };
+
+            // Worker thread entrypoint
+            static void WorkerLoop(int index);
+
+            // Adds a job to a worker deque (the calling worker's own, or the next one round-robin) and wakes a worker
+            static void Push(Job&& job);
+
+            // Pops a job from the calling worker's own deque, or steals one from another worker
+            static bool TryPop(Job& job);
+
+            // Pops a main thread job
+            static bool TryPopMainThread(Job& job);
+
+            // Runs a job, records its timing and finishes its counter
+            static void Execute(Job& job);
+
+            // Decrements a counter, scheduling its continuations if it reached 0
+            static void Finish(Counter* counter);
+
+            // Workers and their deques
+            static inline std::vector<std::thread> workers;
+            static inline std::vector<std::unique_ptr<WorkQueue>> queues;
+            static inline std::atomic<unsigned int> nextQueue = 0;
+            static inline std::thread::id mainThreadID;
+
+            // Sleeping workers wait for queuedCount > 0
+            static inline std::mutex sleepMutex;
+            static inline std::condition_variable workAvailable;
+            static inline std::atomic<int> queuedCount = 0;
+            static inline bool stopping = false;
+
+            // Jobs that must run on the main thread
+            static inline std::mutex mainThreadMutex;
+            static inline std::deque<Job> mainThreadJobs;
+
+            // Timings of the current / last frame
+            static inline std::mutex statsMutex;
+            static inline std::unordered_map<std::string, JobStats> currentStats;
+            static inline std::vector<JobStats> lastStats;
+    };
+}
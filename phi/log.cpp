@@ -0,0 +1,144 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace Phi
+{
+    Log::Message Log::queue[Log::QUEUE_SIZE];
+
+    void Log::Init()
+    {
+        if (running) return;
+
+        running = true;
+        writer = std::thread(&Log::WriterLoop);
+    }
+
+    void Log::Shutdown()
+    {
+        if (!running) return;
+
+        running = false;
+        writer.join();
+        Drain();
+    }
+
+    void Log::Flush()
+    {
+        Drain();
+    }
+
+    std::ostringstream& Log::GetStream()
+    {
+        static thread_local std::ostringstream stream;
+        return stream;
+    }
+
+    void Log::Push(Level level, const std::string& text)
+    {
+        // Too long for a slot (e.g. shader info logs), write it directly after everything queued before it
+        if (text.size() > MAX_MESSAGE_LENGTH)
+        {
+            Drain(level, &text);
+            return;
+        }
+
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Message& message = queue[pos % QUEUE_SIZE];
+            uint64_t turn = message.turn.load(std::memory_order_acquire);
+            uint64_t expected = pos / QUEUE_SIZE * 2;
+
+            if (turn == expected)
+            {
+                // Slot is free for this lap, try to claim it
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    message.level = level;
+                    message.length = (uint16_t)text.size();
+                    memcpy(message.text, text.data(), message.length);
+                    message.turn.store(expected + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (turn < expected)
+            {
+                // Slot still holds a message from the last lap, the queue is full
+                dropped++;
+                return;
+            }
+            else
+            {
+                // Another producer claimed this slot first
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Nobody else will write it
+        if (!running) Drain();
+    }
+
+    bool Log::Drain(Level level, const std::string* text)
+    {
+        std::lock_guard<std::mutex> lock(drainMutex);
+
+        // Batch everything into a single write and flush
+        std::string output;
+        while (true)
+        {
+            Message& message = queue[tail % QUEUE_SIZE];
+            uint64_t expected = tail / QUEUE_SIZE * 2 + 1;
+            if (message.turn.load(std::memory_order_acquire) != expected) break;
+
+            output += GetPrefix(message.level);
+            output.append(message.text, message.length);
+            output += '\n';
+
+            // Hand the slot to the next lap
+            message.turn.store(expected + 1, std::memory_order_release);
+            tail++;
+        }
+
+        size_t droppedCount = dropped.load();
+        if (droppedCount != droppedReported)
+        {
+            output += "WARNING: " + std::to_string(droppedCount - droppedReported) + " log messages dropped, queue was full\n";
+            droppedReported = droppedCount;
+        }
+
+        if (text)
+        {
+            output += GetPrefix(level);
+            output += *text;
+            output += '\n';
+        }
+
+        if (output.empty()) return false;
+
+        std::cout << output;
+        std::cout.flush();
+        return true;
+    }
+
+    const char* Log::GetPrefix(Level level)
+    {
+        switch (level)
+        {
+            case Level::Debug: return "DEBUG: ";
+            case Level::Warning: return "WARNING: ";
+            case Level::Error: return "ERROR: ";
+            default: return "";
+        }
+    }
+
+    void Log::WriterLoop()
+    {
+        while (running)
+        {
+            if (!Drain()) std::this_thread::sleep_for(WRITER_SLEEP);
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Log levels, messages below PHI_LOG_LEVEL are compiled out entirely
+// Defaults to Info, define PHI_LOG_LEVEL before including Phi (or with -D) to override it
+#define PHI_LOG_LEVEL_DEBUG 0
+#define PHI_LOG_LEVEL_INFO 1
+#define PHI_LOG_LEVEL_WARNING 2
+#define PHI_LOG_LEVEL_ERROR 3
+#define PHI_LOG_LEVEL_NONE 4
+
+#ifndef PHI_LOG_LEVEL
+    #define PHI_LOG_LEVEL PHI_LOG_LEVEL_INFO
+#endif
+
+// Logs every argument streamed one after the other, e.g. PHI_LOG_INFO("Loaded ", path, " in ", ms, "ms")
+// Every call site is rate limited on its own, arguments aren't evaluated when a message is limited
+#define PHI_LOG(level, ...) \
+    do \
+    { \
+        static Phi::Log::Site phiLogSite; \
+        if (phiLogSite.Allow()) Phi::Log::Write(level, phiLogSite, __VA_ARGS__); \
+    } while (0)
+
+#if PHI_LOG_LEVEL <= PHI_LOG_LEVEL_DEBUG
+    #define PHI_LOG_DEBUG(...) PHI_LOG(Phi::Log::Level::Debug, __VA_ARGS__)
+#else
+    #define PHI_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if PHI_LOG_LEVEL <= PHI_LOG_LEVEL_INFO
+    #define PHI_LOG_INFO(...) PHI_LOG(Phi::Log::Level::Info, __VA_ARGS__)
+#else
+    #define PHI_LOG_INFO(...) ((void)0)
+#endif
+
+#if PHI_LOG_LEVEL <= PHI_LOG_LEVEL_WARNING
+    #define PHI_LOG_WARNING(...) PHI_LOG(Phi::Log::Level::Warning, __VA_ARGS__)
+#else
+    #define PHI_LOG_WARNING(...) ((void)0)
+#endif
+
+#if PHI_LOG_LEVEL <= PHI_LOG_LEVEL_ERROR
+    #define PHI_LOG_ERROR(...) PHI_LOG(Phi::Log::Level::Error, __VA_ARGS__)
+#else
+    #define PHI_LOG_ERROR(...) ((void)0)
+#endif
+
+namespace Phi
+{
+    // Asynchronous logger, messages are written to stdout by a background thread
+    // Usage:
+    // 1. Log with the PHI_LOG_* macros, from any thread
+    // 2. Init() starts the writer thread (App does this), Shutdown() writes what's left and stops it
+    // NOTE: Logging never blocks: messages are copied into a fixed size lock-free queue,
+    // and dropped (and counted) if it is full. Without a writer thread, the logging thread writes them itself
+    // The only exception are messages longer than a queue slot, which are written synchronously (in order)
+    class Log
+    {
+        // Interface
+        public:
+
+            // Static interface only
+            Log() = delete;
+
+            enum class Level : uint8_t
+            {
+                Debug,
+                Info,
+                Warning,
+                Error,
+            };
+
+            // Rate limit state of a single call site, created by the PHI_LOG macros
+            class Site
+            {
+                public:
+
+                    constexpr Site() = default;
+
+                    // Delete copy constructor/assignment
+                    Site(const Site&) = delete;
+                    Site& operator=(const Site&) = delete;
+
+                    // Delete move constructor/assignment
+                    Site(Site&& other) = delete;
+                    void operator=(Site&& other) = delete;
+
+                    // Returns false if this site has already logged MAX_PER_SECOND messages this second
+                    inline bool Allow()
+                    {
+                        int64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                        int64_t current = window.load(std::memory_order_relaxed);
+                        if (current != second && window.compare_exchange_strong(current, second, std::memory_order_relaxed))
+                        {
+                            count.store(0, std::memory_order_relaxed);
+                        }
+
+                        if (count.fetch_add(1, std::memory_order_relaxed) < MAX_PER_SECOND) return true;
+                        suppressed.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    };
+
+                private:
+
+                    friend class Log;
+
+                    std::atomic<int64_t> window = 0;
+                    std::atomic<int> count = 0;
+                    std::atomic<int> suppressed = 0;
+            };
+
+            // Max messages a single call site logs per second, the rest are counted and reported with the next one
+            static const int MAX_PER_SECOND = 10;
+
+            // Starts the writer thread
+            static void Init();
+
+            // Writes every queued message and stops the writer thread, later messages are written synchronously
+            static void Shutdown();
+
+            // Writes every queued message on the calling thread (e.g. before exiting on a fatal error)
+            static void Flush();
+
+            // Formats and queues a message, use the PHI_LOG_* macros instead
+            template <typename... Args>
+            static void Write(Level level, Site& site, const Args&... args)
+            {
+                std::ostringstream& stream = GetStream();
+                stream.str("");
+                stream.clear();
+                (stream << ... << args);
+
+                int skipped = site.suppressed.exchange(0, std::memory_order_relaxed);
+                if (skipped > 0) stream << " (" << skipped << " similar messages suppressed)";
+
+                Push(level, stream.str());
+            };
+
+            // Number of messages dropped because the queue was full
+            static inline size_t GetDroppedCount() { return dropped.load(); };
+
+        // Data / implementation
+        private:
+
+            // Queue capacity, and max length of a queued message (longer messages are written synchronously)
+            static const uint64_t QUEUE_SIZE = 1024;
+            static const size_t MAX_MESSAGE_LENGTH = 256;
+
+            // How long the writer thread sleeps when the queue is empty
+            static constexpr std::chrono::milliseconds WRITER_SLEEP{5};
+
+            // A single slot of the queue
+            // turn is even while the slot is free for lap turn / 2, and odd once it holds that lap's message
+            struct Message
+            {
+                std::atomic<uint64_t> turn = 0;
+                Level level;
+                uint16_t length;
+                char text[MAX_MESSAGE_LENGTH];
+            };
+
+            // Formatting stream of the calling thread
+            static std::ostringstream& GetStream();
+
+            // Copies a message into the queue, or drops it if the queue is full
+            static void Push(Level level, const std::string& text);
+
+            // Writes every queued message followed by text (if not nullptr), returns false if nothing was written
+            static bool Drain(Level level = Level::Info, const std::string* text = nullptr);
+
+            // Prefix written before a message of level
+            static const char* GetPrefix(Level level);
+
+            // Writer thread entrypoint
+            static void WriterLoop();
+
+            // Bounded multi-producer / single-consumer ring, producers claim slots by advancing head
+            static Message queue[QUEUE_SIZE];
+            static inline std::atomic<uint64_t> head = 0;
+            static inline uint64_t tail = 0;
+
+            // Only one thread drains the queue at a time (the writer thread, or Flush() / synchronous logging)
+            static inline std::mutex drainMutex;
+
+            static inline std::thread writer;
+            static inline std::atomic<bool> running = false;
+            static inline std::atomic<size_t> dropped = 0;
+            static inline size_t droppedReported = 0;
+    };
+}
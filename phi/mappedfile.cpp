@@ -0,0 +1,87 @@
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Phi
+{
+    // Destructor
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    // Maps the whole file read-only
+    bool MappedFile::Open(const std::string& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+        {
+            fileHandle = nullptr;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0)
+        {
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mappingHandle)
+            {
+                data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+                size = data ? (size_t)fileSize.QuadPart : 0;
+            }
+        }
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file == -1) return false;
+
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (map != MAP_FAILED)
+            {
+                data = (const unsigned char*)map;
+                size = info.st_size;
+            }
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        close(file);
+#endif
+
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Unmaps the file
+    void MappedFile::Close()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        if (data) munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Phi
+{
+    // Read-only memory mapping of an entire file
+    // The OS pages the file in on demand, so reading from it never copies it into a temporary buffer first
+    class MappedFile
+    {
+        // Interface
+        public:
+
+            MappedFile() = default;
+            ~MappedFile();
+
+            // Delete copy constructor/assignment
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            // Delete move constructor/assignment
+            MappedFile(MappedFile&& other) = delete;
+            void operator=(MappedFile&& other) = delete;
+
+            // Maps the file, returns false if it doesn't exist, is empty, or can't be mapped
+            bool Open(const std::string& path);
+
+            // Releases the mapping, all pointers into it become invalid
+            void Close();
+
+            // Accessors
+            inline const unsigned char* GetData() const { return data; };
+            inline size_t GetSize() const { return size; };
+
+        // Data / implementation
+        private:
+
+            const unsigned char* data = nullptr;
+            size_t size = 0;
+#ifdef _WIN32
+            void* fileHandle = nullptr;
+            void* mappingHandle = nullptr;
+#endif
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <type_traits> // Important for std::is_same_v
 #include <string>
@@ -11,6 +12,7 @@
 
 #include "camera.hpp"
 #include "gpubuffer.hpp"
+#include "log.hpp"
 #include "texture2d.hpp"
 #include "vertex.hpp"
 #include "vertexattributes.hpp"
@@ -64,37 +66,43 @@ namespace Phi
         };
 
         // Reference counter for all meshes
-        static inline int refCount = 0;
+        // NOTE: Atomic so meshes may be generated on worker threads
+        static inline std::atomic<int> refCount = 0;
 
         // Texture storage for all meshes
         static inline std::unordered_map<std::string, Texture> loadedTextures;
 
-        // Instance buffer for all meshes
+        // Instance buffer for all meshes, every instanced draw allocates from the current frame's section
         static inline GPUBuffer* instanceBuffer = nullptr;
         static const size_t INSTANCE_BUFFER_SIZE = sizeof(glm::mat4) * 10'000;
 
-        // Reference counter helpers
-        static void IncreaseReferences()
+        // Lazily initializes the shared instance buffer
+        // Only called when drawing, so constructing a mesh never touches the OpenGL context
+        static GPUBuffer* GetInstanceBuffer()
         {
-            // Initialize static resources for all meshes
-            if (refCount == 0)
+            if (!instanceBuffer)
             {
-                std::cout << "First mesh, instance buffer initialized" << std::endl;
-                instanceBuffer = new GPUBuffer(BufferType::DynamicDoubleBuffer, INSTANCE_BUFFER_SIZE);
+                PHI_LOG_INFO("First instanced draw, instance buffer initialized");
+                instanceBuffer = new GPUBuffer(BufferType::DynamicPerFrame, INSTANCE_BUFFER_SIZE);
             }
 
+            return instanceBuffer;
+        }
+
+        // Reference counter helpers
+        static void IncreaseReferences()
+        {
             refCount++;
         }
 
         static void DecreaseReferences()
         {
-            refCount--;
-
             // Delete static resources if we are the last mesh
-            if (refCount == 0)
+            if (--refCount == 0 && instanceBuffer)
             {
-                std::cout << "Last mesh destroyed, instance buffer deleted" << std::endl;
+                PHI_LOG_INFO("Last mesh destroyed, instance buffer deleted");
                 delete instanceBuffer;
+                instanceBuffer = nullptr;
             }
         }
     };
@@ -121,9 +129,11 @@ namespace Phi
             Mesh(Mesh&& other)
             {
                 // Steal resources from other mesh
-                vertices = other.vertices;
-                indices = other.indices;
+                vertices = std::move(other.vertices);
+                indices = std::move(other.indices);
                 useIndices = other.useIndices;
+                vertexCount = other.vertexCount;
+                indexCount = other.indexCount;
                 vertexAttributes = other.vertexAttributes;
                 vertexBuffer = other.vertexBuffer;
                 indexBuffer = other.indexBuffer;
@@ -142,7 +152,10 @@ namespace Phi
                     other.textures[i] = nullptr;
                 }
 
-                std::cout << "Mesh moved from " << &other << " to " << this << std::endl;
+                // We are a new mesh, even if our resources are stolen
+                MeshResources::IncreaseReferences();
+
+                PHI_LOG_DEBUG("Mesh moved from ", &other, " to ", this);
             };
 
             // Delete move assignment operator
@@ -166,6 +179,15 @@ namespace Phi
             // If this mesh will only be drawn by a RenderBatch object, you do not have to Commit() any resources
             void Commit();
 
+            // Commits vertex data straight from memory (e.g. a mapped file) without storing a copy in the mesh
+            // NOTE: GetVertices() / GetIndices() stay empty, so these meshes can't be used by a RenderBatch
+            void Commit(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount);
+
+            // Commits vertex data in any internal format, for meshes whose format is only known at runtime (e.g. imported models)
+            // NOTE: The data doesn't have to match Vertex, shaders just see the attributes of format
+            void Commit(VertexFormat format, const void* vertexData, size_t vertexSize, size_t vertexCount,
+                        const GLuint* indexData, size_t indexCount);
+
             // Immediately render to the current FBO
             void Draw(const Shader& shader) const;
 
@@ -195,6 +217,10 @@ namespace Phi
             bool useTextures = false;
             GLenum mode = GL_TRIANGLES;
 
+            // Number of vertices / indices in the committed buffers
+            GLsizei vertexCount = 0;
+            GLsizei indexCount = 0;
+
             // OpenGL Resources
             MeshResources::Texture* textures[(int)TexUnit::MAX_TEXTURES] = {nullptr};
             VertexAttributes* vertexAttributes = nullptr;
@@ -207,7 +233,7 @@ namespace Phi
     template <typename Vertex>
     Mesh<Vertex>::Mesh(bool useIndices) : useIndices(useIndices)
     {
-        // std::cout << "Mesh created @" << this <<  std::endl;
+        PHI_LOG_DEBUG("Mesh created @", this);
         MeshResources::IncreaseReferences();
     }
 
@@ -322,7 +348,7 @@ namespace Phi
         // Ensure this mesh doesn't already have this texture type loaded
         if (textures[(int)type])
         {
-            std::cout << "Mesh @" << this << " already contains a texture of type " << (int)type << std::endl;
+            PHI_LOG_WARNING("Mesh @", this, " already contains a texture of type ", (int)type);
             return;
         }
 
@@ -344,67 +370,55 @@ namespace Phi
         if (!useTextures) useTextures = true;
 
         // Final output if successful
-        std::cout << "Mesh texture loaded: " << path << std::endl;
+        PHI_LOG_INFO("Mesh texture loaded: ", path);
     }
 
     template <typename Vertex>
     void Mesh<Vertex>::Commit()
     {
+        Commit(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    template <typename Vertex>
+    void Mesh<Vertex>::Commit(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount)
+    {
+        // VAO format depends on the vertex type
+        // This is ugly, but it works
+        VertexFormat format = VertexFormat::POS;
+        if (std::is_same_v<Vertex, VertexPos>) format = VertexFormat::POS;
+        else if (std::is_same_v<Vertex, VertexPosColor>) format = VertexFormat::POS_COLOR;
+        else if (std::is_same_v<Vertex, VertexPosColorNorm>) format = VertexFormat::POS_COLOR_NORM;
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv>) format = VertexFormat::POS_COLOR_NORM_UV;
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv1Uv2>) format = VertexFormat::POS_COLOR_NORM_UV1_UV2;
+        else if (std::is_same_v<Vertex, VertexPosColorUv>) format = VertexFormat::POS_COLOR_UV;
+        else if (std::is_same_v<Vertex, VertexPosNorm>) format = VertexFormat::POS_NORM;
+        else if (std::is_same_v<Vertex, VertexPosNormUv>) format = VertexFormat::POS_NORM_UV;
+        else if (std::is_same_v<Vertex, VertexPosUv>) format = VertexFormat::POS_UV;
+        else FatalError("Mesh Commit: Custom vertex format not supported yet, please use one of the internal vertex formats");
+
+        Commit(format, vertexData, sizeof(Vertex), vertexCount, indexData, indexCount);
+    }
+
+    template <typename Vertex>
+    void Mesh<Vertex>::Commit(VertexFormat format, const void* vertexData, size_t vertexSize, size_t vertexCount,
+                              const GLuint* indexData, size_t indexCount)
+    {
+        this->vertexCount = (GLsizei)vertexCount;
+        this->indexCount = (GLsizei)indexCount;
+
         // Create VBO and EBO
-        vertexBuffer = new GPUBuffer(BufferType::Static, sizeof(Vertex) * vertices.size(), vertices.data());
+        vertexBuffer = new GPUBuffer(BufferType::Static, vertexSize * vertexCount, vertexData);
 
         if (useIndices)
         {
-            indexBuffer = new GPUBuffer(BufferType::Static, sizeof(GLuint) * indices.size(), indices.data());
-        }
-        
-        // VAO creation (Depends on vertex format)
-        // This is ugly, but it works
-        if (std::is_same_v<Vertex, VertexPos>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColor>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNorm>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNormUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNormUv1Uv2>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV1_UV2, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosNorm>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosNormUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        
-        if (!vertexAttributes)
-        {
-            FatalError("Mesh Commit: Custom vertex format not supported yet, please use one of the internal vertex formats");
+            indexBuffer = new GPUBuffer(BufferType::Static, sizeof(GLuint) * indexCount, indexData);
         }
 
-        std::cout << "Mesh resources committed to VRAM" << std::endl;
-    }
+        // VAO creation
+        vertexAttributes = new VertexAttributes(format, vertexBuffer, useIndices ? indexBuffer : nullptr);
 
+        PHI_LOG_DEBUG("Mesh resources committed to VRAM");
+    }
 
     template <typename Vertex>
     void Mesh<Vertex>::Draw(const Shader& shader) const
@@ -426,15 +440,12 @@ namespace Phi
         // Issue draw call
         if (useIndices)
         {
-            glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, 0);
+            glDrawElements(mode, indexCount, GL_UNSIGNED_INT, 0);
         }
         else
         {
-            glDrawArrays(mode, 0, vertices.size());
+            glDrawArrays(mode, 0, vertexCount);
         }
-
-        // Unbind VAO
-        glBindVertexArray(0);
     }
 
 
@@ -442,6 +453,15 @@ namespace Phi
     template <typename InstanceData>
     void Mesh<Vertex>::DrawInstances(const Shader& shader, const std::vector<InstanceData>& iData) const
     {
+        if (iData.empty()) return;
+
+        // Upload instance data
+        size_t instanceBytes = iData.size() * sizeof(InstanceData);
+        GPUBuffer* instanceBuffer = MeshResources::GetInstanceBuffer();
+        GLintptr offset = instanceBuffer->Allocate(instanceBytes);
+        if (offset < 0) return;
+        instanceBuffer->Write(iData.data(), instanceBytes);
+
         shader.Use();
 
         // Bind the VAO
@@ -456,27 +476,18 @@ namespace Phi
             }
         }
 
-        // Upload instance data and bind the buffer
-        MeshResources::instanceBuffer->Sync();
-        MeshResources::instanceBuffer->Write(iData.data(), iData.size() * sizeof(InstanceData));
-        MeshResources::instanceBuffer->BindRange(GL_SHADER_STORAGE_BUFFER, (int)SSBOBinding::InstanceBuffer, MeshResources::INSTANCE_BUFFER_SIZE * MeshResources::instanceBuffer->GetCurrentSection(), MeshResources::INSTANCE_BUFFER_SIZE);
+        // Bind the instance data
+        instanceBuffer->BindRange(GL_SHADER_STORAGE_BUFFER, (int)SSBOBinding::InstanceBuffer, offset, instanceBytes);
 
         // Issue draw call
         if (useIndices)
         {
-            glDrawElementsInstanced(mode, indices.size(), GL_UNSIGNED_INT, 0, iData.size());
+            glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, 0, iData.size());
         }
         else
         {
-            glDrawArraysInstanced(mode, 0, vertices.size(), iData.size());
+            glDrawArraysInstanced(mode, 0, vertexCount, iData.size());
         }
-
-        // Lock the buffer section and switch to the next one
-        MeshResources::instanceBuffer->Lock();
-        MeshResources::instanceBuffer->SwapSections();
-
-        // Unbind VAO
-        glBindVertexArray(0);
     }
 
     template <typename Vertex>
@@ -499,15 +510,12 @@ namespace Phi
         // Issue draw call
         if (useIndices)
         {
-            glDrawElementsInstanced(mode, indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+            glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
         }
         else
         {
-            glDrawArraysInstanced(mode, 0, vertices.size(), instanceCount);
+            glDrawArraysInstanced(mode, 0, vertexCount, instanceCount);
         }
-
-        // Unbind VAO
-        glBindVertexArray(0);
     }
 
     template <typename Vertex>
@@ -515,6 +523,8 @@ namespace Phi
     {
         vertices.clear();
         indices.clear();
+        vertexCount = 0;
+        indexCount = 0;
 
         // Manage static texture resources from our pointer
         for (MeshResources::Texture* tex : textures)
@@ -531,7 +541,7 @@ namespace Phi
                     MeshResources::loadedTextures.erase(tex->path);
                     tex = nullptr;
                     
-                    std::cout << "Texture unloaded: unused by any meshes" << std::endl;
+                    PHI_LOG_INFO("Texture unloaded: unused by any meshes");
                 }
             }
         }
@@ -0,0 +1,150 @@
+#include "meshfile.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include "log.hpp"
+
+namespace Phi
+{
+    // Reads the source file's size and modification time into the header
+    bool MeshFile::GetSourceInfo(const std::string& sourcePath, Header& header)
+    {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(sourcePath, error);
+        if (error) return false;
+        auto time = std::filesystem::last_write_time(sourcePath, error);
+        if (error) return false;
+
+        header.sourceSize = size;
+        header.sourceTime = time.time_since_epoch().count();
+        return true;
+    }
+
+    // Maps the cache file, then checks its header, source file and every range in the mesh table
+    bool MeshFile::Open(const std::string& path, const std::string& sourcePath)
+    {
+        meshTable = nullptr;
+
+        Header expected;
+        if (!GetSourceInfo(sourcePath, expected) || !file.Open(path)) return false;
+
+        const unsigned char* data = file.GetData();
+        size_t size = file.GetSize();
+
+        bool valid = size >= sizeof(Header);
+        if (valid)
+        {
+            header = *(const Header*)data;
+            valid = header.magic == MAGIC && header.version == VERSION &&
+                    header.sourceSize == expected.sourceSize && header.sourceTime == expected.sourceTime;
+        }
+
+        size_t tableEnd = sizeof(Header) + sizeof(MeshEntry) * (valid ? header.meshCount : 0);
+        valid = valid && size >= tableEnd;
+        if (valid)
+        {
+            // Every blob must lie inside the file
+            auto inside = [&](uint64_t offset, uint64_t length) { return offset >= tableEnd && offset <= size && length <= size - offset; };
+
+            meshTable = (const MeshEntry*)(data + sizeof(Header));
+            for (uint32_t i = 0; i < header.meshCount && valid; i++)
+            {
+                const MeshEntry& entry = meshTable[i];
+                valid = inside(entry.vertexOffset, (uint64_t)entry.vertexCount * header.vertexSize) &&
+                        inside(entry.indexOffset, (uint64_t)entry.indexCount * sizeof(uint32_t));
+                for (int unit = 0; unit < MAX_TEXTURES && valid; unit++)
+                {
+                    valid = inside(entry.pathOffset[unit], entry.pathLength[unit]);
+                }
+            }
+        }
+
+        if (!valid)
+        {
+            meshTable = nullptr;
+            file.Close();
+        }
+        return valid;
+    }
+
+    // Returns a mesh, pointing into the mapped file
+    MeshFile::MeshData MeshFile::GetMesh(int index) const
+    {
+        const MeshEntry& entry = meshTable[index];
+        const unsigned char* data = file.GetData();
+
+        MeshData mesh{};
+        mesh.vertices = data + entry.vertexOffset;
+        mesh.vertexCount = entry.vertexCount;
+        mesh.indices = (const uint32_t*)(data + entry.indexOffset);
+        mesh.indexCount = entry.indexCount;
+        for (int unit = 0; unit < MAX_TEXTURES; unit++)
+        {
+            mesh.texturePaths[unit].assign((const char*)data + entry.pathOffset[unit], entry.pathLength[unit]);
+        }
+        return mesh;
+    }
+
+    // Lays out and writes every mesh
+    bool MeshFile::Write(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexSize,
+                         const std::vector<MeshData>& meshes)
+    {
+        Header header;
+        header.vertexFormat = vertexFormat;
+        header.vertexSize = vertexSize;
+        header.meshCount = (uint32_t)meshes.size();
+        if (!GetSourceInfo(sourcePath, header)) return false;
+
+        // Assign every blob an aligned offset after the table
+        std::vector<MeshEntry> table(meshes.size());
+        std::vector<std::pair<const void*, uint64_t>> blobs;
+        uint64_t offset = sizeof(Header) + sizeof(MeshEntry) * table.size();
+        auto place = [&](const void* blob, uint64_t length)
+        {
+            offset = (offset + 15) & ~15ull;
+            uint64_t start = offset;
+            blobs.push_back({blob, length});
+            offset += length;
+            return start;
+        };
+
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData& mesh = meshes[i];
+            MeshEntry& entry = table[i];
+            entry.vertexCount = mesh.vertexCount;
+            entry.indexCount = mesh.indexCount;
+            entry.vertexOffset = place(mesh.vertices, (uint64_t)mesh.vertexCount * vertexSize);
+            entry.indexOffset = place(mesh.indices, (uint64_t)mesh.indexCount * sizeof(uint32_t));
+            for (int unit = 0; unit < MAX_TEXTURES; unit++)
+            {
+                entry.pathLength[unit] = (uint32_t)mesh.texturePaths[unit].size();
+                entry.pathOffset[unit] = place(mesh.texturePaths[unit].data(), entry.pathLength[unit]);
+            }
+        }
+
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+        {
+            PHI_LOG_ERROR("Couldn't write mesh cache: ", path);
+            return false;
+        }
+
+        ofs.write((const char*)&header, sizeof(Header));
+        ofs.write((const char*)table.data(), sizeof(MeshEntry) * table.size());
+
+        uint64_t written = sizeof(Header) + sizeof(MeshEntry) * table.size();
+        for (const auto& [blob, length] : blobs)
+        {
+            // Pad up to the blob's aligned offset
+            static const char padding[16] = {};
+            uint64_t aligned = (written + 15) & ~15ull;
+            ofs.write(padding, aligned - written);
+            if (length) ofs.write((const char*)blob, length);
+            written = aligned + length;
+        }
+
+        return (bool)ofs;
+    }
+}
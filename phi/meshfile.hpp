@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+
+namespace Phi
+{
+    // Binary mesh cache (.phmesh), written by Model the first time a file is imported
+    // Vertex / index data is stored exactly as it is uploaded, so a mapped file can be passed straight to GPUBuffer
+    //
+    // Layout (little endian):
+    // Header
+    // Mesh table, meshCount entries
+    // Vertex / index / texture path data, referenced by offset from the table (16 byte aligned)
+    class MeshFile
+    {
+        // Interface
+        public:
+
+            static constexpr uint32_t MAGIC = 0x534D4850; // "PHMS"
+            static constexpr uint32_t VERSION = 2;
+            static constexpr int MAX_TEXTURES = 6;
+
+            struct Header
+            {
+                uint32_t magic = MAGIC;
+                uint32_t version = VERSION;
+                uint32_t vertexFormat = 0;  // Phi::VertexFormat
+                uint32_t vertexSize = 0;
+                uint32_t meshCount = 0;
+                uint32_t reserved = 0;
+
+                // Size / modification time of the source file, the cache is stale if either changes
+                uint64_t sourceSize = 0;
+                int64_t sourceTime = 0;
+            };
+
+            struct MeshEntry
+            {
+                uint64_t vertexOffset;
+                uint64_t indexOffset;
+                uint32_t vertexCount;
+                uint32_t indexCount;
+
+                // Texture path per texture unit, length 0 if the unit is unused
+                uint64_t pathOffset[MAX_TEXTURES];
+                uint32_t pathLength[MAX_TEXTURES];
+            };
+
+            // A single mesh, pointing into the mapped file (or into memory when writing)
+            struct MeshData
+            {
+                const void* vertices;
+                uint32_t vertexCount;
+                const uint32_t* indices;
+                uint32_t indexCount;
+                std::string texturePaths[MAX_TEXTURES];
+            };
+
+            MeshFile() = default;
+            ~MeshFile() = default;
+
+            // Delete copy constructor/assignment
+            MeshFile(const MeshFile&) = delete;
+            MeshFile& operator=(const MeshFile&) = delete;
+
+            // Delete move constructor/assignment
+            MeshFile(MeshFile&& other) = delete;
+            void operator=(MeshFile&& other) = delete;
+
+            // Maps a cache file and validates it against the source file
+            // Returns false without printing anything if the cache is missing or stale
+            bool Open(const std::string& path, const std::string& sourcePath);
+
+            // Writes a cache file for sourcePath
+            static bool Write(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexSize,
+                              const std::vector<MeshData>& meshes);
+
+            // Accessors, only valid after a successful Open()
+            inline int GetMeshCount() const { return (int)header.meshCount; };
+            inline uint32_t GetVertexFormat() const { return header.vertexFormat; };
+            inline uint32_t GetVertexSize() const { return header.vertexSize; };
+            MeshData GetMesh(int index) const;
+
+        // Data / implementation
+        private:
+
+            // Fills in the source file's size / modification time, returns false if it doesn't exist
+            static bool GetSourceInfo(const std::string& sourcePath, Header& header);
+
+            Header header;
+            const MeshEntry* meshTable = nullptr;
+            MappedFile file;
+    };
+}
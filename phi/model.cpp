@@ -1,22 +1,91 @@
 #include "model.hpp"
+#include "log.hpp"
 
 namespace Phi
 {    
+    // Cached meshes store one texture path per unit
+    static_assert(MeshFile::MAX_TEXTURES == (int)TexUnit::MAX_TEXTURES);
+
     Model::Model(const std::string& objPath)
     {
+        PHI_TRACE_SCOPE("Model Load", objPath);
+
+        // Load the binary cache if it is up to date, this skips assimp entirely
+        // NOTE: Vertex data is uploaded straight from the mapped file
+        std::string cachePath = objPath + ".phmesh";
+        MeshFile cache;
+        if (cache.Open(cachePath, objPath) &&
+            cache.GetVertexFormat() <= (uint32_t)VertexFormat::POS_UV &&
+            cache.GetVertexSize() == GetVertexSize((VertexFormat)cache.GetVertexFormat()))
+        {
+            for (int i = 0; i < cache.GetMeshCount(); ++i)
+            {
+                AddMesh(cache.GetMesh(i), (VertexFormat)cache.GetVertexFormat());
+            }
+
+            PHI_LOG_INFO("Model loaded from cache: ", cachePath);
+            return;
+        }
+
         // Create the importer and read the model file
+        // Identical vertices are welded, then triangles are reordered for the post-transform vertex cache
         Assimp::Importer importer;
-        const aiScene *scene = importer.ReadFile(objPath, aiProcess_Triangulate);
+        const aiScene *scene = nullptr;
+        {
+            PHI_TRACE_SCOPE("Assimp Import", objPath);
+            scene = importer.ReadFile(objPath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality);
+        }
 
         // Ensure the scene was imported correctly
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
         {
-            std::cout << "Error: Assimp: " << importer.GetErrorString() << std::endl;
+            PHI_LOG_ERROR("Assimp: ", importer.GetErrorString());
             return;
         }
 
         // Process all nodes, starting at the root node
-        ProcessNode(scene->mRootNode, scene);
+        std::vector<ImportedMesh> imported;
+        ProcessNode(scene->mRootNode, scene, imported);
+
+        // Pick the smallest internal format covering every attribute present in any of the meshes
+        Attributes attributes;
+        for (const ImportedMesh& mesh : imported)
+        {
+            attributes.colors |= mesh.attributes.colors;
+            attributes.normals |= mesh.attributes.normals;
+            attributes.uv1 |= mesh.attributes.uv1;
+            attributes.uv2 |= mesh.attributes.uv2;
+        }
+        VertexFormat format = ChooseFormat(attributes);
+        size_t vertexSize = GetVertexSize(format);
+
+        // Create the meshes and write the cache for the next launch
+        std::vector<std::vector<GLfloat>> packed(imported.size());
+        std::vector<MeshFile::MeshData> meshData;
+        size_t vertexCount = 0;
+        for (size_t i = 0; i < imported.size(); ++i)
+        {
+            ImportedMesh& mesh = imported[i];
+            OptimizeVertexFetch(mesh);
+            packed[i] = PackVertices(mesh.vertices, attributes);
+            vertexCount += mesh.vertices.size();
+
+            MeshFile::MeshData data{};
+            data.vertices = packed[i].data();
+            data.vertexCount = (uint32_t)mesh.vertices.size();
+            data.indices = mesh.indices.data();
+            data.indexCount = (uint32_t)mesh.indices.size();
+            std::copy(std::begin(mesh.texturePaths), std::end(mesh.texturePaths), data.texturePaths);
+            AddMesh(data, format);
+            meshData.push_back(std::move(data));
+        }
+
+        PHI_LOG_INFO("Model imported: ", objPath, " (", vertexCount, " vertices, ", vertexSize, " bytes each)");
+
+        if (MeshFile::Write(cachePath, objPath, (uint32_t)format, (uint32_t)vertexSize, meshData))
+        {
+            PHI_LOG_INFO("Model cache written: ", cachePath);
+        }
     }
 
     Model::~Model()
@@ -33,26 +102,29 @@ namespace Phi
 
     // For Model::DrawInstances(...), check the header (templated code must be accessible)
 
-    void Model::ProcessNode(aiNode* node, const aiScene* scene)
+    void Model::ProcessNode(aiNode* node, const aiScene* scene, std::vector<ImportedMesh>& imported)
     {
-        // Add all meshes from the node
+        // Import all meshes from the node
         for(size_t i = 0; i < node->mNumMeshes; ++i)
         {
-            AddMesh(scene->mMeshes[node->mMeshes[i]], scene);
+            ImportMesh(scene->mMeshes[node->mMeshes[i]], scene, imported.emplace_back());
         }
 
         // Process all sub-nodes
         for(size_t i = 0; i < node->mNumChildren; ++i)
         {
-            ProcessNode(node->mChildren[i], scene);
+            ProcessNode(node->mChildren[i], scene, imported);
         }
     }
 
-    void Model::AddMesh(aiMesh* mesh, const aiScene* scene)
+    void Model::ImportMesh(aiMesh* mesh, const aiScene* scene, ImportedMesh& imported)
     {
-        // Initialize vertex data vectors
-        std::vector<GLuint> indices;
-        std::vector<Vertex> vertices;
+        std::vector<GLuint>& indices = imported.indices;
+        std::vector<Vertex>& vertices = imported.vertices;
+
+        // Record which attributes the mesh actually has
+        imported.attributes = {mesh->mColors[0] != nullptr, mesh->mNormals != nullptr,
+                               mesh->mTextureCoords[0] != nullptr, mesh->mTextureCoords[1] != nullptr};
 
         // Copy all vertices from the mesh
         for (size_t i = 0; i < mesh->mNumVertices; ++i)
@@ -105,68 +177,108 @@ namespace Phi
             }
         }
 
-        // Construct mesh object in-place (no copy)
-        meshes.emplace_back(&vertices, &indices);
-
-        // Grab a reference to the one we just emplaced
-        Mesh<Vertex>& meshObj = meshes[meshes.size() - 1];
-
-        // Load material textures
+        // Grab the material texture paths
         if (mesh->mMaterialIndex >= 0)
         {
-            // Grab the material associated with the mesh
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+            ImportTextures(material, aiTextureType_DIFFUSE, TexUnit::ALBEDO_1, TexUnit::ALBEDO_2, imported);
+            ImportTextures(material, aiTextureType_SPECULAR, TexUnit::SPECULAR_1, TexUnit::SPECULAR_2, imported);
+            ImportTextures(material, aiTextureType_NORMALS, TexUnit::NORMAL_1, TexUnit::NORMAL_2, imported);
+        }
+    }
+
+    void Model::ImportTextures(aiMaterial* material, aiTextureType type, TexUnit first, TexUnit last, ImportedMesh& imported)
+    {
+        // Stop importing textures if we have no more room
+        int count = std::min((int)material->GetTextureCount(type), (int)last - (int)first + 1);
+        for (int i = 0; i < count; ++i)
+        {
             aiString path;
+            material->GetTexture(type, i, &path);
+            imported.texturePaths[(int)first + i] = path.C_Str();
+        }
+    }
 
-            // TODO: Turn below into AddMaterialTextures(aiMaterial*, Mesh&, aiTextureType, TexUnitStart, TexUnitEnd)
+    // Reorders vertices by their first use in the index buffer, so vertex fetches walk through memory in order
+    // Vertices no triangle references are dropped
+    void Model::OptimizeVertexFetch(ImportedMesh& mesh)
+    {
+        const GLuint UNUSED = 0xFFFFFFFF;
+        std::vector<GLuint> remap(mesh.vertices.size(), UNUSED);
+        std::vector<Vertex> ordered;
+        ordered.reserve(mesh.vertices.size());
 
-            // Load albedo textures
-            for (int i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); ++i)
+        for (GLuint& index : mesh.indices)
+        {
+            if (remap[index] == UNUSED)
             {
-                // Stop importing textures if we have no more room
-                if (i + (int)TexUnit::ALBEDO_1 > (int)TexUnit::ALBEDO_2) return;
-
-                // Grab the path and load the texture into the mesh object
-                material->GetTexture(aiTextureType_DIFFUSE, i, &path);
-                meshObj.AddTexture((TexUnit)((int)TexUnit::ALBEDO_1 + i),
-                                    path.C_Str(),
-                                    GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
-                                    GL_NEAREST, GL_NEAREST,
-                                    true);
+                remap[index] = (GLuint)ordered.size();
+                ordered.push_back(mesh.vertices[index]);
             }
+            index = remap[index];
+        }
 
-            // Load specular maps
-            for (int i = 0; i < material->GetTextureCount(aiTextureType_SPECULAR); ++i)
-            {
-                // Stop importing textures if we have no more room
-                if (i + (int)TexUnit::SPECULAR_1 > (int)TexUnit::SPECULAR_2) return;
-
-                // Grab the path and load the texture into the mesh object
-                material->GetTexture(aiTextureType_SPECULAR, i, &path);
-                meshObj.AddTexture((TexUnit)((int)TexUnit::SPECULAR_1 + i),
-                                    path.C_Str(),
-                                    GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
-                                    GL_NEAREST, GL_NEAREST,
-                                    true);
-            }
+        mesh.vertices.swap(ordered);
+    }
 
-            // Load normal maps
-            for (int i = 0; i < material->GetTextureCount(aiTextureType_NORMALS); ++i)
-            {
-                // Stop importing textures if we have no more room
-                if (i + (int)TexUnit::NORMAL_1 > (int)TexUnit::NORMAL_2) return;
-
-                // Grab the path and load the texture into the mesh object
-                material->GetTexture(aiTextureType_NORMALS, i, &path);
-                meshObj.AddTexture((TexUnit)((int)TexUnit::NORMAL_1 + i),
-                                    path.C_Str(),
-                                    GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
-                                    GL_NEAREST, GL_NEAREST,
-                                    true);
-            }
+    // Returns the smallest internal format containing every present attribute
+    // Attributes are widened to match the format if there is no exact one
+    VertexFormat Model::ChooseFormat(Attributes& attributes)
+    {
+        // Only the full import format has a second UV set
+        if (attributes.uv2)
+        {
+            attributes = {true, true, true, true};
+            return VertexFormat::POS_COLOR_NORM_UV1_UV2;
+        }
+
+        if (attributes.colors)
+        {
+            if (attributes.normals) return attributes.uv1 ? VertexFormat::POS_COLOR_NORM_UV : VertexFormat::POS_COLOR_NORM;
+            return attributes.uv1 ? VertexFormat::POS_COLOR_UV : VertexFormat::POS_COLOR;
+        }
+
+        if (attributes.normals) return attributes.uv1 ? VertexFormat::POS_NORM_UV : VertexFormat::POS_NORM;
+        return attributes.uv1 ? VertexFormat::POS_UV : VertexFormat::POS;
+    }
+
+    // Packs vertices with only the given attributes
+    // NOTE: Every internal format stores its attributes in the same order (pos, color, normal, uvs)
+    std::vector<GLfloat> Model::PackVertices(const std::vector<Vertex>& vertices, const Attributes& attributes)
+    {
+        std::vector<GLfloat> packed;
+        packed.reserve(vertices.size() * sizeof(Vertex) / sizeof(GLfloat));
+
+        for (const Vertex& v : vertices)
+        {
+            packed.insert(packed.end(), {v.x, v.y, v.z});
+            if (attributes.colors) packed.insert(packed.end(), {v.r, v.g, v.b, v.a});
+            if (attributes.normals) packed.insert(packed.end(), {v.nx, v.ny, v.nz});
+            if (attributes.uv1) packed.insert(packed.end(), {v.u1, v.v1});
+            if (attributes.uv2) packed.insert(packed.end(), {v.u2, v.v2});
+        }
+
+        return packed;
+    }
+
+    void Model::AddMesh(const MeshFile::MeshData& data, VertexFormat format)
+    {
+        // Construct mesh object in-place and grab a reference to it
+        Mesh<Vertex>& meshObj = meshes.emplace_back(true);
+
+        // Load material textures
+        for (int unit = 0; unit < (int)TexUnit::MAX_TEXTURES; ++unit)
+        {
+            if (data.texturePaths[unit].empty()) continue;
+
+            meshObj.AddTexture((TexUnit)unit,
+                                data.texturePaths[unit],
+                                GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
+                                GL_NEAREST, GL_NEAREST,
+                                true);
         }
 
-        // Commit the mesh data
-        meshObj.Commit();
+        // Commit the mesh data, no copy is kept in the mesh itself
+        meshObj.Commit(format, data.vertices, GetVertexSize(format), data.vertexCount, data.indices, data.indexCount);
     }
-}
\ No newline at end of file
+}
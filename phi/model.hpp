@@ -7,6 +7,8 @@
 #include <glm/glm.hpp>
 
 #include "mesh.hpp"
+#include "meshfile.hpp"
+#include "trace.hpp"
 
 namespace Phi
 {
@@ -15,9 +17,12 @@ namespace Phi
         // Interface
         public:
             
-            // Internal vertex format for models
+            // Import vertex format for models
+            // NOTE: Meshes are committed in the smallest internal format that covers the attributes the file has,
+            // so shaders should only rely on the locations of the attributes the model actually provides
             typedef VertexPosColorNormUv1Uv2 Vertex;
 
+            // Loads objPath + ".phmesh" if it is up to date, otherwise imports objPath with assimp and writes it
             Model(const std::string& objPath);
             ~Model();
 
@@ -45,31 +50,56 @@ namespace Phi
             
             std::vector<Mesh<Vertex>> meshes;
 
+            // Vertex attributes present in an imported file
+            struct Attributes
+            {
+                bool colors = false;
+                bool normals = false;
+                bool uv1 = false;
+                bool uv2 = false;
+            };
+
+            // A mesh as imported by assimp, kept until it is committed and written to the cache
+            struct ImportedMesh
+            {
+                std::vector<Vertex> vertices;
+                std::vector<GLuint> indices;
+                std::string texturePaths[(int)TexUnit::MAX_TEXTURES];
+                Attributes attributes;
+            };
+
             // Helper assimp loading / processing methods
-            void ProcessNode(aiNode* node, const aiScene* scene);
-            void AddMesh(aiMesh* mesh, const aiScene* scene);
+            void ProcessNode(aiNode* node, const aiScene* scene, std::vector<ImportedMesh>& imported);
+            void ImportMesh(aiMesh* mesh, const aiScene* scene, ImportedMesh& imported);
+            void ImportTextures(aiMaterial* material, aiTextureType type, TexUnit first, TexUnit last, ImportedMesh& imported);
+
+            // Import pipeline stages, run after assimp has welded the vertices and reordered the triangles
+            static void OptimizeVertexFetch(ImportedMesh& mesh);
+            static VertexFormat ChooseFormat(Attributes& attributes);
+            static std::vector<GLfloat> PackVertices(const std::vector<Vertex>& vertices, const Attributes& attributes);
+
+            // Creates a mesh from imported or cached data
+            void AddMesh(const MeshFile::MeshData& data, VertexFormat format);
     };
 
     // Templated implementations
     template <typename InstanceData>
     void Model::DrawInstances(const Shader& shader, const std::vector<InstanceData>& iData) const
     {
+        if (iData.empty()) return;
+
         // Upload instance data and bind the buffer
-        MeshResources::instanceBuffer->Sync();
-        MeshResources::instanceBuffer->Write(iData.data(), iData.size() * sizeof(InstanceData));
-        MeshResources::instanceBuffer->BindRange(GL_SHADER_STORAGE_BUFFER,
-                                                (int)SSBOBinding::InstanceBuffer,
-                                                MeshResources::INSTANCE_BUFFER_SIZE * MeshResources::instanceBuffer->GetCurrentSection(),
-                                                MeshResources::INSTANCE_BUFFER_SIZE);
+        size_t instanceBytes = iData.size() * sizeof(InstanceData);
+        GPUBuffer* instanceBuffer = MeshResources::GetInstanceBuffer();
+        GLintptr offset = instanceBuffer->Allocate(instanceBytes);
+        if (offset < 0) return;
+        instanceBuffer->Write(iData.data(), instanceBytes);
+        instanceBuffer->BindRange(GL_SHADER_STORAGE_BUFFER, (int)SSBOBinding::InstanceBuffer, offset, instanceBytes);
         
         // Instance all meshes without reuploading data
         for (int i = 0; i < meshes.size(); ++i)
         {
             meshes[i].DrawInstances(shader, iData.size());
         }
-
-        // Lock the buffer section and switch to the next one
-        MeshResources::instanceBuffer->Lock();
-        MeshResources::instanceBuffer->SwapSections();
     }
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "occlusionbuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHI_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Phi
+{
+    // Box corner indices for each face, used to build occluder polygons
+    static const int BOX_FACES[6][4] =
+    {
+        {0, 1, 3, 2}, // X-
+        {4, 6, 7, 5}, // X+
+        {0, 4, 5, 1}, // Y-
+        {2, 3, 7, 6}, // Y+
+        {0, 2, 6, 4}, // Z-
+        {1, 5, 7, 3}  // Z+
+    };
+
+    // Constructor
+    // NOTE: Width is rounded up to a multiple of 4 so rows can always be processed 4 pixels at a time
+    OcclusionBuffer::OcclusionBuffer(int width, int height, int bandCount)
+        : width((std::max(width, 4) + 3) & ~3), height(std::max(height, 1))
+    {
+        depth.resize(this->width * this->height, 1.0f);
+
+        // Rounding the band height up may leave fewer bands than requested
+        bandCount = std::clamp(bandCount, 1, this->height);
+        bandHeight = (this->height + bandCount - 1) / bandCount;
+        this->bandCount = (this->height + bandHeight - 1) / bandHeight;
+    }
+
+    // Clears all occluders and the depth buffer
+    void OcclusionBuffer::Begin(const glm::mat4& viewProj)
+    {
+        this->viewProj = viewProj;
+        triangles.clear();
+        std::fill(depth.begin(), depth.end(), 1.0f);
+    }
+
+    // Transforms a box into clip space and queues each of its faces
+    void OcclusionBuffer::AddOccluder(const AABB& box)
+    {
+        glm::vec4 corners[8];
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner{(i & 4) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 1) ? box.max.z : box.min.z};
+            corners[i] = viewProj * glm::vec4(corner, 1.0f);
+        }
+
+        for (const int* face : BOX_FACES)
+        {
+            glm::vec4 verts[4] = {corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]]};
+            AddPolygon(verts, 4);
+        }
+    }
+
+    // Clips a convex clip space polygon against the near plane (z >= -w),
+    // then projects it to the screen and splits it into a triangle fan
+    void OcclusionBuffer::AddPolygon(const glm::vec4* verts, int count)
+    {
+        glm::vec4 clipped[8];
+        int clippedCount = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            const glm::vec4& a = verts[i];
+            const glm::vec4& b = verts[(i + 1) % count];
+            float distA = a.z + a.w;
+            float distB = b.z + b.w;
+
+            if (distA >= 0.0f) clipped[clippedCount++] = a;
+            if ((distA >= 0.0f) != (distB >= 0.0f))
+            {
+                clipped[clippedCount++] = a + (b - a) * (distA / (distA - distB));
+            }
+        }
+
+        if (clippedCount < 3) return;
+
+        // Project to screen space
+        glm::vec3 screen[8];
+        for (int i = 0; i < clippedCount; i++)
+        {
+            float w = std::max(clipped[i].w, 1e-6f);
+            glm::vec3 ndc = glm::vec3(clipped[i]) / w;
+            screen[i] = {(ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f};
+        }
+
+        for (int i = 1; i + 1 < clippedCount; i++)
+        {
+            triangles.push_back({{screen[0], screen[i], screen[i + 1]}});
+        }
+    }
+
+    // Draws all queued occluders into the depth buffer
+    void OcclusionBuffer::Rasterize()
+    {
+        if (triangles.empty()) return;
+
+        // Bands never share rows, so they can be drawn in any order
+        JobSystem::ParallelFor("Occlusion Band", 0, bandCount, 1, [this](int first, int last)
+        {
+            for (int band = first; band < last; ++band)
+            {
+                RasterizeBand(band * bandHeight, std::min((band + 1) * bandHeight, height));
+            }
+        });
+    }
+
+    // Rasterizes all triangles into rows [minY, maxY), keeping the nearest depth
+    // Pixels are sampled at their centers with edge functions, depth is interpolated linearly in screen space
+    void OcclusionBuffer::RasterizeBand(int minY, int maxY)
+    {
+        for (const Triangle& tri : triangles)
+        {
+            glm::vec3 v0 = tri.v[0];
+            glm::vec3 v1 = tri.v[1];
+            glm::vec3 v2 = tri.v[2];
+
+            // Make the winding consistent so inside is where all edge functions are positive
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+            if (std::abs(area) < 1e-6f) continue;
+            if (area < 0.0f)
+            {
+                std::swap(v1, v2);
+                area = -area;
+            }
+
+            // Bounding rectangle, clamped to the band
+            int x0 = std::max((int)std::floor(std::min({v0.x, v1.x, v2.x})), 0) & ~3;
+            int x1 = std::min((int)std::ceil(std::max({v0.x, v1.x, v2.x})), width - 1);
+            int y0 = std::max((int)std::floor(std::min({v0.y, v1.y, v2.y})), minY);
+            int y1 = std::min((int)std::ceil(std::max({v0.y, v1.y, v2.y})), maxY - 1);
+            if (x0 > x1 || y0 > y1) continue;
+
+            // Edge functions E(x, y) = A * x + B * y + C, one per edge opposite each vertex
+            const glm::vec3* edgeStart[3] = {&v1, &v2, &v0};
+            const glm::vec3* edgeEnd[3] = {&v2, &v0, &v1};
+            float A[3], B[3], C[3];
+            for (int i = 0; i < 3; i++)
+            {
+                const glm::vec3& a = *edgeStart[i];
+                const glm::vec3& b = *edgeEnd[i];
+                A[i] = a.y - b.y;
+                B[i] = b.x - a.x;
+                C[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+            }
+
+            // Depth plane z(x, y) = dzdx * x + dzdy * y + zc
+            float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            float zc = v0.z - dzdx * v0.x - dzdy * v0.y;
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                float* row = &depth[y * width];
+
+#ifdef PHI_OCCLUSION_SSE
+                __m128 rowE0 = _mm_set1_ps(B[0] * py + C[0]);
+                __m128 rowE1 = _mm_set1_ps(B[1] * py + C[1]);
+                __m128 rowE2 = _mm_set1_ps(B[2] * py + C[2]);
+                __m128 rowZ = _mm_set1_ps(dzdy * py + zc);
+                __m128 a0 = _mm_set1_ps(A[0]);
+                __m128 a1 = _mm_set1_ps(A[1]);
+                __m128 a2 = _mm_set1_ps(A[2]);
+                __m128 dz = _mm_set1_ps(dzdx);
+                __m128 zero = _mm_setzero_ps();
+
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+
+                    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), rowE0), zero);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), rowE1), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), rowE2), zero));
+                    if (_mm_movemask_ps(inside) == 0) continue;
+
+                    __m128 z = _mm_add_ps(_mm_mul_ps(dz, px), rowZ);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+#else
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = x + 0.5f;
+                    if (A[0] * px + B[0] * py + C[0] < 0.0f) continue;
+                    if (A[1] * px + B[1] * py + C[1] < 0.0f) continue;
+                    if (A[2] * px + B[2] * py + C[2] < 0.0f) continue;
+
+                    float z = dzdx * px + dzdy * py + zc;
+                    row[x] = std::min(row[x], z);
+                }
+#endif
+            }
+        }
+    }
+
+    // Tests the nearest depth of the box against every pixel its screen rectangle covers
+    bool OcclusionBuffer::IsVisible(const glm::vec3& min, const glm::vec3& max) const
+    {
+        glm::vec2 screenMin{width, height};
+        glm::vec2 screenMax{0.0f};
+        float nearest = 1.0f;
+
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner{(i & 4) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 1) ? max.z : min.z};
+            glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+
+            // Boxes crossing the near plane are always visible
+            if (clip.z < -clip.w || clip.w <= 0.0f) return true;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 screen{(ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height};
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+
+        // Pixel rectangle touched by the box
+        int x0 = std::max((int)std::floor(screenMin.x), 0) & ~3;
+        int x1 = std::min((int)std::ceil(screenMax.x), width - 1);
+        int y0 = std::max((int)std::floor(screenMin.y), 0);
+        int y1 = std::min((int)std::ceil(screenMax.y), height - 1);
+        if (x0 > x1 || y0 > y1) return false;
+
+        // Visible if any covered pixel is at least as far as the box's nearest point
+        for (int y = y0; y <= y1; y++)
+        {
+            const float* row = &depth[y * width];
+
+#ifdef PHI_OCCLUSION_SSE
+            __m128 boxDepth = _mm_set1_ps(nearest);
+            for (int x = x0; x <= x1; x += 4)
+            {
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth))) return true;
+            }
+#else
+            for (int x = x0; x <= x1; x++)
+            {
+                if (row[x] >= nearest) return true;
+            }
+#endif
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+#include "jobsystem.hpp"
+
+namespace Phi
+{
+    // Low resolution CPU depth buffer for software occlusion culling
+    // Usage:
+    // 1. Every frame, Begin() with the camera's view projection matrix
+    // 2. AddOccluder() boxes that are fully solid (ex: buildings nearest the camera)
+    // 3. Rasterize() the occluders
+    // 4. Test other boxes with IsVisible()
+    //
+    // Occluders are rasterized in horizontal bands, one job per band, 4 pixels at a time with SSE
+    class OcclusionBuffer
+    {
+        // Interface
+        public:
+
+            OcclusionBuffer(int width = 256, int height = 128, int bandCount = 4);
+            ~OcclusionBuffer() = default;
+
+            // Delete copy constructor/assignment
+            OcclusionBuffer(const OcclusionBuffer&) = delete;
+            OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+
+            // Delete move constructor/assignment
+            OcclusionBuffer(OcclusionBuffer&& other) = delete;
+            void operator=(OcclusionBuffer&& other) = delete;
+
+            // Clears all occluders and the depth buffer
+            void Begin(const glm::mat4& viewProj);
+
+            // Queues a solid box to be drawn into the depth buffer
+            // NOTE: Boxes containing the camera must not be added, they would hide everything
+            void AddOccluder(const AABB& box);
+
+            // Draws all queued occluders into the depth buffer
+            void Rasterize();
+
+            // Returns false only if the box is completely hidden behind occluders
+            bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+            // Accessors
+            inline int GetWidth() const { return width; };
+            inline int GetHeight() const { return height; };
+            inline int GetTriangleCount() const { return (int)triangles.size(); };
+            inline const std::vector<float>& GetDepth() const { return depth; };
+
+        // Data / implementation
+        private:
+
+            // Screen space triangle, x / y in pixels and z = NDC depth in [0, 1]
+            struct Triangle
+            {
+                glm::vec3 v[3];
+            };
+
+            // Clips a clip space polygon against the near plane and adds the resulting triangles
+            void AddPolygon(const glm::vec4* verts, int count);
+
+            // Rasterizes all triangles into rows [minY, maxY)
+            void RasterizeBand(int minY, int maxY);
+
+            // Buffer state
+            int width;
+            int height;
+            glm::mat4 viewProj{1.0f};
+            std::vector<float> depth;
+            std::vector<Triangle> triangles;
+
+            // Bands, rasterized in parallel by the job system
+            int bandCount = 1;
+            int bandHeight = 0;
+    };
+}
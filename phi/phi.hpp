@@ -6,12 +6,22 @@
 #include "camera.hpp"
 #include "cubemap.hpp"
 #include "framebuffer.hpp"
+#include "framesync.hpp"
+#include "frustum.hpp"
 #include "geometry.hpp"
+#include "geometrypool.hpp"
+#include "glstate.hpp"
 #include "gpubuffer.hpp"
+#include "jobsystem.hpp"
+#include "log.hpp"
 #include "mesh.hpp"
 #include "model.hpp"
+#include "occlusionbuffer.hpp"
+#include "random.hpp"
 #include "renderbatch.hpp"
 #include "shader.hpp"
 #include "texture2d.hpp"
+#include "textureloader.hpp"
+#include "trace.hpp"
 #include "vertex.hpp"
 #include "vertexattributes.hpp"
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Phi
+{
+    // 64 bit integer finalizer (SplitMix64), a cheap bijective hash with good avalanche
+    inline uint64_t Mix64(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // Hashes a seed and any number of integer keys into a single 64 bit key (order dependent)
+    // Used to derive independent random streams, ex: Hash(worldSeed, block.x, block.y, buildingIndex)
+    template <typename... Keys>
+    inline uint64_t Hash(uint64_t seed, Keys... keys)
+    {
+        uint64_t h = Mix64(seed);
+        ((h = Mix64(h ^ ((uint64_t)(int64_t)keys + 0x9E3779B97F4A7C15ULL))), ...);
+        return h;
+    }
+
+    // Counter-based random number generator
+    // Every output is a hash of (key, counter), so a stream is fully determined by its key and
+    // is independent of any other stream. This makes it safe to generate content in any order,
+    // on any thread, and reproduce it later from the same key.
+    class Random
+    {
+        // Interface
+        public:
+
+            Random(uint64_t key = 0) : key(key) {};
+
+            // Raw outputs
+            inline uint32_t Next() { return (uint32_t)(Next64() >> 32); };
+            inline uint64_t Next64() { return Mix64(key + (++counter) * GOLDEN_GAMMA); };
+
+            // Uniform integer in the inclusive range [min, max]
+            // NOTE: Uses multiply-shift range reduction, no modulo or rejection loop
+            inline int Int(int min, int max)
+            {
+                uint64_t range = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+                return (int)((int64_t)min + (int64_t)(((uint64_t)Next() * range) >> 32));
+            };
+
+            // Uniform float in [0, 1) or [min, max)
+            inline float Float() { return (float)(Next() >> 8) * (1.0f / 16777216.0f); };
+            inline float Float(float min, float max) { return min + Float() * (max - min); };
+
+            // Fair coin flip
+            inline bool Bool() { return Next() >> 31; };
+
+            // Accessors
+            inline uint64_t GetKey() const { return key; };
+            inline uint64_t GetCounter() const { return counter; };
+
+        // Data / implementation
+        private:
+
+            static constexpr uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+            uint64_t key;
+            uint64_t counter = 0;
+    };
+}
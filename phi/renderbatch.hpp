@@ -1,7 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include "mesh.hpp"
 #include "gpubuffer.hpp"
+#include "jobsystem.hpp"
+#include "log.hpp"
 #include "texture2d.hpp"
 #include "vertex.hpp"
 #include "vertexattributes.hpp"
@@ -17,6 +22,10 @@ namespace Phi
     //  a. AddMesh() all the meshes you want to draw
     //  b. Flush()
     //
+    // AddMesh() only records each mesh and its offsets into the batch, then Flush() allocates exactly that much
+    // from the current frame's section of the per-frame buffers and copies the meshes in
+    // (on the JobSystem workers with parallel fill enabled), growing the buffers if a frame needs more
+    //
     // Limitations:
     // 1. Does not support textures
     template <typename Vertex>
@@ -25,7 +34,8 @@ namespace Phi
         // Interface
         public:
 
-            RenderBatch(size_t maxVertices, size_t maxIndices = 0);
+            // maxVertices / maxIndices are per flush, the buffers start out with room for flushesPerFrame full flushes
+            RenderBatch(size_t maxVertices, size_t maxIndices = 0, int flushesPerFrame = 2);
             ~RenderBatch();
             
             // Delete copy constructor/assignment
@@ -37,15 +47,41 @@ namespace Phi
             void operator=(RenderBatch&& other) = delete;
 
             // Batching / rendering methods
+            // NOTE: Meshes must stay alive until the next Flush()
             bool AddMesh(const Mesh<Vertex>& mesh);
             void Flush(const Shader& shader);
+
+            // Parallel fill, only read by Flush()
+            inline void SetParallelFill(bool parallel) { parallelFill = parallel; };
+            inline bool IsParallelFill() const { return parallelFill; };
         
         // Data / implementation
         private:
 
+            // Meshes per parallel fill job
+            static const int FILL_GRAIN_SIZE = 32;
+
+            // A recorded mesh, and where it goes in the flush's ranges (in vertices / indices)
+            struct PendingMesh
+            {
+                const Mesh<Vertex>* mesh;
+                size_t vertexOffset;
+                size_t indexOffset;
+            };
+            std::vector<PendingMesh> pendingMeshes;
+            bool parallelFill = false;
+
+            // Copies pending meshes [begin, end) into the allocated ranges
+            void Fill(Vertex* vertices, GLuint* indices, int begin, int end) const;
+
+            // Recreates the buffers with room for twice as many flushes per frame
+            void Grow();
+            void CreateVertexAttributes();
+
             // State / stats
             size_t maxVertices;
             size_t maxIndices;
+            int flushesPerFrame;
             size_t vertexCount = 0;
             size_t indexCount = 0;
             int drawCount = 0;
@@ -61,61 +97,22 @@ namespace Phi
     // Templated code implementation
 
     template <typename Vertex>
-    RenderBatch<Vertex>::RenderBatch(size_t maxVertices, size_t maxIndices) : maxVertices(maxVertices), maxIndices(maxIndices)
+    RenderBatch<Vertex>::RenderBatch(size_t maxVertices, size_t maxIndices, int flushesPerFrame)
+        : maxVertices(maxVertices), maxIndices(maxIndices), flushesPerFrame(std::max(flushesPerFrame, 1))
     {
         // Use indices if user supplies an index buffer size
         useIndices = maxIndices != 0;
 
         // Initialize resources
-        vertexBuffer = new GPUBuffer(BufferType::DynamicDoubleBuffer, maxVertices * sizeof(Vertex));
+        // NOTE: Ranges are allocated per flush, so FrameSync keeps the GPU from reading anything being written
+        vertexBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxVertices * sizeof(Vertex) * this->flushesPerFrame);
 
         if (useIndices)
         {
-            indexBuffer = new GPUBuffer(BufferType::DynamicDoubleBuffer, maxIndices * sizeof(GLuint));
-        }
-        
-        // VAO creation (Depends on vertex format)
-        if (std::is_same_v<Vertex, VertexPos>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColor>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNorm>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNormUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorNormUv1Uv2>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV1_UV2, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosColorUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosNorm>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosNormUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        else if (std::is_same_v<Vertex, VertexPosUv>)
-        {
-            vertexAttributes = new VertexAttributes(VertexFormat::POS_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
-        }
-        
-        if (!vertexAttributes)
-        {
-            FatalError("RenderBatch Constructor: Custom vertex format is not supported yet, please use one of the internal vertex formats");
+            indexBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxIndices * sizeof(GLuint) * this->flushesPerFrame);
         }
+
+        CreateVertexAttributes();
     }
 
     template <typename Vertex>
@@ -139,34 +136,11 @@ namespace Phi
         {
             return false;
         }
-        
-        // Sync buffers if this is the first write since last flush
-        if (drawCount == 0)
-        {
-            // Ensure OpenGL is not reading from this section of our buffers
-            vertexBuffer->Sync();
-            indexBuffer->Sync();
-        }
-
-        // Copy index data
-        if (useIndices)
-        {
-            // Ensure we have enough space to hold the indices for the current mesh
-            static std::vector<GLuint> offsetIndices;
-            offsetIndices.reserve(meshInds.size());
-
-            // Offset the indices before writing them
-            std::transform(meshInds.cbegin(), meshInds.cend(), offsetIndices.begin(), [this](GLuint original) { return original + vertexCount; });
-            indexBuffer->Write(offsetIndices.data(), meshInds.size() * sizeof(GLuint));
-
-            // Increase counter
-            indexCount += meshInds.size();
-        }
 
-        // Write vertex data
-        vertexBuffer->Write(meshVerts.data(), meshVerts.size() * sizeof(Vertex));
+        // Only reserve space, the running counts are the mesh's offsets (an exclusive prefix sum of the mesh sizes)
+        pendingMeshes.push_back({&mesh, vertexCount, indexCount});
         vertexCount += meshVerts.size();
-
+        if (useIndices) indexCount += meshInds.size();
         drawCount++;
 
         return true;
@@ -175,55 +149,146 @@ namespace Phi
     template <typename Vertex>
     void RenderBatch<Vertex>::Flush(const Shader& shader)
     {
-        if (useIndices)
+        if (drawCount == 0) return;
+
+        // Make room for this flush in the current frame's sections
+        size_t vertexBytes = vertexCount * sizeof(Vertex);
+        size_t indexBytes = indexCount * sizeof(GLuint);
+        if (!vertexBuffer->CanAllocate(vertexBytes, sizeof(Vertex)) ||
+            (useIndices && !indexBuffer->CanAllocate(indexBytes, sizeof(GLuint))))
+        {
+            Grow();
+        }
+
+        GLintptr vertexOffset = vertexBuffer->Allocate(vertexBytes, sizeof(Vertex));
+        GLintptr indexOffset = useIndices ? indexBuffer->Allocate(indexBytes, sizeof(GLuint)) : 0;
+        if (vertexOffset >= 0 && indexOffset >= 0)
         {
+            // Every recorded mesh has to be in the buffers before the draw call
+            Vertex* vertices = (Vertex*)vertexBuffer->GetCurrentData();
+            GLuint* indices = useIndices ? (GLuint*)indexBuffer->GetCurrentData() : nullptr;
+            if (parallelFill)
+            {
+                // Every mesh writes to its own region, so the jobs never touch the same memory
+                JobSystem::ParallelFor("Batch Fill", 0, (int)pendingMeshes.size(), FILL_GRAIN_SIZE, [&](int begin, int end)
+                {
+                    Fill(vertices, indices, begin, end);
+                });
+            }
+            else
+            {
+                Fill(vertices, indices, 0, (int)pendingMeshes.size());
+            }
+
             // Bind resources
             vertexAttributes->Bind();
             shader.Use();
 
             // Issue draw call
-            glDrawElementsBaseVertex(mode, indexCount, GL_UNSIGNED_INT,
-                                    (void*)(indexBuffer->GetSize() * indexBuffer->GetCurrentSection()),
-                                    maxVertices * vertexBuffer->GetCurrentSection());
-        
-            // Insert a fence sync
-            vertexBuffer->Lock();
-            indexBuffer->Lock();
+            if (useIndices)
+            {
+                glDrawElementsBaseVertex(mode, indexCount, GL_UNSIGNED_INT, (void*)indexOffset, vertexOffset / sizeof(Vertex));
+            }
+            else
+            {
+                glDrawArrays(mode, vertexOffset / sizeof(Vertex), vertexCount);
+            }
+        }
 
-            // Needed for double-buffering
-            vertexBuffer->SwapSections();
-            indexBuffer->SwapSections();
+        // Reset counters
+        pendingMeshes.clear();
+        vertexCount = 0;
+        indexCount = 0;
+        drawCount = 0;
+    }
 
-            // Reset counters
-            vertexCount = 0;
-            indexCount = 0;
-            drawCount = 0;
+    template <typename Vertex>
+    void RenderBatch<Vertex>::Fill(Vertex* vertices, GLuint* indices, int begin, int end) const
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const PendingMesh& pending = pendingMeshes[i];
+            const std::vector<Vertex>& meshVerts = pending.mesh->GetVertices();
+            memcpy(vertices + pending.vertexOffset, meshVerts.data(), meshVerts.size() * sizeof(Vertex));
 
-            // Unbind VAO
-            glBindVertexArray(0);
+            // Offset the indices while copying them
+            if (indices)
+            {
+                const std::vector<GLuint>& meshInds = pending.mesh->GetIndices();
+                GLuint baseVertex = (GLuint)pending.vertexOffset;
+                std::transform(meshInds.cbegin(), meshInds.cend(), indices + pending.indexOffset, [baseVertex](GLuint original) { return original + baseVertex; });
+            }
         }
-        else
+    }
+
+    template <typename Vertex>
+    void RenderBatch<Vertex>::Grow()
+    {
+        // NOTE: Frames still in flight keep reading the old buffers, OpenGL only frees them once they are done
+        flushesPerFrame *= 2;
+
+        delete vertexAttributes;
+        delete vertexBuffer;
+        if (indexBuffer) delete indexBuffer;
+
+        vertexBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxVertices * sizeof(Vertex) * flushesPerFrame);
+        if (useIndices)
         {
-            // Bind resources
-            vertexAttributes->Bind();
-            shader.Use();
+            indexBuffer = new GPUBuffer(BufferType::DynamicPerFrame, maxIndices * sizeof(GLuint) * flushesPerFrame);
+        }
 
-            // Issue draw call
-            glDrawArrays(mode, maxVertices * vertexBuffer->GetCurrentSection(), vertexCount);
-        
-            // Insert a fence sync
-            vertexBuffer->Lock();
+        // The VAO references the old buffers
+        CreateVertexAttributes();
 
-            // Needed for double-buffering
-            vertexBuffer->SwapSections();
+        PHI_LOG_INFO("RenderBatch grown to ", flushesPerFrame, " flushes per frame");
+    }
 
-            // Reset counters
-            vertexCount = 0;
-            indexCount = 0;
-            drawCount = 0;
-            
-            // Unbind VAO
-            glBindVertexArray(0);
+    template <typename Vertex>
+    void RenderBatch<Vertex>::CreateVertexAttributes()
+    {
+        vertexAttributes = nullptr;
+
+        // VAO creation (Depends on vertex format)
+        if (std::is_same_v<Vertex, VertexPos>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColor>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNorm>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorNormUv1Uv2>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_NORM_UV1_UV2, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosColorUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_COLOR_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosNorm>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosNormUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_NORM_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+        else if (std::is_same_v<Vertex, VertexPosUv>)
+        {
+            vertexAttributes = new VertexAttributes(VertexFormat::POS_UV, vertexBuffer, useIndices ? indexBuffer : nullptr);
+        }
+
+        if (!vertexAttributes)
+        {
+            FatalError("RenderBatch Constructor: Custom vertex format is not supported yet, please use one of the internal vertex formats");
         }
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "shader.hpp"
+#include "log.hpp"
 
 namespace Phi
 {
@@ -11,116 +12,360 @@ namespace Phi
     // Destructor
     Shader::~Shader()
     {
-        glDeleteProgram(programID);
+        GLState::DeleteProgram(programID);
     }
 
     // Methods
     // Sets this shader as the currently active program
     void Shader::Use() const
     {
-        glUseProgram(programID);
+        GLState::UseProgram(programID);
     }
 
     // Loads a shader stage source file from disk
     // Call this for each stage you want to add to a shader program
+    // NOTE: Compilation is deferred to Link(), so it can be skipped if a cached binary exists
     bool Shader::LoadShaderSource(GLenum stage, const std::string& sourcePath)
     {
-        // Verification vars
-        GLint success;
-        GLchar infoLog[512];
-        
         // Read the file stream
         std::ifstream ifs(sourcePath);
+        if (!ifs)
+        {
+            PHI_LOG_ERROR("Couldn't load shader source: ", sourcePath);
+            return false;
+        }
         std::string shaderSourceString((std::istreambuf_iterator<char>(ifs)),
                                         (std::istreambuf_iterator<char>()));
-        
-        // Format source and create the shader object
-        const GLchar* shaderSource = shaderSourceString.c_str();
-        GLuint shader = glCreateShader(stage);
 
-        // Compile shader
-        glShaderSource(shader, 1, &shaderSource, NULL);
-        glCompileShader(shader);
+        sources.push_back({stage, sourcePath, std::move(shaderSourceString)});
+        return true;
+    }
 
-        // Verify
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success)
+    // Link the shader program
+    // Loads the program from the binary cache if the sources and driver match a previous run,
+    // otherwise compiles all stages, links them, and stores the resulting binary for next time
+    bool Shader::Link()
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        // Build a readable name for the log from the source paths
+        std::string name;
+        for (const Stage& source : sources)
         {
-            // Compilation failed, report error and return
-            glGetShaderInfoLog(shader, 512, NULL, infoLog);
-            std::cout << "ERROR: Shader compilation failed." << infoLog << std::endl;
-            return false;
+            if (!name.empty()) name += " + ";
+            name += source.path;
         }
 
-        // Attach shader to the program and keep track
-        glAttachShader(programID, shader);
-        shaders.push_back(shader);   
+        PHI_TRACE_SCOPE("Shader Link", name);
+        std::string cachePath = binaryCache ? GetCachePath() : "";
+        bool cached = !cachePath.empty() && LoadBinary(cachePath);
+        if (!cached)
+        {
+            if (!CompileAndLink()) return false;
+            if (!cachePath.empty()) SaveBinary(cachePath);
+        }
+
+        sources.clear();
+        Reflect();
+
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        PHI_LOG_INFO("Shader: ", name, " linked in ", ms, "ms", (cached ? " (cached)" : ""));
 
-        // Successful return if no errors
         return true;
     }
 
-    // Link the shader program
-    // This method detaches and deletes all shaders from the program if successful
-    bool Shader::Link() const
+    // Compiles every stage and links the program
+    // Detaches and deletes all shaders from the program if successful
+    bool Shader::CompileAndLink()
     {
         // Verification vars
         GLint success;
         GLchar infoLog[512];
-        
-        // Link the program
+
+        std::vector<GLuint> shaders;
+        for (const Stage& source : sources)
+        {
+            // Format source and create the shader object
+            const GLchar* shaderSource = source.source.c_str();
+            GLuint shader = glCreateShader(source.stage);
+
+            // Compile shader
+            glShaderSource(shader, 1, &shaderSource, NULL);
+            glCompileShader(shader);
+
+            // Verify
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                // Compilation failed, report error and return
+                glGetShaderInfoLog(shader, 512, NULL, infoLog);
+                PHI_LOG_ERROR("Shader compilation failed (", source.path, ").", infoLog);
+                glDeleteShader(shader);
+                for (GLuint attached : shaders)
+                {
+                    glDetachShader(programID, attached);
+                    glDeleteShader(attached);
+                }
+                return false;
+            }
+
+            // Attach shader to the program and keep track
+            glAttachShader(programID, shader);
+            shaders.push_back(shader);
+        }
+
+        // Link the program, asking the driver to keep the binary retrievable
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(programID);
 
+        // Detach and delete all shader objects, the program keeps the linked result
+        for (GLuint shader : shaders)
+        {
+            glDetachShader(programID, shader);
+            glDeleteShader(shader);
+        }
+
         // Verify link stage
         glGetProgramiv(programID, GL_LINK_STATUS, &success);
         if (!success)
         {
             glGetProgramInfoLog(programID, 512, NULL, infoLog);
-            std::cout << "ERROR: Shader program link failed." << infoLog << std::endl;
+            PHI_LOG_ERROR("Shader program link failed.", infoLog);
             return false;
         }
 
-        // Detach and delete all shader objects if linking is successful
-        for (GLuint shader : shaders)
+        return true;
+    }
+
+    // Returns the cache file for the current sources, or an empty string if binaries are unsupported
+    // The key is a 64-bit FNV-1a hash of every stage's source plus the driver's vendor / renderer / version
+    std::string Shader::GetCachePath() const
+    {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (formatCount == 0) return "";
+
+        uint64_t hash = 14695981039346656037ull;
+        auto addBytes = [&hash](const void* data, size_t size)
         {
-            glDetachShader(programID, shader);
-            glDeleteShader(shader);
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char* string = (const char*)glGetString(name);
+            if (string) addBytes(string, strlen(string));
+        }
+        for (const Stage& source : sources)
+        {
+            addBytes(&source.stage, sizeof(source.stage));
+            addBytes(source.source.data(), source.source.size());
         }
 
-        return true;
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)hash);
+        return cacheDirectory + fileName;
+    }
+
+    // Attempts to create the program from a cached binary
+    // Fails (without any error) if there is no cache file, or the driver rejects the binary
+    bool Shader::LoadBinary(const std::string& path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return false;
+
+        // Header: magic, binary format
+        uint32_t magic = 0;
+        GLenum format = 0;
+        ifs.read((char*)&magic, sizeof(magic));
+        ifs.read((char*)&format, sizeof(format));
+        if (!ifs || magic != BINARY_MAGIC) return false;
+
+        std::vector<char> binary((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        if (binary.empty()) return false;
+
+        glProgramBinary(programID, format, binary.data(), (GLsizei)binary.size());
+
+        // A driver update can invalidate binaries even with the same version string
+        GLint success;
+        glGetProgramiv(programID, GL_LINK_STATUS, &success);
+        return success;
+    }
+
+    // Writes the linked program's binary into the cache
+    void Shader::SaveBinary(const std::string& path) const
+    {
+        GLint length = 0;
+        glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(programID, length, nullptr, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+        {
+            PHI_LOG_ERROR("Couldn't write shader cache: ", path);
+            return;
+        }
+        ofs.write((const char*)&BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        ofs.write((const char*)&format, sizeof(format));
+        ofs.write(binary.data(), binary.size());
+    }
+
+    // Caches the location / type of every active uniform and the index of every uniform block
+    void Shader::Reflect()
+    {
+        uniforms.clear();
+        uniformBlocks.clear();
+
+        GLint count, maxLength;
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength + 1);
+
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(programID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            // Members of uniform blocks have no location
+            GLint location = glGetUniformLocation(programID, name.c_str());
+            if (location == -1) continue;
+
+            uniforms[name] = {location, type};
+
+            // Arrays are reported as "name[0]", make them accessible as just "name" too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                uniforms[name.substr(0, name.size() - 3)] = {location, type};
+            }
+        }
+
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        nameBuffer.resize(maxLength + 1);
+
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length;
+            glGetActiveUniformBlockName(programID, i, (GLsizei)nameBuffer.size(), &length, nameBuffer.data());
+            uniformBlocks[std::string(nameBuffer.data(), length)] = i;
+        }
+    }
+
+    // Returns the location of an active uniform, or -1
+    GLint Shader::FindUniform(const std::string& name, GLenum type) const
+    {
+        auto it = uniforms.find(name);
+        if (it == uniforms.end())
+        {
+            if (type) PHI_LOG_ERROR("Shader uniform not active: ", name);
+            return -1;
+        }
+
+        // Integer setters are also used for bools and samplers
+        GLenum actual = it->second.type;
+        bool compatible = actual == type;
+        if (type == GL_INT)
+        {
+            switch (actual)
+            {
+                case GL_BOOL:
+                case GL_SAMPLER_2D:
+                case GL_SAMPLER_2D_ARRAY:
+                case GL_SAMPLER_2D_SHADOW:
+                case GL_SAMPLER_3D:
+                case GL_SAMPLER_CUBE:
+                    compatible = true;
+                    break;
+            }
+        }
+
+        if (type && !compatible)
+        {
+            PHI_LOG_ERROR("Shader uniform type mismatch: ", name);
+            return -1;
+        }
+
+        return it->second.location;
     }
 
     // Binds a uniform block in the shader to a specific binding point
     void Shader::BindUniformBlock(const std::string& blockName, GLuint bindingPoint)
     {
-        GLuint index = glGetUniformBlockIndex(programID, blockName.c_str());
-        glUniformBlockBinding(programID, index, bindingPoint);
+        auto it = uniformBlocks.find(blockName);
+        if (it == uniformBlocks.end())
+        {
+            PHI_LOG_ERROR("Shader uniform block not active: ", blockName);
+            return;
+        }
+        glUniformBlockBinding(programID, it->second, bindingPoint);
+    }
+
+    // Sets a uniform int value through a handle
+    void Shader::SetUniform(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+
+    // Sets a uniform float value through a handle
+    void Shader::SetUniform(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+
+    void Shader::SetUniform(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+    {
+        glUniform3fv(uniform.location, 1, glm::value_ptr(value));
+    }
+
+    void Shader::SetUniform(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+    {
+        glUniform4fv(uniform.location, 1, glm::value_ptr(value));
+    }
+
+    void Shader::SetUniform(Uniform<glm::mat4> uniform, const glm::mat4& value) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, false, glm::value_ptr(value));
     }
 
     // Sets a uniform int value in the shader
     void Shader::SetUniform(const std::string& name, int value)
     {
-        glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+        glUniform1i(FindUniform(name), value);
     }
 
     // Sets a uniform float value in the shader
     void Shader::SetUniform(const std::string& name, float value)
     {
-        glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+        glUniform1f(FindUniform(name), value);
     }
 
     void Shader::SetUniform(const std::string& name, const glm::vec3& value)
     {
-        glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+        glUniform3fv(FindUniform(name), 1, glm::value_ptr(value));
     }
 
     void Shader::SetUniform(const std::string& name, const glm::vec4& value)
     {
-        glUniform4fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+        glUniform4fv(FindUniform(name), 1, glm::value_ptr(value));
     }
 
     void Shader::SetUniform(const std::string& name, const glm::mat4& value)
     {
-        glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, false, glm::value_ptr(value));
+        glUniformMatrix4fv(FindUniform(name), 1, false, glm::value_ptr(value));
     }
 }
\ No newline at end of file
@@ -1,28 +1,51 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <GL/glew.h> // OpenGL types / functions
 
+#include "glstate.hpp"
+#include "trace.hpp"
+
 namespace Phi
 {
     // Shader management class
+    // NOTE: Active uniforms / uniform blocks are reflected once by Link(), so no setter queries the driver
     class Shader
     {
         public:
 
+            // Pre-resolved uniform location, typed by the value it accepts
+            // An invalid handle (location -1) is ignored by OpenGL, so setting it is always safe
+            template <typename T>
+            struct Uniform
+            {
+                GLint location = -1;
+            };
+
             Shader();
             ~Shader();
 
             // Loading / compiling
             bool LoadShaderSource(GLenum stage, const std::string& sourcePath);
-            bool Link() const;
+            bool Link();
+
+            // Linked program binaries are cached here, keyed by their sources and the driver
+            // NOTE: Deleting the directory is always safe, it only forces recompilation
+            static inline bool binaryCache = true;
+            static inline std::string cacheDirectory = "shadercache/";
 
             // Delete copy constructor/assignment
             Shader(const Shader&) = delete;
@@ -35,9 +58,22 @@ namespace Phi
             // Set as the active program
             void Use() const;
 
+            // Returns a handle to the uniform name, checked against the type T once here instead of every set
+            // T must be one of int, float, glm::vec3, glm::vec4, or glm::mat4
+            // NOTE: Only valid after Link(), look handles up once and keep them for hot paths
+            template <typename T>
+            Uniform<T> GetUniform(const std::string& name) const;
+
             // Uniform / binding manipulation
             // NOTE: All calls to SetUniform() are only valid following a call to Use()!
             void BindUniformBlock(const std::string& blockName, GLuint bindingPoint);
+            void SetUniform(Uniform<int> uniform, int value) const;
+            void SetUniform(Uniform<float> uniform, float value) const;
+            void SetUniform(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+            void SetUniform(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+            void SetUniform(Uniform<glm::mat4> uniform, const glm::mat4& value) const;
+
+            // Convenience setters, look the name up in the reflected uniforms
             void SetUniform(const std::string& name, int value);
             void SetUniform(const std::string& name, float value);
             void SetUniform(const std::string& name, const glm::vec3& value);
@@ -53,7 +89,52 @@ namespace Phi
             // Identifiers
             GLuint programID;
 
-            // IDs of individual shaders
-            std::vector<GLuint> shaders;
+            // Stages loaded since the last Link()
+            struct Stage
+            {
+                GLenum stage;
+                std::string path;
+                std::string source;
+            };
+            std::vector<Stage> sources;
+
+            // Program binary cache
+            static constexpr uint32_t BINARY_MAGIC = 0x42494850; // "PHIB"
+            bool CompileAndLink();
+            std::string GetCachePath() const;
+            bool LoadBinary(const std::string& path);
+            void SaveBinary(const std::string& path) const;
+
+            // Reflected interface, filled by Link()
+            struct UniformInfo
+            {
+                GLint location;
+                GLenum type;
+            };
+            std::unordered_map<std::string, UniformInfo> uniforms;
+            std::unordered_map<std::string, GLuint> uniformBlocks;
+
+            // Queries all active uniforms / uniform blocks from the linked program
+            void Reflect();
+
+            // Returns the location of name, or -1 if it is not active
+            // If type is non-zero, the uniform must also have a compatible GLSL type
+            GLint FindUniform(const std::string& name, GLenum type = 0) const;
     };
+
+    // Template implementation
+
+    template <typename T>
+    Shader::Uniform<T> Shader::GetUniform(const std::string& name) const
+    {
+        GLenum type = 0;
+        if constexpr (std::is_same_v<T, int>) type = GL_INT;
+        else if constexpr (std::is_same_v<T, float>) type = GL_FLOAT;
+        else if constexpr (std::is_same_v<T, glm::vec3>) type = GL_FLOAT_VEC3;
+        else if constexpr (std::is_same_v<T, glm::vec4>) type = GL_FLOAT_VEC4;
+        else if constexpr (std::is_same_v<T, glm::mat4>) type = GL_FLOAT_MAT4;
+        else static_assert(!sizeof(T), "Unsupported uniform type");
+
+        return {FindUniform(name, type)};
+    }
 }
\ No newline at end of file
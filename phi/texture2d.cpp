@@ -1,4 +1,5 @@
 #include "texture2d.hpp"
+#include "log.hpp"
 
 namespace Phi
 {
@@ -11,7 +12,7 @@ namespace Phi
     {
         // Generate the texture object
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::BindTexture(GL_TEXTURE_2D, textureID);
 
         // Apply texture parameters
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapU);	
@@ -22,13 +23,16 @@ namespace Phi
         // Specify the texture details
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
         if (mipmap) glGenerateMipmap(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::BindTexture(GL_TEXTURE_2D, 0);
 
         this->width = width;
         this->height = height;
     }
 
     // Load from file constructor
+    // Texture containers (.phtex) are loaded immediately, a PNG with a container of the same name next to it
+    // loads the container instead. Other files are decoded by TextureLoader, until they are uploaded the
+    // texture is a 1x1 grey placeholder
     Texture2D::Texture2D(const std::string& texPath,
                          GLint wrapU, GLint wrapV,
                          GLenum minFilter, GLenum magFilter,
@@ -36,7 +40,7 @@ namespace Phi
     {
         // Generate the texture object
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::BindTexture(GL_TEXTURE_2D, textureID);
 
         // Default default texture parameters
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapU);	
@@ -44,34 +48,48 @@ namespace Phi
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
 
-        // Load the image data
-        int width, height, channelCount;
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char* data = stbi_load(texPath.c_str(), &width, &height, &channelCount, STBI_rgb_alpha);
-        if (data)
+        // Prefer a pre-baked container, it needs no decoding and already has its mip chain
+        std::string containerPath = std::filesystem::path(texPath).replace_extension(".phtex").string();
+        if ((TextureFile::IsContainer(texPath) || std::filesystem::exists(containerPath)) &&
+            TextureLoader::LoadContainer(GL_TEXTURE_2D, containerPath, mipmap, width, height))
         {
-            // Send image data to texture target
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            if (mipmap) glGenerateMipmap(GL_TEXTURE_2D);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "ERROR: Couldn't load file: " << texPath.c_str() << std::endl;
-            stbi_image_free(data);
+            GLState::BindTexture(GL_TEXTURE_2D, 0);
+            return;
         }
 
-        this->width = width;
-        this->height = height;
+        // Placeholder, a single level is still complete with mipmap filters
+        const unsigned char placeholder[4] = {128, 128, 128, 255};
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        width = 1;
+        height = 1;
+        loaded = false;
 
         // Unbind
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+        // Replace the placeholder once the image is decoded
+        if (TextureFile::IsContainer(texPath)) return;
+        TextureLoader::Load(this, {texPath}, true, [this, mipmap](const std::vector<TextureLoader::Image>& images)
+        {
+            const TextureLoader::Image& image = images[0];
+            if (!image.width) return;
+
+            GLState::BindTexture(GL_TEXTURE_2D, textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
+            if (mipmap) glGenerateMipmap(GL_TEXTURE_2D);
+            GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+            width = image.width;
+            height = image.height;
+            loaded = true;
+        });
     }
 
     // Destructor
     Texture2D::~Texture2D()
     {
-        glDeleteTextures(1, &textureID);
+        TextureLoader::Cancel(this);
+        GLState::DeleteTexture(textureID);
     }
 
     // Bind this texture to GL_TEXTURE_2D on a given texture unit
@@ -82,12 +100,11 @@ namespace Phi
         // OpenGL 3.x requires a minimum of 16 units per stage
         if (texUnit < 0 || texUnit > 15)
         {
-            std::cout << "ERROR: Invalid texture unit passed to Texture2D::Bind" << std::endl;
+            PHI_LOG_ERROR("Invalid texture unit passed to Texture2D::Bind");
             return;
         }
 
         // Set active unit and bind texture
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::BindTexture(GL_TEXTURE_2D, textureID, texUnit);
     }
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <iostream>
+#include <filesystem>
 #include <string>
 
 #include <GL/glew.h> // OpenGL types / functions
-#include <stb_image.h>
+
+#include "glstate.hpp"
+#include "textureloader.hpp"
 
 namespace Phi
 {
@@ -42,6 +45,9 @@ namespace Phi
             inline GLuint GetID() const { return textureID; };
             inline int GetWidth() const { return width; };
             inline int GetHeight() const { return height; };
+
+            // False until a texture loaded from a file has replaced its placeholder
+            inline bool IsLoaded() const { return loaded; };
         
         // Data / implementation
         private:
@@ -49,5 +55,6 @@ namespace Phi
             GLuint textureID;
             int width = 0;
             int height = 0;
+            bool loaded = true;
     };
 }
\ No newline at end of file
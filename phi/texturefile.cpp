@@ -0,0 +1,143 @@
+#include "texturefile.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include "log.hpp"
+
+namespace Phi
+{
+    // Destructor
+    TextureFile::~TextureFile()
+    {
+        Close();
+    }
+
+    // Maps the file read-only and validates its header / level table
+    bool TextureFile::Open(const std::string& path)
+    {
+        Close();
+
+        if (!file.Open(path))
+        {
+            PHI_LOG_ERROR("Couldn't open texture file: ", path);
+            return false;
+        }
+        const unsigned char* mapping = file.GetData();
+        size_t mappingSize = file.GetSize();
+
+        // Validate the header and every level's range
+        bool valid = mappingSize >= sizeof(Header);
+        if (valid)
+        {
+            header = *(const Header*)mapping;
+            valid = header.magic == MAGIC && header.version == VERSION &&
+                    (header.format == Format::RGBA8 || header.format == Format::BC3) &&
+                    header.width > 0 && header.height > 0 && header.levelCount > 0 && header.levelCount <= 16 &&
+                    (header.faceCount == 1 || header.faceCount == 6);
+
+            // The last level must still be at least 1 pixel wide or tall, glTexStorage2D rejects longer chains
+            valid = valid && (std::max(header.width, header.height) >> (header.levelCount - 1)) > 0;
+        }
+
+        size_t tableEnd = sizeof(Header) + sizeof(LevelEntry) * header.faceCount * header.levelCount;
+        valid = valid && mappingSize >= tableEnd;
+        if (valid)
+        {
+            levelTable = (const LevelEntry*)(mapping + sizeof(Header));
+            for (uint32_t level = 0; level < header.levelCount && valid; level++)
+            {
+                for (uint32_t face = 0; face < header.faceCount && valid; face++)
+                {
+                    const LevelEntry& entry = levelTable[level * header.faceCount + face];
+                    Level expected = GetLevel(face, level);
+                    valid = entry.size == GetLevelSize(header.format, expected.width, expected.height) &&
+                            entry.offset >= tableEnd && entry.offset + entry.size <= mappingSize;
+                }
+            }
+        }
+
+        if (!valid)
+        {
+            PHI_LOG_ERROR("Invalid texture file: ", path);
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Unmaps the file
+    void TextureFile::Close()
+    {
+        file.Close();
+        levelTable = nullptr;
+    }
+
+    // Returns true if path names a texture container
+    bool TextureFile::IsContainer(const std::string& path)
+    {
+        const std::string extension = ".phtex";
+        return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    // Size in bytes of one level of the given dimensions
+    size_t TextureFile::GetLevelSize(Format format, int width, int height)
+    {
+        switch (format)
+        {
+            case Format::RGBA8: return (size_t)width * height * 4;
+            case Format::BC3:   return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+        }
+        return 0;
+    }
+
+    // Writes the header, level table and level data
+    bool TextureFile::Write(const std::string& path, const Header& header, const std::vector<std::vector<unsigned char>>& levels)
+    {
+        if (levels.size() != (size_t)header.faceCount * header.levelCount)
+        {
+            PHI_LOG_ERROR("Texture file level count mismatch");
+            return false;
+        }
+
+        // Lay out the level data after the table, aligned to 16 bytes
+        std::vector<LevelEntry> table(levels.size());
+        uint64_t offset = sizeof(Header) + sizeof(LevelEntry) * table.size();
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            offset = (offset + 15) & ~15ull;
+            table[i] = {offset, levels[i].size()};
+            offset += levels[i].size();
+        }
+
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+        {
+            PHI_LOG_ERROR("Couldn't write texture file: ", path);
+            return false;
+        }
+
+        ofs.write((const char*)&header, sizeof(Header));
+        ofs.write((const char*)table.data(), sizeof(LevelEntry) * table.size());
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            // Pad up to the level's offset
+            static const char padding[16] = {};
+            ofs.write(padding, table[i].offset - (uint64_t)ofs.tellp());
+            ofs.write((const char*)levels[i].data(), levels[i].size());
+        }
+
+        return (bool)ofs;
+    }
+
+    // Returns a single level of a single face
+    TextureFile::Level TextureFile::GetLevel(int face, int level) const
+    {
+        int width = std::max((int)header.width >> level, 1);
+        int height = std::max((int)header.height >> level, 1);
+
+        const LevelEntry& entry = levelTable[level * header.faceCount + face];
+        return {width, height, file.GetData() + entry.offset, (size_t)entry.size};
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+
+namespace Phi
+{
+    // Pre-baked texture container (.phtex), holds every mip level of 1 (2D) or 6 (cubemap) faces
+    // Levels are stored ready to be passed to glTexSubImage2D() / glCompressedTexSubImage2D(),
+    // so loading a texture is just mapping the file and pointing OpenGL at it
+    //
+    // Layout (little endian):
+    // Header
+    // Level table, faceCount * levelCount entries, ordered by level then face (same order as the data)
+    // Level data, each level starts on a 16 byte boundary
+    //
+    // NOTE: Files are written by the phitex tool (tools/phitex.cpp)
+    class TextureFile
+    {
+        // Interface
+        public:
+
+            static constexpr uint32_t MAGIC = 0x58544850; // "PHTX"
+            static constexpr uint32_t VERSION = 1;
+
+            // Pixel formats
+            enum class Format : uint32_t
+            {
+                RGBA8 = 0,  // Uncompressed, 4 bytes per pixel
+                BC3 = 1     // DXT5, 16 bytes per 4x4 block
+            };
+
+            struct Header
+            {
+                uint32_t magic = MAGIC;
+                uint32_t version = VERSION;
+                Format format = Format::RGBA8;
+                uint32_t width = 0;
+                uint32_t height = 0;
+                uint32_t faceCount = 1;
+                uint32_t levelCount = 1;
+                uint32_t reserved = 0;
+            };
+
+            struct LevelEntry
+            {
+                uint64_t offset;
+                uint64_t size;
+            };
+
+            // A single mip level of a single face
+            struct Level
+            {
+                int width;
+                int height;
+                const void* data;
+                size_t size;
+            };
+
+            TextureFile() = default;
+            ~TextureFile();
+
+            // Delete copy constructor/assignment
+            TextureFile(const TextureFile&) = delete;
+            TextureFile& operator=(const TextureFile&) = delete;
+
+            // Delete move constructor/assignment
+            TextureFile(TextureFile&& other) = delete;
+            void operator=(TextureFile&& other) = delete;
+
+            // Maps a file into memory and validates it, prints an error and returns false on failure
+            bool Open(const std::string& path);
+
+            // Returns true if path names a texture container (by extension)
+            static bool IsContainer(const std::string& path);
+
+            // Size in bytes of one level of the given dimensions
+            static size_t GetLevelSize(Format format, int width, int height);
+
+            // Writes a container, levels holds faceCount * levelCount entries in file order
+            static bool Write(const std::string& path, const Header& header, const std::vector<std::vector<unsigned char>>& levels);
+
+            // Accessors, only valid after a successful Open()
+            Level GetLevel(int face, int level) const;
+            inline const Header& GetHeader() const { return header; };
+
+        // Data / implementation
+        private:
+
+            // Releases the mapping
+            void Close();
+
+            Header header;
+            const LevelEntry* levelTable = nullptr;
+
+            MappedFile file;
+    };
+}
@@ -0,0 +1,270 @@
+#include "textureloader.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Phi
+{
+    // Queues files to be decoded by the workers
+    void TextureLoader::Load(const void* owner, const std::vector<std::string>& paths, bool flip, UploadFn upload)
+    {
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        request->owner = owner;
+        request->paths = paths;
+        request->flip = flip;
+        request->upload = std::move(upload);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // Spawn the workers on first use
+            if (workers.empty())
+            {
+                stopping = false;
+                int workerCount = std::clamp((int)std::thread::hardware_concurrency() - 1, 1, MAX_WORKERS);
+                for (int i = 0; i < workerCount; i++)
+                {
+                    workers.emplace_back(&TextureLoader::WorkerLoop);
+                }
+            }
+
+            queued.push_back(request);
+            pending++;
+        }
+        workAvailable.notify_one();
+    }
+
+    // Marks every outstanding request from owner as cancelled
+    // Workers skip cancelled requests, and Update() discards them
+    void TextureLoader::Cancel(const void* owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto* list : {&queued, &decoding, &decoded})
+        {
+            for (std::shared_ptr<Request>& request : *list)
+            {
+                if (request->owner == owner) request->cancelled = true;
+            }
+        }
+    }
+
+    // Worker thread entrypoint
+    void TextureLoader::WorkerLoop()
+    {
+        Trace::SetThreadName("Texture Loader");
+
+        while (true)
+        {
+            std::shared_ptr<Request> request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workAvailable.wait(lock, []() { return stopping || !queued.empty(); });
+                if (stopping) return;
+
+                request = queued.front();
+                queued.pop_front();
+                if (request->cancelled)
+                {
+                    pending--;
+                    continue;
+                }
+                decoding.push_back(request);
+            }
+
+            Decode(*request);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            decoding.erase(std::find(decoding.begin(), decoding.end(), request));
+            decoded.push_back(request);
+        }
+    }
+
+    // Decodes every file of a request into RGBA8 pixels
+    // NOTE: Flipping is done here instead of with stbi_set_flip_vertically_on_load(), which is global state
+    void TextureLoader::Decode(Request& request)
+    {
+        PHI_TRACE_SCOPE("Texture Decode", request.paths[0]);
+
+        request.pixels.resize(request.paths.size());
+        request.sizes.resize(request.paths.size(), glm::ivec2(0));
+
+        for (size_t i = 0; i < request.paths.size(); i++)
+        {
+            int width, height, channelCount;
+            unsigned char* data = stbi_load(request.paths[i].c_str(), &width, &height, &channelCount, STBI_rgb_alpha);
+            if (!data) continue;
+
+            size_t rowSize = (size_t)width * 4;
+            std::vector<unsigned char>& pixels = request.pixels[i];
+            pixels.resize(rowSize * height);
+            for (int row = 0; row < height; row++)
+            {
+                int sourceRow = request.flip ? height - 1 - row : row;
+                memcpy(&pixels[row * rowSize], data + sourceRow * rowSize, rowSize);
+            }
+            stbi_image_free(data);
+
+            request.sizes[i] = {width, height};
+            request.totalBytes += pixels.size();
+        }
+    }
+
+    // Copies decoded images into the staging buffer and calls each request's upload function
+    void TextureLoader::Update()
+    {
+        // Take as many decoded requests as fit in this frame's budget
+        std::vector<std::shared_ptr<Request>> ready;
+        size_t uploadBytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!decoded.empty())
+            {
+                std::shared_ptr<Request>& request = decoded.front();
+                if (request->cancelled)
+                {
+                    decoded.pop_front();
+                    pending--;
+                    continue;
+                }
+                if (!ready.empty() && uploadBytes + request->totalBytes > MAX_UPLOAD_BYTES) break;
+
+                uploadBytes += request->totalBytes;
+                ready.push_back(request);
+                decoded.pop_front();
+                pending--;
+            }
+        }
+        if (ready.empty()) return;
+
+        PHI_TRACE_SCOPE("Texture Upload");
+
+        // Grow the staging buffer to fit, the old one is only released by the driver once the GPU is done with it
+        if (!staging || !staging->CanAllocate(uploadBytes))
+        {
+            size_t capacity = staging ? staging->GetSize() : MAX_UPLOAD_BYTES / 4;
+            while (capacity < uploadBytes) capacity *= 2;
+            delete staging;
+            staging = new GPUBuffer(BufferType::DynamicPerFrame, capacity);
+        }
+
+        GLintptr offset = staging->Allocate(uploadBytes);
+        if (offset < 0) return;
+
+        GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->GetName());
+        for (std::shared_ptr<Request>& request : ready)
+        {
+            std::vector<Image> images(request->paths.size());
+            for (size_t i = 0; i < images.size(); i++)
+            {
+                const std::vector<unsigned char>& pixels = request->pixels[i];
+                if (pixels.empty())
+                {
+                    PHI_LOG_ERROR("Couldn't load file: ", request->paths[i]);
+                    images[i] = {0, 0, nullptr};
+                    continue;
+                }
+
+                staging->Write(pixels.data(), (GLuint)pixels.size());
+                images[i] = {request->sizes[i].x, request->sizes[i].y, (const void*)offset};
+                offset += pixels.size();
+            }
+
+            request->upload(images);
+        }
+
+        // Texture uploads with a null pointer would otherwise read from the staging buffer
+        GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // Uploads a texture container into the bound texture
+    bool TextureLoader::LoadContainer(GLenum target, const std::string& path, bool mipmap, int& width, int& height)
+    {
+        PHI_TRACE_SCOPE("Texture Container Load", path);
+
+        TextureFile file;
+        if (!file.Open(path)) return false;
+
+        const TextureFile::Header& header = file.GetHeader();
+        int faceCount = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        if ((int)header.faceCount != faceCount)
+        {
+            PHI_LOG_ERROR("Texture file has the wrong number of faces: ", path);
+            return false;
+        }
+
+        bool compressed = header.format == TextureFile::Format::BC3;
+        if (compressed && !GLEW_EXT_texture_compression_s3tc)
+        {
+            PHI_LOG_ERROR("BC3 textures are not supported: ", path);
+            return false;
+        }
+        GLenum internalFormat = compressed ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_RGBA8;
+
+        // Allocate the full chain if it will be generated
+        // NOTE: Mipmaps can't be generated for compressed formats, single level BC3 textures are sampled without them
+        int levelCount = header.levelCount;
+        bool generate = mipmap && levelCount == 1 && !compressed;
+        if (generate)
+        {
+            while (std::max(header.width, header.height) >> levelCount) levelCount++;
+        }
+        glTexStorage2D(target, levelCount, internalFormat, header.width, header.height);
+
+        for (uint32_t level = 0; level < header.levelCount; level++)
+        {
+            for (int face = 0; face < faceCount; face++)
+            {
+                TextureFile::Level data = file.GetLevel(face, level);
+                GLenum faceTarget = faceCount == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+                if (compressed)
+                {
+                    glCompressedTexSubImage2D(faceTarget, level, 0, 0, data.width, data.height, internalFormat, (GLsizei)data.size, data.data);
+                }
+                else
+                {
+                    glTexSubImage2D(faceTarget, level, 0, 0, data.width, data.height, GL_RGBA, GL_UNSIGNED_BYTE, data.data);
+                }
+            }
+        }
+
+        // Without mipmaps, only sample the stored levels
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        if (generate) glGenerateMipmap(target);
+
+        width = header.width;
+        height = header.height;
+        return true;
+    }
+
+    // Joins all workers and deletes the staging buffer
+    void TextureLoader::Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+
+        queued.clear();
+        decoding.clear();
+        decoded.clear();
+        pending = 0;
+
+        delete staging;
+        staging = nullptr;
+    }
+
+    // Number of requests not uploaded yet
+    int TextureLoader::GetPendingCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+}
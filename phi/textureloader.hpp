@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h> // OpenGL types / functions
+#include <stb_image.h>
+
+#include "glstate.hpp"
+#include "gpubuffer.hpp"
+#include "texturefile.hpp"
+#include "trace.hpp"
+
+namespace Phi
+{
+    // Decodes image files on worker threads, and uploads them through a persistently mapped pixel unpack buffer
+    // Usage:
+    // 1. Load() a list of files along with a function that uploads them into a texture
+    // 2. Every frame, call Update() on the thread owning the OpenGL context (App does this)
+    //    Each decoded request is copied into the staging buffer, and its upload function is called with
+    //    GL_PIXEL_UNPACK_BUFFER bound, so the data pointers it receives are offsets into that buffer
+    class TextureLoader
+    {
+        // Interface
+        public:
+
+            // Static interface only
+            TextureLoader() = delete;
+
+            // A decoded RGBA8 image, ready to be passed to glTexImage2D()
+            // NOTE: width / height are 0 if the file could not be decoded
+            struct Image
+            {
+                int width;
+                int height;
+                const void* data;
+            };
+            using UploadFn = std::function<void(const std::vector<Image>& images)>;
+
+            // Queues files to be decoded, upload is called by Update() once all of them are ready
+            // If flip is true, images are flipped vertically (OpenGL expects the first row at the bottom)
+            static void Load(const void* owner, const std::vector<std::string>& paths, bool flip, UploadFn upload);
+
+            // Uploads every level of a texture container (.phtex) straight from the mapped file
+            // into the texture bound to target (GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP), allocating immutable storage
+            // If the file only holds one level and mipmap is true, the rest of the chain is generated
+            // Returns false (leaving the texture untouched) if the file is invalid or doesn't match target
+            static bool LoadContainer(GLenum target, const std::string& path, bool mipmap, int& width, int& height);
+
+            // Cancels every request made by owner that has not been uploaded yet
+            // NOTE: Textures must call this in their destructor, since the upload function references them
+            static void Cancel(const void* owner);
+
+            // Uploads decoded images, at most MAX_UPLOAD_BYTES per call (but always at least one request)
+            static void Update();
+
+            // Stops the workers and releases the staging buffer
+            // NOTE: Must be called while the OpenGL context still exists
+            static void Shutdown();
+
+            // Number of requests not uploaded yet
+            static int GetPendingCount();
+
+        // Data / implementation
+        private:
+
+            static const size_t MAX_UPLOAD_BYTES = 32 * 1024 * 1024;
+            static const int MAX_WORKERS = 4;
+
+            // A list of files, decoded together and uploaded by a single call
+            struct Request
+            {
+                const void* owner;
+                std::vector<std::string> paths;
+                bool flip;
+                UploadFn upload;
+
+                // Decoded pixels, one per path (empty if decoding failed)
+                std::vector<std::vector<unsigned char>> pixels;
+                std::vector<glm::ivec2> sizes;
+                size_t totalBytes = 0;
+                bool cancelled = false;
+            };
+
+            // Worker thread entrypoint
+            static void WorkerLoop();
+
+            // Decodes every file of a request
+            static void Decode(Request& request);
+
+            // Workers are spawned by the first Load()
+            static inline std::vector<std::thread> workers;
+            static inline std::mutex mutex;
+            static inline std::condition_variable workAvailable;
+            static inline bool stopping = false;
+
+            // Requests waiting to be decoded / uploaded
+            static inline std::deque<std::shared_ptr<Request>> queued;
+            static inline std::deque<std::shared_ptr<Request>> decoding;
+            static inline std::deque<std::shared_ptr<Request>> decoded;
+            static inline int pending = 0;
+
+            // Persistently mapped staging buffer, grown to fit the largest upload
+            static inline GPUBuffer* staging = nullptr;
+    };
+}
@@ -0,0 +1,131 @@
+#include "trace.hpp"
+
+#include <fstream>
+
+#include "log.hpp"
+
+namespace Phi
+{
+    // Writes a JSON string literal
+    static void WriteString(std::ofstream& ofs, const std::string& str)
+    {
+        ofs << '"';
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\') ofs << '\\' << c;
+            else if ((unsigned char)c < 0x20) ofs << ' ';
+            else ofs << c;
+        }
+        ofs << '"';
+    }
+
+    void Trace::SetThreadName(const std::string& name)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    Trace::ThreadBuffer& Trace::GetThreadBuffer()
+    {
+        // The thread holds a reference too, so the buffer outlives whichever of the two finishes first
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer)
+        {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(mutex);
+            buffer->id = (int)threads.size();
+            buffer->name = "Thread " + std::to_string(buffer->id);
+            threads.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void Trace::Record(const char* name, const std::string& detail, int64_t start, int64_t end)
+    {
+        if (!enabled) return;
+
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() >= MAX_EVENTS_PER_THREAD)
+        {
+            dropped++;
+            return;
+        }
+        buffer.events.push_back({name, detail, start, end});
+    }
+
+    size_t Trace::GetEventCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = 0;
+        for (const auto& buffer : threads)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            count += buffer->events.size();
+        }
+        return count;
+    }
+
+    void Trace::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& buffer : threads)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->events.clear();
+        }
+        dropped = 0;
+    }
+
+    // Writes a thread name metadata event for every thread, followed by every complete event
+    bool Trace::Write(const std::string& path)
+    {
+        std::ofstream ofs(path);
+        if (!ofs)
+        {
+            PHI_LOG_ERROR("Couldn't write trace: ", path);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = 0;
+        bool first = true;
+
+        ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (const auto& buffer : threads)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+
+            ofs << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+            WriteString(ofs, buffer->name);
+            ofs << "}}";
+            first = false;
+
+            for (const Event& event : buffer->events)
+            {
+                ofs << ",\n{\"ph\":\"X\",\"name\":";
+                WriteString(ofs, event.name);
+                ofs << ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << event.start << ",\"dur\":" << event.end - event.start;
+                if (!event.detail.empty())
+                {
+                    ofs << ",\"args\":{\"detail\":";
+                    WriteString(ofs, event.detail);
+                    ofs << "}";
+                }
+                ofs << "}";
+            }
+            count += buffer->events.size();
+        }
+        ofs << "\n]}\n";
+
+        if (!ofs)
+        {
+            PHI_LOG_ERROR("Couldn't write trace: ", path);
+            return false;
+        }
+
+        PHI_LOG_INFO("Trace written: ", path, " (", count, " events)");
+        return true;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records a trace event named name for the rest of the enclosing scope
+// An optional second argument adds a detail string (e.g. a file path) to the event
+#define PHI_TRACE_CONCAT_INNER(a, b) a##b
+#define PHI_TRACE_CONCAT(a, b) PHI_TRACE_CONCAT_INNER(a, b)
+#define PHI_TRACE_SCOPE(...) Phi::Trace::Scope PHI_TRACE_CONCAT(phiTraceScope, __LINE__)(__VA_ARGS__)
+
+namespace Phi
+{
+    // Lightweight timeline tracing, written as Chrome trace event JSON
+    // Open the file in chrome://tracing or https://ui.perfetto.dev
+    // Usage:
+    // 1. Mark scopes with PHI_TRACE_SCOPE("Name"), from any thread
+    // 2. Write() the trace on demand (App writes TRACE_PATH on exit)
+    // NOTE: Every thread records into its own buffer, so scopes never contend with each other
+    class Trace
+    {
+        // Interface
+        public:
+
+            // Static interface only
+            Trace() = delete;
+
+            // Default output path, written by App on exit
+            static inline const char* TRACE_PATH = "trace.json";
+
+            // Records a complete event from construction to destruction
+            class Scope
+            {
+                public:
+
+                    Scope(const char* name) : name(name), start(Trace::Now()) {};
+                    Scope(const char* name, const std::string& detail) : name(name), detail(detail), start(Trace::Now()) {};
+                    ~Scope() { Trace::Record(name, detail, start, Trace::Now()); };
+
+                    // Delete copy constructor/assignment
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                    // Delete move constructor/assignment
+                    Scope(Scope&& other) = delete;
+                    void operator=(Scope&& other) = delete;
+
+                private:
+
+                    const char* name;
+                    std::string detail;
+                    int64_t start;
+            };
+
+            // Names the calling thread in the trace
+            static void SetThreadName(const std::string& name);
+
+            // Writes every event recorded so far, returns false on failure
+            static bool Write(const std::string& path = TRACE_PATH);
+
+            // Discards every event recorded so far
+            static void Clear();
+
+            // Number of events recorded / dropped (because a thread's buffer was full)
+            static size_t GetEventCount();
+            static inline size_t GetDroppedCount() { return dropped.load(); };
+
+            // When disabled, scopes record nothing
+            static inline std::atomic<bool> enabled = true;
+
+        // Data / implementation
+        private:
+
+            // Max events kept per thread, later events are dropped
+            static const size_t MAX_EVENTS_PER_THREAD = 100'000;
+
+            // A single complete ("X") event, times in microseconds since startup
+            struct Event
+            {
+                const char* name;
+                std::string detail;
+                int64_t start;
+                int64_t end;
+            };
+
+            // Events recorded by a single thread
+            struct ThreadBuffer
+            {
+                int id;
+                std::string name;
+                std::mutex mutex; // Only contended while writing the trace
+                std::vector<Event> events;
+            };
+
+            // Microseconds since startup
+            static inline int64_t Now()
+            {
+                return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+            };
+
+            // Adds an event to the calling thread's buffer
+            static void Record(const char* name, const std::string& detail, int64_t start, int64_t end);
+
+            // Returns the calling thread's buffer, registering it the first time
+            static ThreadBuffer& GetThreadBuffer();
+
+            static inline const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+            // Buffers of every thread that ever recorded, kept alive after their thread exits
+            static inline std::mutex mutex;
+            static inline std::vector<std::shared_ptr<ThreadBuffer>> threads;
+            static inline std::atomic<size_t> dropped = 0;
+    };
+}
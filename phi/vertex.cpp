@@ -2,5 +2,20 @@
 
 namespace Phi
 {
-    
+    size_t GetVertexSize(VertexFormat format)
+    {
+        switch (format)
+        {
+            case VertexFormat::POS: return sizeof(VertexPos);
+            case VertexFormat::POS_COLOR: return sizeof(VertexPosColor);
+            case VertexFormat::POS_COLOR_NORM: return sizeof(VertexPosColorNorm);
+            case VertexFormat::POS_COLOR_NORM_UV: return sizeof(VertexPosColorNormUv);
+            case VertexFormat::POS_COLOR_NORM_UV1_UV2: return sizeof(VertexPosColorNormUv1Uv2);
+            case VertexFormat::POS_COLOR_UV: return sizeof(VertexPosColorUv);
+            case VertexFormat::POS_NORM: return sizeof(VertexPosNorm);
+            case VertexFormat::POS_NORM_UV: return sizeof(VertexPosNormUv);
+            case VertexFormat::POS_UV: return sizeof(VertexPosUv);
+        }
+        return 0;
+    }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #include <GL/glew.h> // OpenGL types / functions
 
 namespace Phi
@@ -22,6 +24,9 @@ namespace Phi
         POS_UV,
     };
 
+    // Size in bytes of a single vertex of the given format
+    size_t GetVertexSize(VertexFormat format);
+
     // Common internal vertex formats that can be used with GPUBuffers, VAOs, and Meshes
 
     struct VertexPos
@@ -15,8 +15,8 @@ namespace Phi
     {   
         // Bind VAO and VBO
         glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo->GetName());
+        GLState::BindVertexArray(vao);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, vbo->GetName());
 
         // Construct VAO based on internal format, assume tightly packed
         switch (format)
@@ -90,15 +90,14 @@ namespace Phi
             ebo->Bind(GL_ELEMENT_ARRAY_BUFFER);
         }
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GLState::BindVertexArray(0);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     // Destructor
     VertexAttributes::~VertexAttributes()
     {
-        glDeleteVertexArrays(1, &vao);
+        GLState::DeleteVertexArray(vao);
     }
 
     // Adds an attribute and associates the currently bound buffer with that attribute
@@ -131,6 +130,6 @@ namespace Phi
     // Binds the VAO
     void VertexAttributes::Bind() const
     {
-        glBindVertexArray(vao);
+        GLState::BindVertexArray(vao);
     }
 }
\ No newline at end of file
@@ -36,7 +36,7 @@ namespace Phi
 
             // Binding methods
             void Bind() const;
-            void Unbind() const { glBindVertexArray(0); };
+            void Unbind() const { GLState::BindVertexArray(0); };
 
         // Data / implementation
         private:
@@ -0,0 +1,154 @@
+#include "blockgenerator.hpp"
+
+#include <iterator>
+
+// Offsets of each street light relative to a block origin
+static const glm::vec3 STREET_LIGHT_OFFSETS[] =
+{
+    {8.0f, 1.7f, 1.65f},
+    {1.65f, 1.7f, 8.0f},
+    {14.35f, 1.7f, 8.0f},
+    {8.0f, 1.7f, 14.35f}
+};
+
+// Constructor
+// NOTE: Blocks are generated on the job system's workers, which App starts
+BlockGenerator::BlockGenerator(int blockSize) : blockSize(blockSize)
+{
+}
+
+// Destructor, waits for the blocks that are already generating (they reference this generator)
+BlockGenerator::~BlockGenerator()
+{
+    CancelPending();
+    WaitIdle();
+}
+
+// Queues a block for generation as a job
+void BlockGenerator::Submit(const glm::ivec2& id, uint64_t worldSeed, bool festive, int colorCycle, int epoch)
+{
+    int cancel = cancelEpoch;
+    Phi::JobSystem::Schedule("Block Generation", [this, id, worldSeed, festive, colorCycle, epoch, cancel]()
+    {
+        if (cancel != cancelEpoch) return;
+
+        // Generate the block without holding the lock
+        BlockData block;
+        block.id = id;
+        block.epoch = epoch;
+        Generate(block, worldSeed, festive, colorCycle);
+
+        // Hand the block back to the main thread
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(block));
+    }, &pending);
+}
+
+// Moves up to maxBlocks finished blocks into out, returns the number collected
+int BlockGenerator::Collect(std::vector<BlockData>& out, int maxBlocks)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int count = 0;
+    while (!finished.empty() && count < maxBlocks)
+    {
+        out.push_back(std::move(finished.front()));
+        finished.pop_front();
+        count++;
+    }
+
+    return count;
+}
+
+// Blocks the calling thread until every submitted block has finished generating
+// The calling thread generates blocks too while it waits
+void BlockGenerator::WaitIdle()
+{
+    Phi::JobSystem::Wait(pending);
+}
+
+// Discards all blocks that have not started generating yet
+// Their jobs still run, but return immediately
+void BlockGenerator::CancelPending()
+{
+    cancelEpoch++;
+}
+
+// Generates the contents of a single block on the calling thread
+// Only touches CPU-side data, so this is safe to call from any thread
+// Every random stream is derived from (worldSeed, block id, building / light index), never from shared state
+void BlockGenerator::Generate(BlockData& block, uint64_t worldSeed, bool festive, int colorCycle) const
+{
+    PHI_TRACE_SCOPE("Generate Block", std::to_string(block.id.x) + ", " + std::to_string(block.id.y));
+
+    Phi::Random rng{Phi::Hash(worldSeed, block.id.x, block.id.y)};
+
+    glm::vec3 blockPos = glm::vec3(block.id.x * blockSize, 0, block.id.y * blockSize);
+    block.height = STREET_LIGHT_HEIGHT;
+
+    // Create point lights for each street lamp
+    // NOTE: Colors have their own streams, so the layout drawn from rng never depends on them
+    for (int i = 0; i < (int)std::size(STREET_LIGHT_OFFSETS); i++)
+    {
+        glm::vec4 color = LightColor(worldSeed, block.id, i, festive, colorCycle);
+        block.lights.push_back({glm::vec4{blockPos + STREET_LIGHT_OFFSETS[i], STREET_LIGHT_RADIUS}, color});
+    }
+
+    // Reserve the max number of buildings so meshes are never moved while generating
+    block.buildings.reserve(12);
+
+    // Adds a building with its own random stream
+    // NOTE: Parameters are drawn in a fixed order here, since argument evaluation order is unspecified
+    auto addBuilding = [&](const glm::vec3& offset, int baseBlockCount, Building::Orientation orientation)
+    {
+        int stories = rng.Int(3, Building::MAX_STORIES);
+        int variant = rng.Int(0, Building::NUM_VARIANTS - 1);
+        Phi::Random buildingRng{Phi::Hash(worldSeed, block.id.x, block.id.y, block.buildings.size() + 1)};
+
+        BlockData::BuildingData& building = block.buildings.emplace_back();
+        building.pos = blockPos + offset;
+        Building::Generate(building.meshes, block.occluders, building.pos, stories, baseBlockCount, variant, orientation, buildingRng);
+
+        // Grow the block's bounds to fit the building
+        for (const Building::Vertex& vertex : building.meshes[0].GetVertices())
+        {
+            block.height = std::max(block.height, vertex.y);
+        }
+    };
+
+    // Generate buildings for each quadrant
+    for (int i = 0; i < 4; i++)
+    {
+        // Decide whether to place 3 small buildings or one large building
+        if (rng.Bool())
+        {
+            for (int j = 3 * i; j < 3 * i + 3; j++)
+            {
+                addBuilding(smallBuildingOffsets[j], 2, smallBuildingOrientations[j]);
+            }
+        }
+        else
+        {
+            addBuilding(largeBuildingOffsets[i], 4, largeBuildingOrientations[i]);
+        }
+    }
+}
+
+// Generates a street light color from the light's own stream
+// colorCycle is advanced by party mode, giving every light a new color
+glm::vec4 BlockGenerator::LightColor(uint64_t worldSeed, const glm::ivec2& id, int lightIndex, bool festive, int colorCycle)
+{
+    Phi::Random rng{Phi::Hash(worldSeed, id.x, id.y, LIGHT_STREAM, colorCycle, lightIndex)};
+
+    if (festive)
+    {
+        return rng.Bool() ? glm::vec4{1.0f, 0.0f, 0.0f, 1.0f} : glm::vec4{0.0f, 1.0f, 0.0f, 1.0f};
+    }
+    else
+    {
+        float r = rng.Float(0.2f, 1.0f);
+        float g = rng.Float(0.2f, 1.0f);
+        float b = rng.Float(0.2f, 1.0f);
+        return glm::vec4{glm::normalize(glm::vec3(r, g, b)), 1.0f};
+    }
+}
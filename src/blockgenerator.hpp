@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <phi/phi.hpp>
+
+#include "building.hpp"
+
+// CPU-side contents of a single city block
+// Produced on a worker thread, then handed to the main thread to be inserted into the registry
+struct BlockData
+{
+    // Generated building, ready to be moved into the block's Building::Group
+    struct BuildingData
+    {
+        glm::vec3 pos{0.0f};
+        Building::LODMeshes meshes;
+    };
+
+    // Generated street light
+    struct LightData
+    {
+        glm::vec4 pos{0.0f};
+        glm::vec4 color{1.0f};
+    };
+
+    // Block identification
+    glm::ivec2 id{0};
+    int epoch = 0;
+
+    // Height of the tallest object in the block, for the block's bounding box
+    float height = 0.0f;
+
+    // Generated contents
+    std::vector<BuildingData> buildings;
+    std::vector<LightData> lights;
+
+    // Solid boxes inside the buildings, used as occluders
+    std::vector<Phi::AABB> occluders;
+};
+
+// Generates city blocks as jobs on the Phi::JobSystem workers
+// Usage:
+// 1. Submit() block ids from the main thread
+// 2. Every frame, Collect() finished blocks and insert them into the scene
+class BlockGenerator
+{
+    // Interface
+    public:
+
+        BlockGenerator(int blockSize);
+        ~BlockGenerator();
+
+        // Delete copy constructor/assignment
+        BlockGenerator(const BlockGenerator&) = delete;
+        BlockGenerator& operator=(const BlockGenerator&) = delete;
+
+        // Delete move constructor/assignment
+        BlockGenerator(BlockGenerator&& other) = delete;
+        void operator=(BlockGenerator&& other) = delete;
+
+        // Queues a block for generation on a worker thread
+        // epoch is returned untouched with the finished block so stale results can be discarded
+        void Submit(const glm::ivec2& id, uint64_t worldSeed, bool festive, int colorCycle, int epoch);
+
+        // Moves up to maxBlocks finished blocks into out, returns the number collected
+        int Collect(std::vector<BlockData>& out, int maxBlocks);
+
+        // Blocks the calling thread until every submitted block has finished generating
+        void WaitIdle();
+
+        // Discards all blocks that have not started generating yet
+        void CancelPending();
+
+        // Generates the contents of a single block on the calling thread
+        // The layout only depends on worldSeed and the block's id, light colors additionally on festive and colorCycle,
+        // so a block can be dropped and later rebuilt identically
+        void Generate(BlockData& block, uint64_t worldSeed, bool festive, int colorCycle) const;
+
+        // Color of a block's street light, drawn from the light's own random stream
+        // Recoloring loaded lights with this gives the same colors as regenerating their block
+        static glm::vec4 LightColor(uint64_t worldSeed, const glm::ivec2& id, int lightIndex, bool festive, int colorCycle);
+
+        // Street light constants
+        // NOTE: Building streams are keyed by a building index >= 1, light streams by this tag first
+        static constexpr int LIGHT_STREAM = -1;
+        static constexpr float STREET_LIGHT_RADIUS = 8.0f;
+        static constexpr float STREET_LIGHT_HEIGHT = 4.0f;
+
+        // Accessors
+        inline int GetWorkerCount() const { return Phi::JobSystem::GetWorkerCount(); };
+        inline int GetPendingCount() const { return pending.GetCount(); };
+
+    // Data / implementation
+    private:
+
+        // Block layout
+        int blockSize;
+
+        // Tracks every submitted block until it has finished (or was cancelled)
+        Phi::JobSystem::Counter pending;
+
+        // Jobs submitted before the last CancelPending() skip generation
+        std::atomic<int> cancelEpoch = 0;
+
+        // Finished blocks waiting to be collected
+        std::mutex mutex;
+        std::deque<BlockData> finished;
+};
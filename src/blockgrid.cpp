@@ -0,0 +1,18 @@
+#include "blockgrid.hpp"
+
+// Returns the slot holding id, or nullptr if id is outside the window
+BlockGrid::Slot* BlockGrid::Find(const glm::ivec2& id)
+{
+    if (!Contains(id)) return nullptr;
+
+    Slot& slot = slots[IndexOf(id)];
+    return slot.id == id ? &slot : nullptr;
+}
+
+// Returns true if id is inside the current window
+bool BlockGrid::Contains(const glm::ivec2& id) const
+{
+    return size > 0 &&
+           id.x >= origin.x && id.x < origin.x + size &&
+           id.y >= origin.y && id.y < origin.y + size;
+}
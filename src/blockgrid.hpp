@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// EnTT: https://github.com/skypjack/entt
+#include <entt.hpp>
+
+#include <phi/frustum.hpp>
+
+// Fixed size toroidal grid of city blocks around the camera
+// A block id maps to slot (id mod size), so when the window moves only the slots of the
+// rows / columns that entered the window change, every other block stays where it is
+// Usage:
+// 1. Every frame, call Update() with the window's min corner and size
+// 2. unload(slot) is called for every block that leaves the window, load(slot) for every block that enters
+class BlockGrid
+{
+    // Interface
+    public:
+
+        // State of a single grid cell
+        enum class SlotState : int
+        {
+            Empty,
+            Generating,
+            Loaded
+        };
+
+        // A single grid cell, holds the entity of the block currently mapped to it
+        struct Slot
+        {
+            glm::ivec2 id{INT_MIN};
+            SlotState state = SlotState::Empty;
+
+            // Block contents / bounds, only valid when loaded
+            // Every component of the block (ground tile, buildings, street lights) lives on entity,
+            // so a block is released with a single destroy
+            entt::entity entity = entt::null;
+            glm::vec3 min{0.0f};
+            glm::vec3 max{0.0f};
+            std::vector<Phi::AABB> occluders;
+
+            // Building level of detail currently used for the block
+            int lod = 0;
+        };
+
+        BlockGrid() = default;
+        ~BlockGrid() = default;
+
+        // Delete copy constructor/assignment
+        BlockGrid(const BlockGrid&) = delete;
+        BlockGrid& operator=(const BlockGrid&) = delete;
+
+        // Delete move constructor/assignment
+        BlockGrid(BlockGrid&& other) = delete;
+        void operator=(BlockGrid&& other) = delete;
+
+        // Moves / resizes the window, calling unload(Slot&) and load(Slot&) for blocks leaving / entering it
+        // Does nothing unless the window has changed since the last call
+        // NOTE: When only the origin changes, the cost is proportional to the number of changed rows / columns
+        template <typename UnloadFn, typename LoadFn>
+        void Update(const glm::ivec2& newOrigin, int newSize, UnloadFn&& unload, LoadFn&& load);
+
+        // Unloads every slot and empties the grid, the next Update() will load the entire window
+        template <typename UnloadFn>
+        void Clear(UnloadFn&& unload);
+
+        // Returns the slot holding id, or nullptr if id is outside the window
+        Slot* Find(const glm::ivec2& id);
+
+        // Returns true if id is inside the current window
+        bool Contains(const glm::ivec2& id) const;
+
+        // Accessors
+        inline std::vector<Slot>& GetSlots() { return slots; };
+        inline const glm::ivec2& GetOrigin() const { return origin; };
+        inline int GetSize() const { return size; };
+
+    // Data / implementation
+    private:
+
+        // Index of the slot id maps to, wraps negative ids correctly
+        inline int IndexOf(const glm::ivec2& id) const
+        {
+            int x = ((id.x % size) + size) % size;
+            int y = ((id.y % size) + size) % size;
+            return y * size + x;
+        };
+
+        // Rebuilds the slots for a new window size, keeping blocks that are still inside the window
+        template <typename UnloadFn, typename LoadFn>
+        void Resize(const glm::ivec2& newOrigin, int newSize, UnloadFn&& unload, LoadFn&& load);
+
+        // Window state, covers [origin, origin + size) on both axes
+        glm::ivec2 origin{0};
+        int size = 0;
+        std::vector<Slot> slots;
+};
+
+// Templated code implementation
+
+template <typename UnloadFn, typename LoadFn>
+void BlockGrid::Update(const glm::ivec2& newOrigin, int newSize, UnloadFn&& unload, LoadFn&& load)
+{
+    // Changing the window size (or moving further than the window's width) touches every slot
+    glm::ivec2 shift = glm::abs(newOrigin - origin);
+    if (newSize != size || shift.x >= size || shift.y >= size)
+    {
+        Resize(newOrigin, newSize, unload, load);
+        return;
+    }
+
+    if (newOrigin == origin) return;
+
+    glm::ivec2 oldOrigin = origin;
+    origin = newOrigin;
+
+    // Each id that entered the window maps onto the slot of an id that left it
+    auto enter = [&](int x, int y)
+    {
+        Slot& slot = slots[IndexOf({x, y})];
+        if (slot.state != SlotState::Empty) unload(slot);
+        slot.id = {x, y};
+        load(slot);
+    };
+
+    // Visit only the ids that entered the window
+    int newEnd = newOrigin.y + size;
+    int oldEnd = oldOrigin.y + size;
+    for (int x = newOrigin.x; x < newOrigin.x + size; ++x)
+    {
+        if (x < oldOrigin.x || x >= oldOrigin.x + size)
+        {
+            // Entire column is new
+            for (int y = newOrigin.y; y < newEnd; ++y) enter(x, y);
+        }
+        else
+        {
+            // Only the rows outside the old window are new
+            for (int y = newOrigin.y; y < std::min(oldOrigin.y, newEnd); ++y) enter(x, y);
+            for (int y = std::max(oldEnd, newOrigin.y); y < newEnd; ++y) enter(x, y);
+        }
+    }
+}
+
+template <typename UnloadFn>
+void BlockGrid::Clear(UnloadFn&& unload)
+{
+    for (Slot& slot : slots)
+    {
+        if (slot.state != SlotState::Empty) unload(slot);
+    }
+    slots.clear();
+    size = 0;
+}
+
+template <typename UnloadFn, typename LoadFn>
+void BlockGrid::Resize(const glm::ivec2& newOrigin, int newSize, UnloadFn&& unload, LoadFn&& load)
+{
+    std::vector<Slot> oldSlots;
+    oldSlots.swap(slots);
+
+    origin = newOrigin;
+    size = newSize;
+    slots.resize(size * size);
+
+    // Move blocks that are still inside the window, unload the rest
+    for (Slot& slot : oldSlots)
+    {
+        if (slot.state == SlotState::Empty) continue;
+
+        if (Contains(slot.id)) slots[IndexOf(slot.id)] = std::move(slot);
+        else unload(slot);
+    }
+
+    // Load every slot that is still empty
+    for (int x = origin.x; x < origin.x + size; ++x)
+    {
+        for (int y = origin.y; y < origin.y + size; ++y)
+        {
+            Slot& slot = slots[IndexOf({x, y})];
+            if (slot.state != SlotState::Empty) continue;
+
+            slot.id = {x, y};
+            load(slot);
+        }
+    }
+}
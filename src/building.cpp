@@ -1,84 +1,169 @@
 #include "building.hpp"
 
-// Main constructor
-Building::Building(const glm::vec3 &pos, int stories, int baseBlockCount, int variant, Orientation orientation)
+// Group constructor
+Building::Group::Group()
 {
-    // Initialize static resources if first instance
+    // Initialize static resources if first group
     if (refCount == 0)
     {
         // Load the texture atlas
         textureAtlas = new Phi::Texture2D("data/textures/buildingAtlas.png", GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST_MIPMAP_LINEAR, GL_NEAREST, true);
 
         // Initialize the render batch
-        renderBatch = new Phi::RenderBatch<Phi::VertexPosNormUv>(65'536, 131'072);
+        renderBatch = new Phi::RenderBatch<Vertex>(65'536, 131'072);
+        renderBatch->SetParallelFill(parallelBatchFill);
 
-        // Calculate normalized tile size for atlas offsets
-        int w = textureAtlas->GetWidth();
-        int h = textureAtlas->GetHeight();
-        tileSize = w / (int)TexOffset::Count;
-        tileSizeNormalized = glm::vec2((float)tileSize / w, (float)tileSize / h);
+        // Initialize the static geometry pool (grows if the view distance needs more)
+        geometryPool = new Phi::GeometryPool<Vertex>(524'288, 786'432);
     }
     refCount++;
+}
 
-    this->pos = pos;
-
+// Generates all of the vertex data for a building
+void Building::Generate(LODMeshes& meshes, std::vector<Phi::AABB>& occluders, const glm::vec3& pos, int stories,
+                        int baseBlockCount, int variant, Orientation orientation, Phi::Random& rng)
+{
     // Clamp to safe input values
     stories = std::clamp(stories, 1, MAX_STORIES);
     variant = std::clamp(variant, 0, NUM_VARIANTS);
 
+    // The full mesh is generated first, the coarse LODs follow its step-back sections
+    Phi::Mesh<Vertex>& mesh = meshes[0];
+    int sectionStart = 0;
+
     // Generate the first story
     // Place door depending on facing direction
-    AddFace(Orientation::North, orientation == Orientation::North ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount);
-    AddFace(Orientation::East, orientation == Orientation::East ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount);
-    AddFace(Orientation::South, orientation == Orientation::South ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount);
-    AddFace(Orientation::West, orientation == Orientation::West ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount);
+    AddFace(mesh, pos, Orientation::North, orientation == Orientation::North ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount, rng);
+    AddFace(mesh, pos, Orientation::East, orientation == Orientation::East ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount, rng);
+    AddFace(mesh, pos, Orientation::South, orientation == Orientation::South ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount, rng);
+    AddFace(mesh, pos, Orientation::West, orientation == Orientation::West ? TexOffset::Door : TexOffset::Wall, variant, 0, baseBlockCount, rng);
 
     // Generate each additional story's vertex data
     int currentStoryBlocks = baseBlockCount;
     for (int i = 1; i < stories; i++)
     {
-        AddFace(Orientation::North, RandomWallType(i), variant, i, currentStoryBlocks);
-        AddFace(Orientation::East, RandomWallType(i), variant, i, currentStoryBlocks);
-        AddFace(Orientation::South, RandomWallType(i), variant, i, currentStoryBlocks);
-        AddFace(Orientation::West, RandomWallType(i), variant, i, currentStoryBlocks);
+        AddFace(mesh, pos, Orientation::North, RandomWallType(i, rng), variant, i, currentStoryBlocks, rng);
+        AddFace(mesh, pos, Orientation::East, RandomWallType(i, rng), variant, i, currentStoryBlocks, rng);
+        AddFace(mesh, pos, Orientation::South, RandomWallType(i, rng), variant, i, currentStoryBlocks, rng);
+        AddFace(mesh, pos, Orientation::West, RandomWallType(i, rng), variant, i, currentStoryBlocks, rng);
 
         // If not the final story
         if (i != stories - 1)
         {
             // Step?
-            if (stepDist(rng) == 0 && currentStoryBlocks > 1)
+            if (rng.Int(0, 6) == 0 && currentStoryBlocks > 1)
             {
                 // Generate the roof
-                AddFace(Orientation::Up, TexOffset::Roof, variant, i, currentStoryBlocks);
+                AddFace(mesh, pos, Orientation::Up, TexOffset::Roof, variant, i, currentStoryBlocks, rng);
+
+                // Close the section for the coarse LODs
+                // NOTE: These don't use rng, so the full mesh is identical with or without LODs
+                AddBox(meshes[1], pos, sectionStart, i + 1 - sectionStart, currentStoryBlocks, variant, true);
+                AddBox(meshes[2], pos, sectionStart, i + 1 - sectionStart, currentStoryBlocks, variant, false);
+                occluders.push_back({pos + glm::vec3(-0.5f * currentStoryBlocks, sectionStart, -0.5f * currentStoryBlocks),
+                                     pos + glm::vec3(0.5f * currentStoryBlocks, i + 1, 0.5f * currentStoryBlocks)});
+                sectionStart = i + 1;
+
                 currentStoryBlocks--;
             }
         }
     }
 
     // Generate the final roof
-    AddFace(Orientation::Up, TexOffset::Roof, variant, stories - 1, currentStoryBlocks);
+    AddFace(mesh, pos, Orientation::Up, TexOffset::Roof, variant, stories - 1, currentStoryBlocks, rng);
+
+    // Close the final section for the coarse LODs
+    AddBox(meshes[1], pos, sectionStart, stories - sectionStart, currentStoryBlocks, variant, true);
+    AddBox(meshes[2], pos, sectionStart, stories - sectionStart, currentStoryBlocks, variant, false);
+    occluders.push_back({pos + glm::vec3(-0.5f * currentStoryBlocks, sectionStart, -0.5f * currentStoryBlocks),
+                         pos + glm::vec3(0.5f * currentStoryBlocks, stories, 0.5f * currentStoryBlocks)});
 }
 
 // Cleanup
-Building::~Building()
+Building::Group::~Group()
 {
+    // Release every building's space in the geometry pool
+    for (std::vector<Allocation>& lodAllocations : allocations)
+    {
+        for (Allocation& allocation : lodAllocations)
+        {
+            geometryPool->Free(allocation);
+        }
+    }
+
     refCount--;
     if (refCount == 0)
     {
         // Cleanup static resources
         delete textureAtlas;
         delete renderBatch;
+        delete geometryPool;
+    }
+}
+
+// Reserves space for count buildings, so adding them never moves the meshes already added
+void Building::Group::Reserve(int count)
+{
+    if (!staticGeometry)
+    {
+        meshes.reserve(count);
+        return;
+    }
+
+    for (std::vector<Allocation>& lodAllocations : allocations)
+    {
+        lodAllocations.reserve(count);
     }
 }
 
-// Draws this building into the static buffer
-void Building::Draw(const Phi::Shader& shader) const
+// Adds a generated building
+// Static geometry uploads its meshes once since they never change, and drops the CPU copies
+void Building::Group::Add(LODMeshes&& buildingMeshes)
 {
+    count++;
+
+    if (!staticGeometry)
+    {
+        meshes.push_back(std::move(buildingMeshes));
+        return;
+    }
+
+    for (int i = 0; i < NUM_LODS; i++)
+    {
+        allocations[i].push_back(geometryPool->Allocate(buildingMeshes[i]));
+    }
+}
+
+// Draws every building in the group
+// lod is clamped to [0, NUM_LODS)
+void Building::Group::Draw(const Phi::Shader& shader, int lod) const
+{
+    lod = std::clamp(lod, 0, NUM_LODS - 1);
+
+    // Static geometry only needs a draw command per building
+    if (staticGeometry)
+    {
+        DrawStatic(allocations[lod].data(), (int)allocations[lod].size());
+        return;
+    }
+
     // TODO: Reactive flushing could be made simpler
-    if (!renderBatch->AddMesh(mesh))
+    for (const LODMeshes& buildingMeshes : meshes)
     {
-        FlushDrawCalls(shader);
-        renderBatch->AddMesh(mesh);
+        if (!renderBatch->AddMesh(buildingMeshes[lod]))
+        {
+            FlushDrawCalls(shader);
+            renderBatch->AddMesh(buildingMeshes[lod]);
+        }
+    }
+}
+
+// Queues a draw command for each static geometry allocation
+void Building::DrawStatic(const Allocation* allocations, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        geometryPool->AddDraw(allocations[i]);
     }
 }
 
@@ -89,11 +174,22 @@ void Building::FlushDrawCalls(const Phi::Shader& shader)
     textureAtlas->Bind();
 
     // Issue rendering commands
-    renderBatch->Flush(shader);
+    if (staticGeometry)
+    {
+        geometryPool->Flush(shader);
+    }
+    else
+    {
+        renderBatch->Flush(shader);
+    }
+
+    // The batch is empty now, so the fill mode can change
+    renderBatch->SetParallelFill(parallelBatchFill);
 }
 
 // Constructs a wall with the given parameters
-void Building::AddFace(Orientation dir, TexOffset type, int variant, int story, int blocks)
+void Building::AddFace(Phi::Mesh<Vertex>& mesh, const glm::vec3& pos, Orientation dir, TexOffset type,
+                       int variant, int story, int blocks, Phi::Random& rng)
 {
     bool doorPlaced = false;
 
@@ -106,7 +202,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
             case TexOffset::Door:
 
                 // Ensure we eventually place a door if rng doesn't first
-                if (!doorPlaced && (boolDist(rng) || i == blocks * 2 - 2))
+                if (!doorPlaced && (rng.Bool() || i == blocks * 2 - 2))
                 {
                     texOffsets[i] = (float)type * tileSizeNormalized.x;
                     texOffsets[i + 1] = (float)(NUM_VARIANTS - variant) * tileSizeNormalized.y;
@@ -114,7 +210,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
                 }
                 else
                 {
-                    texOffsets[i] = (float)RandomWallType(story) * tileSizeNormalized.x;
+                    texOffsets[i] = (float)RandomWallType(story, rng) * tileSizeNormalized.x;
                     texOffsets[i + 1] = (float)(NUM_VARIANTS - variant) * tileSizeNormalized.y;
                 }
 
@@ -150,7 +246,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
                     {-halfSize + xOffset + pos.x, yPosOffs + pos.y, -halfSize * blocks + pos.z, 0.0f, 0.0f, -1.0f, texOffsets[i * 2] + tileSizeNormalized.x, texOffsets[i * 2 + 1] - tileSizeNormalized.y}
                 );
 
-                if (boolDist(rng)) keepGenFeatures = keepGenFeatures ? AddFeature(type, dir, {xOffset + pos.x, yPosOffs + halfSize + pos.y, -halfSize * blocks + pos.z}, variant, story, blocks) : keepGenFeatures;
+                if (rng.Bool()) keepGenFeatures = keepGenFeatures ? AddFeature(mesh, type, dir, {xOffset + pos.x, yPosOffs + halfSize + pos.y, -halfSize * blocks + pos.z}, variant, story, blocks) : keepGenFeatures;
 
                 // Adjust offset
                 xOffset += storySize;
@@ -168,7 +264,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
                     {halfSize * blocks + pos.x, yPosOffs + pos.y, -halfSize + xOffset + pos.z, 1.0f, 0.0f, 0.0f, texOffsets[i * 2] + tileSizeNormalized.x, texOffsets[i * 2 + 1] - tileSizeNormalized.y}
                 );
 
-                if (boolDist(rng)) keepGenFeatures = keepGenFeatures ? AddFeature(type, dir, {halfSize * blocks + pos.x, yPosOffs + halfSize + pos.y, xOffset + pos.z}, variant, story, blocks) : keepGenFeatures;
+                if (rng.Bool()) keepGenFeatures = keepGenFeatures ? AddFeature(mesh, type, dir, {halfSize * blocks + pos.x, yPosOffs + halfSize + pos.y, xOffset + pos.z}, variant, story, blocks) : keepGenFeatures;
 
                 // Adjust offset
                 xOffset += storySize;
@@ -186,7 +282,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
                     {halfSize + xOffset + pos.x, yPosOffs + pos.y, halfSize * blocks + pos.z, 0.0f, 0.0f, 1.0f, texOffsets[i * 2] + tileSizeNormalized.x, texOffsets[i * 2 + 1] - tileSizeNormalized.y}
                 );
 
-                if (boolDist(rng)) keepGenFeatures = keepGenFeatures ? AddFeature(type, dir, {xOffset + pos.x, yPosOffs + halfSize + pos.y, halfSize * blocks + pos.z}, variant, story, blocks) : keepGenFeatures;
+                if (rng.Bool()) keepGenFeatures = keepGenFeatures ? AddFeature(mesh, type, dir, {xOffset + pos.x, yPosOffs + halfSize + pos.y, halfSize * blocks + pos.z}, variant, story, blocks) : keepGenFeatures;
 
                 // Adjust offset
                 xOffset += storySize;
@@ -205,7 +301,7 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
                     {-halfSize * blocks + pos.x, yPosOffs + pos.y, halfSize + xOffset + pos.z, -1.0f, 0.0f, 0.0f, texOffsets[i * 2] + tileSizeNormalized.x, texOffsets[i * 2 + 1] - tileSizeNormalized.y}
                 );
 
-                if (boolDist(rng)) keepGenFeatures = keepGenFeatures ? AddFeature(type, dir, {-halfSize * blocks + pos.x, yPosOffs + halfSize + pos.y, xOffset + pos.z}, variant, story, blocks) : keepGenFeatures;
+                if (rng.Bool()) keepGenFeatures = keepGenFeatures ? AddFeature(mesh, type, dir, {-halfSize * blocks + pos.x, yPosOffs + halfSize + pos.y, xOffset + pos.z}, variant, story, blocks) : keepGenFeatures;
 
                 // Adjust offset
                 xOffset += storySize;
@@ -241,7 +337,8 @@ void Building::AddFace(Orientation dir, TexOffset type, int variant, int story,
 
 // Adds a feature to the building, returning whether or not to keep generating features
 // for that specific face
-bool Building::AddFeature(TexOffset type, Orientation orientation, const glm::vec3& facePos, int variant, int story, int blocks)
+bool Building::AddFeature(Phi::Mesh<Vertex>& mesh, TexOffset type, Orientation orientation, const glm::vec3& facePos,
+                          int variant, int story, int blocks)
 {
     // Build rotation matrix based on orientation
     glm::mat4 rotation = glm::mat4(1.0f);
@@ -331,12 +428,83 @@ bool Building::AddFeature(TexOffset type, Orientation orientation, const glm::ve
     }
 }
 
-// Randomly chooses a wall type (not seeded)
-Building::TexOffset Building::RandomWallType(int story) const
+// Adds a coarse box for one step-back section of a building
+// Walls are textured with a window tile stretched over the whole quad, at a distance
+// mipmapping averages it down to the tile's overall color
+void Building::AddBox(Phi::Mesh<Vertex>& mesh, const glm::vec3& pos, int firstStory, int storyCount, int blocks,
+                      int variant, bool perStory)
+{
+    // Texture coordinates of the wall and roof tiles
+    float top = (float)(NUM_VARIANTS - variant) * tileSizeNormalized.y;
+    float bottom = top - tileSizeNormalized.y;
+    float wallLeft = (float)TexOffset::Window * tileSizeNormalized.x;
+    float wallRight = wallLeft + tileSizeNormalized.x;
+    float roofLeft = (float)TexOffset::Roof * tileSizeNormalized.x;
+    float roofRight = roofLeft + tileSizeNormalized.x;
+
+    // Box dimensions
+    float extent = 0.5f * blocks;
+    float rowHeight = perStory ? 1.0f : (float)storyCount;
+    int rows = perStory ? storyCount : 1;
+
+    float x0 = pos.x - extent, x1 = pos.x + extent;
+    float z0 = pos.z - extent, z1 = pos.z + extent;
+
+    // Walls, with the same winding as AddFace()
+    for (int i = 0; i < rows; i++)
+    {
+        float y0 = pos.y + firstStory + i * rowHeight;
+        float y1 = y0 + rowHeight;
+
+        // North (Z-)
+        mesh.AddQuad(
+            {x1, y1, z0, 0.0f, 0.0f, -1.0f, wallLeft, top},
+            {x0, y1, z0, 0.0f, 0.0f, -1.0f, wallRight, top},
+            {x1, y0, z0, 0.0f, 0.0f, -1.0f, wallLeft, bottom},
+            {x0, y0, z0, 0.0f, 0.0f, -1.0f, wallRight, bottom}
+        );
+
+        // East (X+)
+        mesh.AddQuad(
+            {x1, y1, z1, 1.0f, 0.0f, 0.0f, wallLeft, top},
+            {x1, y1, z0, 1.0f, 0.0f, 0.0f, wallRight, top},
+            {x1, y0, z1, 1.0f, 0.0f, 0.0f, wallLeft, bottom},
+            {x1, y0, z0, 1.0f, 0.0f, 0.0f, wallRight, bottom}
+        );
+
+        // South (Z+)
+        mesh.AddQuad(
+            {x0, y1, z1, 0.0f, 0.0f, 1.0f, wallLeft, top},
+            {x1, y1, z1, 0.0f, 0.0f, 1.0f, wallRight, top},
+            {x0, y0, z1, 0.0f, 0.0f, 1.0f, wallLeft, bottom},
+            {x1, y0, z1, 0.0f, 0.0f, 1.0f, wallRight, bottom}
+        );
+
+        // West (X-)
+        mesh.AddQuad(
+            {x0, y1, z0, -1.0f, 0.0f, 0.0f, wallLeft, top},
+            {x0, y1, z1, -1.0f, 0.0f, 0.0f, wallRight, top},
+            {x0, y0, z0, -1.0f, 0.0f, 0.0f, wallLeft, bottom},
+            {x0, y0, z1, -1.0f, 0.0f, 0.0f, wallRight, bottom}
+        );
+    }
+
+    // Roof (Y+)
+    float roofY = pos.y + firstStory + storyCount;
+    mesh.AddQuad(
+        {x0, roofY, z0, 0.0f, 1.0f, 0.0f, roofLeft, top},
+        {x1, roofY, z0, 0.0f, 1.0f, 0.0f, roofRight, top},
+        {x0, roofY, z1, 0.0f, 1.0f, 0.0f, roofLeft, bottom},
+        {x1, roofY, z1, 0.0f, 1.0f, 0.0f, roofRight, bottom}
+    );
+}
+
+// Randomly chooses a wall type from the building's random stream
+Building::TexOffset Building::RandomWallType(int story, Phi::Random& rng)
 {
     if (story == 0)
     {
-        return boolDist(rng) ? TexOffset::Window : TexOffset::LargeWindow;
+        return rng.Bool() ? TexOffset::Window : TexOffset::LargeWindow;
     }
-    return (TexOffset)wallDist(rng);
+    return (TexOffset)rng.Int((int)TexOffset::Wall, (int)TexOffset::LargeWindow);
 }
\ No newline at end of file
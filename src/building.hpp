@@ -1,18 +1,23 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <vector>
-#include <random>
 
 #include <glm/glm.hpp>
 
 #include <phi/phi.hpp>
 
+// Procedural building generation, and the static resources used to draw buildings
+// Buildings are stored per city block in a Building::Group
 class Building
 {
     // Interface
     public:
 
+        // Static interface only
+        Building() = delete;
+
         // Feature flags for generating extra vertex data
         // There was going to be more, but I ran out of time
         enum class Feature : int
@@ -45,56 +50,112 @@ class Building
             Count
         };
 
-        // Constructor
-        Building(const glm::vec3& pos, int stories, int baseBlockCount, int variant, Orientation orientation = Orientation::North);
-        ~Building();
+        // Vertex format used by all buildings
+        typedef Phi::VertexPosNormUv Vertex;
+
+        // Levels of detail generated for every building
+        // 0: Full mesh, every story and tile with features
+        // 1: One quad per story and face, no features
+        // 2: One box per step-back section
+        static const inline int NUM_LODS = 3;
+        typedef std::array<Phi::Mesh<Vertex>, NUM_LODS> LODMeshes;
+        typedef Phi::GeometryPool<Vertex>::Allocation Allocation;
+
+        // Every building of a single city block
+        // Draw handles are kept in one contiguous array per level of detail, so drawing a block
+        // walks a single array instead of a building object (and its meshes) per building
+        // With static geometry the meshes are released as soon as they are uploaded, they are only kept when streaming
+        // NOTE: Must be created on the main thread, as the first group initializes OpenGL resources
+        // NOTE: Groups only hold what the staticGeometry mode they were filled in needs, so they must be recreated when it changes
+        class Group
+        {
+            public:
+
+                Group();
+                ~Group();
+
+                // Delete copy constructor/assignment
+                Group(const Group&) = delete;
+                Group& operator=(const Group&) = delete;
+
+                // Delete move constructor/assignment
+                Group(Group&& other) = delete;
+                void operator=(Group&& other) = delete;
+
+                // Takes the vertex data of a building created by Generate(), keeping it only when streaming
+                void Reserve(int count);
+                void Add(LODMeshes&& meshes);
+
+                // Draws every building in the group, lod is clamped to [0, NUM_LODS)
+                void Draw(const Phi::Shader& shader, int lod = 0) const;
+
+                // Accessors
+                inline int GetCount() const { return count; };
+                inline const std::vector<Allocation>& GetAllocations(int lod) const { return allocations[lod]; };
+
+            private:
+
+                int count = 0;
 
-        // Delete copy constructor/assignment
-        Building(const Building&) = delete;
-        Building& operator=(const Building&) = delete;
+                // Procedurally generated mesh instances, only kept when streaming
+                std::vector<LODMeshes> meshes;
 
-        // Delete move constructor/assignment
-        Building(Building&& other) = delete;
-        void operator=(Building&& other) = delete;
+                // Location of each building's mesh in the static geometry pool, one array per level of detail (static geometry only)
+                std::array<std::vector<Allocation>, NUM_LODS> allocations;
+        };
+
+        // Procedurally generates the vertex data for every level of detail of a building
+        // One solid box per step-back section is appended to occluders, for occlusion culling
+        // Only touches CPU-side data, so it is safe to call from worker threads
+        static void Generate(LODMeshes& meshes, std::vector<Phi::AABB>& occluders, const glm::vec3& pos, int stories,
+                             int baseBlockCount, int variant, Orientation orientation, Phi::Random& rng);
 
         // Constants
         static const inline int MAX_STORIES = 16;
         static const inline int NUM_VARIANTS = 4;
 
-        // Rendering methods
-        void Draw(const Phi::Shader& shader) const;
+        // Queues a draw command for each static geometry allocation (see Group::GetAllocations())
+        static void DrawStatic(const Allocation* allocations, int count);
+
+        // Flushes all buildings drawn since the last flush
         static void FlushDrawCalls(const Phi::Shader& shader);
+
+        // When true, buildings are drawn from geometry uploaded once at construction,
+        // otherwise all building meshes are streamed through the render batch every frame
+        static inline bool staticGeometry = true;
+
+        // When streaming, copies the meshes into the render batch on the job workers
+        static inline bool parallelBatchFill = true;
+
+        // Static geometry pool stats
+        static size_t GetGeometryPoolSize() { return geometryPool ? geometryPool->GetSizeInBytes() : 0; };
     
     // Data / implementation
     private:
 
-        // World position of building
-        glm::vec3 pos;
-
-        // Mesh instance to be procedurally generated
-        Phi::Mesh<Phi::VertexPosNormUv> mesh;
-
         // Helper methods for procedural generation
-        void AddFace(Orientation dir, TexOffset type, int variant, int story, int blocks);
-        bool AddFeature(TexOffset type, Orientation orientation, const glm::vec3& facePos, int variant, int story, int blocks);
-        TexOffset RandomWallType(int story) const;
+        static void AddFace(Phi::Mesh<Vertex>& mesh, const glm::vec3& pos, Orientation dir, TexOffset type,
+                            int variant, int story, int blocks, Phi::Random& rng);
+        static bool AddFeature(Phi::Mesh<Vertex>& mesh, TexOffset type, Orientation orientation, const glm::vec3& facePos,
+                               int variant, int story, int blocks);
+        static TexOffset RandomWallType(int story, Phi::Random& rng);
 
-        // Tile sizes
-        static inline int tileSize;
-        static inline glm::vec2 tileSizeNormalized;
+        // Adds a coarse box covering stories [firstStory, firstStory + storyCount) of a section
+        // If perStory is true each story gets its own row of quads, otherwise each face is a single quad
+        static void AddBox(Phi::Mesh<Vertex>& mesh, const glm::vec3& pos, int firstStory, int storyCount, int blocks,
+                           int variant, bool perStory);
+
+        // Normalized tile size, the atlas has one column per TexOffset and one row per variant
+        // NOTE: Constant so generation never has to wait for the atlas to be loaded
+        static constexpr glm::vec2 tileSizeNormalized{1.0f / (float)TexOffset::Count, 1.0f / (float)NUM_VARIANTS};
 
         // Static resources
         static inline Phi::Texture2D* textureAtlas = nullptr;
-        static inline Phi::RenderBatch<Phi::VertexPosNormUv>* renderBatch = nullptr;
+        static inline Phi::RenderBatch<Vertex>* renderBatch = nullptr;
+        static inline Phi::GeometryPool<Vertex>* geometryPool = nullptr;
 
-        // Reference counting for static resources
+        // Reference counting for static resources, one reference per group
         static inline int refCount = 0;
-
-        // RNG
-        static inline std::default_random_engine rng;
-        static inline std::uniform_int_distribution<int> wallDist{(int)TexOffset::Wall, (int)TexOffset::LargeWindow};
-        static inline std::uniform_int_distribution<int> stepDist{0, 6};
-        static inline std::uniform_int_distribution<int> boolDist{0, 1};
 };
 
 // Offset locations relative to a city block origin for buildings
@@ -3,18 +3,26 @@
 // Constructor
 Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/textures/skyboxDay", "data/textures/skyboxNight")
 {
+    PHI_TRACE_SCOPE("Cityscape Init");
+
+    // Start from the engine's current settings
+    settings.staticGeometry = Building::staticGeometry;
+    settings.parallelBatchFill = Building::parallelBatchFill;
+    settings.glStateCache = Phi::GLState::enabled;
+    renderSettings = settings;
+
     // Enable programs
-    glEnable(GL_DEPTH_TEST);
+    Phi::GLState::Enable(GL_DEPTH_TEST);
     glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 
     // Back face culling
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    Phi::GLState::Enable(GL_CULL_FACE);
+    Phi::GLState::CullFace(GL_BACK);
     glFrontFace(GL_CCW);
 
     // Initialize blend functions (only used for point light pass)
     glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_ONE, GL_ONE);
+    Phi::GLState::BlendFunc(GL_ONE, GL_ONE);
 
     // Load building shader
     buildingShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/building.vs");
@@ -25,9 +33,11 @@ Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/texture
     shadowPassShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/shadowPass.vs");
     shadowPassShader.LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/empty.fs");
     shadowPassShader.Link();
+    shadowViewProjUniform = shadowPassShader.GetUniform<glm::mat4>("viewProj");
     shadowPassInstanceShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/shadowPassInstances.vs");
     shadowPassInstanceShader.LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/empty.fs");
     shadowPassInstanceShader.Link();
+    shadowInstanceViewProjUniform = shadowPassInstanceShader.GetUniform<glm::mat4>("viewProj");
 
     // Load lighting pass shader
     globalLightShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/globalLightPass.vs");
@@ -49,29 +59,24 @@ Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/texture
     snowEffectShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/snow.vs");
     snowEffectShader.LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/snow.fs");
     snowEffectShader.Link();
+    deltaTimeWindUniform = snowEffectShader.GetUniform<glm::vec3>("deltaTimeWind");
 
     // Load snowbank shader
     snowbankShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/snowbank.vs");
     snowbankShader.LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/snowbank.fs");
     snowbankShader.Link();
+    accumulationHeightUniform = snowbankShader.GetUniform<float>("accumulationHeight");
 
-    // Load shadow map depth texture
-    shadowDepthTex = new Phi::Texture2D(1024, 1024,
-                                        GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT,
-                                        GL_FLOAT,
-                                        GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
-                                        GL_NEAREST, GL_NEAREST);
-    shadowDepthTex->Bind();
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    // Initialize light space UBO
-    lightSpaceUBO = new Phi::GPUBuffer(Phi::BufferType::Dynamic, sizeof(glm::mat4));
-    lightSpaceUBO->BindBase(GL_UNIFORM_BUFFER, 5);
+    // Initialize geometry buffer layout UBO, written by RecreateFBO()
+    gBufferUBO = new Phi::GPUBuffer(Phi::BufferType::Dynamic, sizeof(glm::vec4));
+    gBufferUBO->BindBase(GL_UNIFORM_BUFFER, 6);
     
     // Create the geometry buffer
     RecreateFBO();
 
+    // Clustered point light binning / shading
+    clusteredLighting = new ClusteredLighting();
+
     // Generate placeholder empty VAO for attributeless rendering
     // This is really only used for drawing a fullscreen triangle generated
     // by a vertex shader for some post-processing effects since it saves
@@ -84,8 +89,14 @@ Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/texture
     snowbankModel = new Phi::Model("data/models/snow.obj");
 
     // Initialize camera pos
+    simCamera.SetPosition(glm::vec3(0, 2, 4));
     mainCamera.SetPosition(glm::vec3(0, 2, 4));
 
+    // The simulation starts from the sky's time of day
+    dayCycle = sky.dayCycle;
+    timeOfDay = sky.currentTime;
+    currentState = previousState = renderState = CaptureState();
+
     // Generate grid of buildings around the camera
     Regenerate();
 
@@ -93,9 +104,10 @@ Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/texture
     glm::vec4 snowPositions[SNOWFLAKE_COUNT];
     for (int i = 0; i < SNOWFLAKE_COUNT; ++i)
     {
-        std::uniform_real_distribution<float> posDist{-2.0f, 2.0f};
-        std::uniform_real_distribution<float> sizeDist{1.0f, 4.0f};
-        snowPositions[i] = {posDist(rng), posDist(rng), posDist(rng), sizeDist(rng)};
+        float x = rng.Float(-2.0f, 2.0f);
+        float y = rng.Float(-2.0f, 2.0f);
+        float z = rng.Float(-2.0f, 2.0f);
+        snowPositions[i] = {x, y, z, rng.Float(1.0f, 4.0f)};
     }
 
     // Upload snow particle data and create vertex attributes
@@ -112,11 +124,11 @@ Cityscape::Cityscape() : App("Cityscape", 4, 4), mainCamera(), sky("data/texture
     if (glfwRawMouseMotionSupported())
     {
         glfwSetInputMode(GetWindow(), GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
-        std::cout << "Raw mouse motion enabled" << std::endl;
+        PHI_LOG_INFO("Raw mouse motion enabled");
     }
 	
     // Success msg
-    std::cout << "Cityscape initialized successfully" << std::endl;
+    PHI_LOG_INFO("Cityscape initialized successfully");
 }
 
 // Cleanup
@@ -133,55 +145,55 @@ Cityscape::~Cityscape()
     delete streetLightModel;
     delete snowbankModel;
     delete snowBuffer;
-    delete shadowDepthTex;
-    delete lightSpaceUBO;
+    delete gBufferUBO;
+    delete clusteredLighting;
 
     // Delete all loaded blocks
-    for (const auto&[id, entityList] : cityBlocks)
-    {
-        DeleteBlock(id);
-    }
-    cityBlocks.clear();
+    blockGrid.Clear([this](BlockGrid::Slot& slot) { DeleteBlock(slot); });
 
-    std::cout << "Cityscape shutdown successfully" << std::endl;
+    PHI_LOG_INFO("Cityscape shutdown successfully");
 }
 
 void Cityscape::Update(float delta)
 {
+    // Keep the last step around for interpolation
+    previousState = currentState;
     lastFrameTime = delta;
 
-    // Recreate the Geometry Buffer if the app's window was resized
-    if (windowResized)
-    {
-        RecreateFBO();
-        windowResized = false;
-    }
-
-    // Update the camera's viewport if the window size has changed
-    if (wWidth != mainCamera.GetWidth() || wHeight != mainCamera.GetHeight())
-        mainCamera.UpdateViewport(wWidth, wHeight);
-
-    // Process all input for this frame
+    // Process all input for this step
     ProcessInput(delta);
 
-    // Update loaded blocks
-    UpdateBlocks();
-    UpdateLights();
-
     // Simulate time and its effects
     if (timeAdvance)
     {
         // Advance time and wrap at dayCycle
-        sky.currentTime += delta;
-        sky.Update();
+        timeOfDay += delta;
+        while (timeOfDay > dayCycle) timeOfDay -= dayCycle;
 
         // Adjust snow accumulation if time is being simulated
         if (snow)
             snowAccumulation = snowAccumulation >= maxAccumulation ? maxAccumulation : snowAccumulation + delta * snowIntensity * baseAccumulationLevel;
         else
-            snowAccumulation = snowAccumulation <= 0.0f ? 0.0f : snowAccumulation - lastFrameTime * baseAccumulationLevel * (!sky.IsNight() + 1);
+            snowAccumulation = snowAccumulation <= 0.0f ? 0.0f : snowAccumulation - delta * baseAccumulationLevel * (!IsNight() + 1);
+    }
+
+    // Cycle light colors in party mode
+    if (partyMode)
+    {
+        lightTimeAccum += delta;
+        if (lightTimeAccum >= lightTimer)
+        {
+            lightColorCycle++;
+            recolorRequested = true;
+            lightTimeAccum = 0.0f;
+        }
     }
 
+    currentState = CaptureState();
+}
+
+void Cityscape::UpdateGUI()
+{
     // Render ImGui windows
     if (paused || keepGUIOpen)
     {
@@ -191,8 +203,16 @@ void Cityscape::Update(float delta)
         ImGui::Separator();
 
         // Simulation statistics
-        ImGui::Text("Buildings: %d", buildingDrawCount);
-        ImGui::Text("Lights: %d", lightDrawCount);
+        ImGui::Text("Blocks Visible: %d / %d", stats.visibleBlockCount, stats.loadedBlockCount);
+        ImGui::Text("Shadow Cascades Rendered: %d / %d (%d blocks)", stats.shadowCascadeCount, ShadowCascades::CASCADE_COUNT, stats.shadowBlockCount);
+        ImGui::Text("Occlusion Culled: %d blocks, %d light volumes (%d occluder tris)", stats.occludedBlockCount, stats.occludedLightCount, stats.occluderTriangleCount);
+        ImGui::Text("Buildings: %d (LOD 0/1/2: %d / %d / %d)", stats.buildingDrawCount, stats.buildingLODCounts[0], stats.buildingLODCounts[1], stats.buildingLODCounts[2]);
+        ImGui::Text("Building Geometry: %.1f MB", stats.geometryPoolSize / (1024.0f * 1024.0f));
+        ImGui::Text("G-Buffer: %.1f MB", stats.gBufferSize / (1024.0f * 1024.0f));
+        ImGui::Text("Lights: %d", stats.lightDrawCount);
+        ImGui::Text("Light Pool: %d / %d (%.1f KB uploaded)", stats.lightPoolCount, stats.lightPoolCapacity, stats.lightUploadSize / 1024.0f);
+        ImGui::Text("Blocks Generating: %d (%d workers)", blockGenerator.GetPendingCount(), blockGenerator.GetWorkerCount());
+        ImGui::Text("Textures Loading: %d", Phi::TextureLoader::GetPendingCount());
         ImGui::Separator();
         
         // Performance monitoring
@@ -204,32 +224,42 @@ void Cityscape::Update(float delta)
         ImGui::PlotLines("Render:", renderSamples.data(), renderSamples.size(), 0, (const char*)nullptr, 0.0f, 16.67f, {128.0f, 32.0f});
         ImGui::SameLine();
         ImGui::Text("%.2fms", lastRender * 1000);
+        ImGui::Text("GL Calls: %d issued, %d elided", Phi::GLState::GetIssuedCount(), Phi::GLState::GetElidedCount());
+        ImGui::Text("GPU Stalls: %d, %.2fms", Phi::FrameSync::GetStallCount(), Phi::FrameSync::GetStallTime());
+        ImGui::Text("Trace: %d events (%d dropped)", (int)Phi::Trace::GetEventCount(), (int)Phi::Trace::GetDroppedCount());
+        ImGui::SameLine();
+        if (ImGui::Button("Write Trace")) Phi::Trace::Write();
+        for (const Phi::JobSystem::JobStats& jobStats : Phi::JobSystem::GetStats())
+        {
+            ImGui::Text("Jobs (%s): %d, %.2fms (max %.2fms)", jobStats.name.c_str(), jobStats.count, jobStats.totalMs, jobStats.maxMs);
+        }
+        ImGui::Separator();
+
+        // Frame pipelining
+        // NOTE: Only read by App between frames, so it is safe to change from the simulation thread
+        ImGui::Checkbox("Pipelined Simulation", &pipelined);
+        ImGui::Checkbox("Fixed Timestep", &fixedSimulationRate);
+        ImGui::SliderInt("Simulation Rate", &simulationRate, 10, 240, "%d Hz", ImGuiSliderFlags_AlwaysClamp);
+        fixedTimestep = fixedSimulationRate ? 1.0f / simulationRate : 0.0f;
         ImGui::Separator();
 
         // Graphics settings
         ImGui::Text("Graphics Settings:");
-        if (ImGui::Checkbox("Fullscreen", &fullscreen))
-        {
-            GLFWwindow* window = GetWindow();
-            if (fullscreen)
-            {
-                // Get primary monitor and enable fullscreen
-                GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-                const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-                glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
-            }
-            else
-            {
-                // Get window monitor and revert to windowed mode
-                GLFWmonitor* monitor = glfwGetWindowMonitor(window);
-                const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-                glfwSetWindowMonitor(window, NULL, (mode->width - defaultWidth) / 2, (mode->height - defaultHeight) / 2, defaultWidth, defaultHeight, 0);
-            }
-        }
-        if (ImGui::Checkbox("Vsync", &vsync)) glfwSwapInterval(vsync);
-        ImGui::Checkbox("Shadows (experimental)", &shadows);
+        ImGui::Checkbox("Fullscreen", &settings.fullscreen);
+        ImGui::Checkbox("Vsync", &settings.vsync);
+        ImGui::Checkbox("Shadows", &settings.shadows);
+        ImGui::Checkbox("Static Building Geometry", &settings.staticGeometry);
+        ImGui::Checkbox("Parallel Batch Fill", &settings.parallelBatchFill);
+        ImGui::Checkbox("Frustum Culling", &settings.frustumCulling);
+        ImGui::Checkbox("Occlusion Culling", &settings.occlusionCulling);
+        ImGui::Checkbox("GL State Cache", &settings.glStateCache);
+        ImGui::Checkbox("Compact G-Buffer", &settings.compactGBuffer);
+        ImGui::Combo("Point Lights", (int*)&settings.lightPass, "Light Volumes\0Clustered (GPU Binning)\0Clustered (CPU Binning)\0");
+        ImGui::Checkbox("Building LODs", &buildingLODs);
+        ImGui::SliderFloat2("LOD Distances", lodDistances, 16.0f, 160.0f, "%.0f", ImGuiSliderFlags_AlwaysClamp);
         ImGui::SliderInt("View Distance", &renderDistance, 1, 10, "%d", ImGuiSliderFlags_AlwaysClamp);
-        if (ImGui::SliderFloat("FOV", &mainCamera.fov, 1.0f, 120.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp)) mainCamera.UpdateProjection();
+        ImGui::SliderInt("Block Uploads / Frame", &blockUploadBudget, 1, 16, "%d", ImGuiSliderFlags_AlwaysClamp);
+        if (ImGui::SliderFloat("FOV", &simCamera.fov, 1.0f, 120.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp)) simCamera.UpdateProjection();
 
         ImGui::End();
 
@@ -242,20 +272,13 @@ void Cityscape::Update(float delta)
         ImGui::Checkbox("Automatic Lights", &automaticLights);
         ImGui::Checkbox("Lights Override", &lightsAlwaysOn);
         if (ImGui::Checkbox("Party Mode", &partyMode)) lightsAlwaysOn = partyMode;
-        if (ImGui::Checkbox("Festive Colors", &festiveMode))
-        {
-            // Regenerate all light colors if mode is toggled
-            for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
-            {
-                pointLight.SetColor(RandomColor());
-            }
-        };
+        if (ImGui::Checkbox("Festive Colors", &festiveMode)) recolorRequested = true;
         ImGui::Separator();
 
         // Timing and weather controls
         ImGui::Checkbox("Time Advance", &timeAdvance);
-        if (ImGui::SliderFloat("Day Length", &sky.dayCycle, 1.0f, 120.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp)) sky.Update();
-        if (ImGui::SliderFloat("Time of Day", &sky.currentTime, 0.0f, sky.dayCycle, "%.2f", ImGuiSliderFlags_AlwaysClamp)) sky.Update();
+        ImGui::SliderFloat("Day Length", &dayCycle, 1.0f, 120.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+        if (ImGui::SliderFloat("Time of Day", &timeOfDay, 0.0f, dayCycle, "%.2f", ImGuiSliderFlags_AlwaysClamp)) previousState.timeOfDay = timeOfDay;
         ImGui::Separator();
 
         ImGui::Checkbox("Snow", &snow);
@@ -263,11 +286,142 @@ void Cityscape::Update(float delta)
         ImGui::SliderFloat("Accumulation", &snowAccumulation, 0.0f, maxAccumulation, "%.2f", ImGuiSliderFlags_AlwaysClamp);
         ImGui::Separator();
 
-        // Generation button
-        if (ImGui::Button("Regenerate")) Regenerate();
+        // Generation controls
+        if (ImGui::InputScalar("World Seed", ImGuiDataType_U64, &worldSeed, nullptr, nullptr, "%llu", ImGuiInputTextFlags_EnterReturnsTrue)) regenerateRequested = true;
+        if (ImGui::Button("Regenerate")) { worldSeed = rng.Next64(); regenerateRequested = true; }
 
         ImGui::End();
     }
+
+    // Pick up anything edited through the GUI
+    currentState = CaptureState();
+}
+
+// Hands the last simulated frame to the renderer
+// NOTE: The simulation is idle while this runs, so it is the only place both sides may be touched
+void Cityscape::Sync()
+{
+    PHI_TRACE_SCOPE("Sync");
+
+    // Blend the last two steps (the interpolation is always 1 without a fixed timestep)
+    float alpha = GetInterpolation();
+    renderState = currentState;
+    renderState.cameraPosition = glm::mix(previousState.cameraPosition, currentState.cameraPosition, alpha);
+    renderState.cameraYaw = glm::mix(previousState.cameraYaw, currentState.cameraYaw, alpha);
+    renderState.cameraPitch = glm::mix(previousState.cameraPitch, currentState.cameraPitch, alpha);
+    renderState.snowAccumulation = glm::mix(previousState.snowAccumulation, currentState.snowAccumulation, alpha);
+
+    // Time of day may have wrapped around between the two steps
+    float previousTime = previousState.timeOfDay;
+    if (previousTime - currentState.timeOfDay > currentState.dayCycle / 2.0f) previousTime -= currentState.dayCycle;
+    renderState.timeOfDay = glm::mix(previousTime, currentState.timeOfDay, alpha);
+    if (renderState.timeOfDay < 0.0f) renderState.timeOfDay += currentState.dayCycle;
+
+    // Move the render camera
+    mainCamera.SetPosition(renderState.cameraPosition);
+    mainCamera.SetRotation(renderState.cameraYaw, renderState.cameraPitch);
+    if (mainCamera.fov != renderState.fov)
+    {
+        mainCamera.fov = renderState.fov;
+        mainCamera.UpdateProjection();
+    }
+
+    // Update the cameras' viewport if the window size has changed
+    if (wWidth != mainCamera.GetWidth() || wHeight != mainCamera.GetHeight())
+    {
+        mainCamera.UpdateViewport(wWidth, wHeight);
+        simCamera.UpdateViewport(wWidth, wHeight);
+    }
+
+    // Move the sun and moon
+    sky.dayCycle = renderState.dayCycle;
+    sky.currentTime = renderState.timeOfDay;
+    sky.Update();
+
+    ApplySettings();
+
+    // Update loaded blocks
+    // NOTE: Done here since inserting blocks creates GPU resources, generating them already happens on the workers
+    if (regenerateRequested)
+    {
+        regenerateRequested = false;
+        Regenerate();
+    }
+    UpdateBlocks();
+    UpdateLights();
+
+    // Publish the last frame's statistics to the GUI
+    stats = renderStats;
+    stats.shadowCascadeCount = renderSettings.shadows ? shadowCascades.GetRenderCount() : 0;
+    stats.occluderTriangleCount = occlusionBuffer.GetTriangleCount();
+    stats.geometryPoolSize = Building::GetGeometryPoolSize();
+    stats.gBufferSize = GetGBufferSize();
+    if (PointLightPool* pool = PointLight::GetPool())
+    {
+        stats.lightPoolCount = pool->GetCount();
+        stats.lightPoolCapacity = pool->GetCapacity();
+        stats.lightUploadSize = pool->GetLastUploadSize();
+    }
+}
+
+// Captures the simulation state Render() depends on
+Cityscape::FrameState Cityscape::CaptureState() const
+{
+    FrameState state;
+    state.cameraPosition = simCamera.GetPosition();
+    state.cameraYaw = simCamera.GetYaw();
+    state.cameraPitch = simCamera.GetPitch();
+    state.fov = simCamera.fov;
+    state.timeOfDay = timeOfDay;
+    state.dayCycle = dayCycle;
+    state.frameTime = lastFrameTime;
+    state.snowAccumulation = snowAccumulation;
+    state.snowIntensity = snowIntensity;
+    state.snow = snow;
+    state.lightsOn = lightsAlwaysOn || (automaticLights && IsNight());
+    state.bulbsOn = lightsAlwaysOn || IsNight();
+    return state;
+}
+
+// Applies the graphics settings edited through the GUI since the last frame
+void Cityscape::ApplySettings()
+{
+    GraphicsSettings previous = renderSettings;
+    renderSettings = settings;
+
+    if (renderSettings.fullscreen != previous.fullscreen)
+    {
+        GLFWwindow* window = GetWindow();
+        if (renderSettings.fullscreen)
+        {
+            // Get primary monitor and enable fullscreen
+            GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+            glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+        }
+        else
+        {
+            // Get window monitor and revert to windowed mode
+            GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+            const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+            glfwSetWindowMonitor(window, NULL, (mode->width - defaultWidth) / 2, (mode->height - defaultHeight) / 2, defaultWidth, defaultHeight, 0);
+        }
+    }
+    if (renderSettings.vsync != previous.vsync) glfwSwapInterval(renderSettings.vsync);
+
+    Building::staticGeometry = renderSettings.staticGeometry;
+    Building::parallelBatchFill = renderSettings.parallelBatchFill;
+
+    // Loaded buildings only hold the data for the mode they were created in
+    if (renderSettings.staticGeometry != previous.staticGeometry) regenerateRequested = true;
+    Phi::GLState::enabled = renderSettings.glStateCache;
+
+    // Recreate the Geometry Buffer if the app's window was resized or the layout changed
+    if (windowResized || renderSettings.compactGBuffer != previous.compactGBuffer)
+    {
+        RecreateFBO();
+        windowResized = false;
+    }
 }
 
 void Cityscape::Render()
@@ -275,95 +429,117 @@ void Cityscape::Render()
     // Update the camera's UBO so all shaders have access to the new values
     mainCamera.UpdateUBO();
 
-    // Generate a vector of all currently loaded blocks and their offsets
+    // Gather the bounds and render data of every loaded block
+    GatherBlocks();
+
+    // Cull blocks and their light volumes against the camera
+    Phi::Frustum cameraFrustum = mainCamera.GetFrustum();
+    renderStats.loadedBlockCount = (int)loadedBlocks.Size();
+    renderStats.visibleBlockCount = CullBlocks(cameraFrustum, blockBounds, blockVisible);
+    CullBlocks(cameraFrustum, lightBounds, lightVisible);
+
+    // Then hide blocks and light volumes that are behind the nearest buildings
+    OcclusionCullBlocks();
+
+    // Generate a vector of all visible blocks' offsets
     static std::vector<glm::vec4> blockPositions;
     blockPositions.clear();
-    for (auto &&[entity, ground]: registry.view<GroundTile>().each())
+    for (size_t i = 0; i < loadedBlocks.Size(); i++)
     {
-        blockPositions.push_back(ground.GetPosition());
+        if (blockVisible[i]) blockPositions.push_back(loadedBlocks.positions[i]);
     }
 
     // PASS 1: SHADOW MAP
 
-    // Bind the geometry buffer
-    gBuffer->Bind();
-
-    // Clear the previous depth buffer, ALWAYS
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
-    gBuffer->AttachTexture(shadowDepthTex, GL_DEPTH_ATTACHMENT);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    if (shadows)
+    renderStats.shadowBlockCount = 0;
+    if (renderSettings.shadows)
     {
-        // Update to shadow map viewport dimensions
-        glViewport(0, 0, shadowDepthTex->GetWidth(), shadowDepthTex->GetHeight());
-        glCullFace(GL_FRONT);
-
-        // Calculate global light position
+        // Re-render only the cascades whose cached depth is out of date
         glm::vec3 globalLightPos = sky.IsNight() ? glm::vec3(sky.GetMoon().GetPosition()) : glm::vec3(sky.GetSun().GetPosition());
+        shadowCascades.Update(globalLightPos, mainCamera.GetPosition());
 
-        // Update light space matrix
-        static glm::mat4 lightProj = glm::ortho(-32.0f, 32.0f, -32.0f, 32.0f, 300.0f, 1024.0f);
-        glm::vec3 offset = glm::vec3(mainCamera.GetPosition().x, 0.0f, mainCamera.GetPosition().z);
-        glm::mat4 lightView = glm::lookAt(globalLightPos + offset, offset, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 lightViewProj = lightProj * lightView;
-        
-        // Write to the UBO
-        lightSpaceUBO->Sync();
-        lightSpaceUBO->Write(lightViewProj);
+        int cascadeMask = shadowCascades.GetCascadesToRender();
+        if (cascadeMask) Phi::GLState::CullFace(GL_FRONT);
 
-        // Draw buildings in shadow pass
-        for (auto &&[entity, building]: registry.view<Building>().each())
+        for (int cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
         {
-            building.Draw(shadowPassShader);
-        }
-        Building::FlushDrawCalls(shadowPassShader);
+            if (!(cascadeMask & (1 << cascade))) continue;
+
+            const glm::mat4& lightViewProj = shadowCascades.GetPendingViewProj(cascade);
+            shadowCascades.BeginCascade(cascade);
+            shadowPassShader.Use();
+            shadowPassShader.SetUniform(shadowViewProjUniform, lightViewProj);
+            shadowPassInstanceShader.Use();
+            shadowPassInstanceShader.SetUniform(shadowInstanceViewProjUniform, lightViewProj);
+
+            // Only blocks inside the cascade's volume can cast shadows into it
+            // NOTE: Each cascade uses a fixed building LOD so camera LOD changes never invalidate the cache
+            renderStats.shadowBlockCount += CullBlocks(Phi::Frustum(lightViewProj), blockBounds, shadowVisible);
+            int lod = std::min(cascade, Building::NUM_LODS - 1);
+
+            // Draw buildings in shadow pass
+            static std::vector<glm::vec4> shadowBlockPositions;
+            shadowBlockPositions.clear();
+            for (size_t i = 0; i < loadedBlocks.Size(); i++)
+            {
+                if (!shadowVisible[i]) continue;
+                DrawBuildings(i, shadowPassShader, lod);
+                shadowBlockPositions.push_back(loadedBlocks.positions[i]);
+            }
+            Building::FlushDrawCalls(shadowPassShader);
+
+            // Draw streetlights in shadow pass
+            streetLightModel->DrawInstances(shadowPassInstanceShader, shadowBlockPositions);
 
-        // Draw streetlights in shadow pass
-        streetLightModel->DrawInstances(shadowPassInstanceShader, blockPositions);
+            shadowCascades.EndCascade(cascade);
+        }
+    }
+    else
+    {
+        // Blocks may load / unload while shadows are off, start from scratch when they are turned back on
+        shadowCascades.InvalidateAll();
     }
     
     // PASS 2: GEOMETRY
 
-    // Reattach the gbuffer's depth / stencil texture
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
-    gBuffer->AttachTexture(gDepthStencilTex, GL_DEPTH_STENCIL_ATTACHMENT);
+    gBuffer->Bind();
 
     // Clear buffers and resize viewport
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glViewport(0, 0, wWidth, wHeight);
-    glCullFace(GL_BACK);
+    Phi::GLState::CullFace(GL_BACK);
 
     // Draw snow effect
-    if (snow)
+    if (renderState.snow)
     {
         // Snow particles
         snowEffectShader.Use();
-        snowEffectShader.SetUniform("deltaTimeWind", glm::vec3(lastFrameTime, programLifetime, snowIntensity));
+        snowEffectShader.SetUniform(deltaTimeWindUniform, glm::vec3(renderState.frameTime, programLifetime, renderState.snowIntensity));
         snowVAO.Bind();
         snowBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, 1);
         glDrawArrays(GL_POINTS, 0, SNOWFLAKE_COUNT);
         snowVAO.Unbind();
     }
 
-    // Draw ground tiles
-    for (auto &&[entity, ground]: registry.view<GroundTile>().each())
+    // Draw ground tiles and buildings of visible blocks
+    renderStats.buildingDrawCount = 0;
+    std::fill(std::begin(renderStats.buildingLODCounts), std::end(renderStats.buildingLODCounts), 0);
+    for (size_t i = 0; i < loadedBlocks.Size(); i++)
     {
-        ground.Draw();
-    }
-    GroundTile::FlushDrawCalls();
+        if (!blockVisible[i]) continue;
 
-    // Then draw all buildings
-    buildingDrawCount = 0;
-    for (auto &&[entity, building]: registry.view<Building>().each())
-    {
-        building.Draw(buildingShader);
-        buildingDrawCount++;
+        int lod = loadedBlocks.lods[i];
+        DrawBuildings(i, buildingShader, lod);
+        renderStats.buildingDrawCount += loadedBlocks.buildings[i].count;
+        renderStats.buildingLODCounts[lod] += loadedBlocks.buildings[i].count;
+
+        GroundTile::Draw(loadedBlocks.positions[i]);
     }
+    GroundTile::FlushDrawCalls();
     Building::FlushDrawCalls(buildingShader);
     
     // Draw all street lights
-    if (sky.IsNight() || lightsAlwaysOn)
+    if (renderState.bulbsOn)
     {
         // Draw the bulbs with the light source shader when lights are on
         streetLightModel->GetMesh(0).DrawInstances(streetLightShader, blockPositions);
@@ -377,18 +553,21 @@ void Cityscape::Render()
 
     // Draw the snow accumulation
     snowbankShader.Use();
-    snowbankShader.SetUniform("accumulationHeight", snowAccumulation);
+    snowbankShader.SetUniform(accumulationHeightUniform, renderState.snowAccumulation);
     snowbankModel->DrawInstances(snowbankShader, blockPositions);
 
     // PASS 3: GLOBAL LIGHTING
 
     // First bind all gBuffer textures appropriately
-    gPositionTex->Bind(0);
+    // NOTE: The compact layout reads depth instead of positions
+    if (gPositionTex) gPositionTex->Bind(0);
     gNormalTex->Bind(1);
     gColorSpecTex->Bind(2);
+    if (renderSettings.compactGBuffer) gDepthStencilTex->Bind(4);
 
-    // Also bind the shadow map texture we wrote to in pass 1
-    if (shadows) shadowDepthTex->Bind(3);
+    // Also bind the shadow atlas we wrote to in pass 1 (or in an earlier frame, if it was cached)
+    shadowCascades.UpdateUBO(renderSettings.shadows);
+    shadowCascades.GetTexture().Bind(3);
     
     // Use the global lighting shader
     globalLightShader.Use();
@@ -399,45 +578,52 @@ void Cityscape::Render()
     glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glDepthMask(GL_FALSE);
-    glDepthFunc(GL_ALWAYS);
+    Phi::GLState::DepthMask(GL_FALSE);
+    Phi::GLState::DepthFunc(GL_ALWAYS);
 
     // Draw a fullscreen triangle to calculate global lighting on every pixel in the scene
-    glBindVertexArray(dummyVAO);
+    Phi::GLState::BindVertexArray(dummyVAO);
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
-
-    // Lock the light space buffer as it's only used by the above commands
-    lightSpaceUBO->Lock();
-    lightSpaceUBO->SwapSections();
 
     // PASS 4: POINT LIGHTS
 
-    glEnable(GL_BLEND);
+    // Copy any light data changed since last frame into the light pool
+    PointLight::UploadChanges();
+
+    Phi::GLState::Enable(GL_BLEND);
 
-    // Draw each point light
-    lightDrawCount = 0;
-    for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
+    // Gather each point light whose volume may touch the view
+    renderStats.lightDrawCount = 0;
+    bool clustered = renderSettings.lightPass != LightPass::Volumes;
+    if (clustered) clusteredLighting->Begin();
+    const PointLightPool* lightPool = PointLight::GetPool();
+    for (size_t i = 0; i < loadedBlocks.Size(); i++)
     {
-        if (pointLight.IsOn())
+        if (!lightVisible[i]) continue;
+
+        const LoadedBlocks::Range& lights = loadedBlocks.lights[i];
+        for (int j = lights.first; j < lights.first + lights.count; j++)
         {
-            pointLight.Draw();
-            lightDrawCount++;
+            int poolIndex = loadedBlocks.lightIndices[j];
+            if (!lightPool->IsOn(poolIndex)) continue;
+            if (clustered) clusteredLighting->AddLight(poolIndex);
+            else PointLight::Draw(poolIndex);
+            renderStats.lightDrawCount++;
         }
     }
-    PointLight::FlushDrawCalls();
 
-    glDisable(GL_BLEND);
-    glDepthFunc(GL_LESS);
+    // Shade with either one volume per light or a single clustered fullscreen pass
+    if (clustered) clusteredLighting->Draw(mainCamera, renderSettings.lightPass == LightPass::ClusteredCPU);
+    else PointLight::FlushDrawCalls();
+
+    Phi::GLState::Disable(GL_BLEND);
+    Phi::GLState::DepthFunc(GL_LESS);
 
     // Draw sky
     sky.Draw();
 
     // Re-enable writing into the depth buffer after all lights have been drawn
-    glDepthMask(GL_TRUE);
-
-    // Lock the camera buffer
-    mainCamera.GetUBO().Lock();
+    Phi::GLState::DepthMask(GL_TRUE);
 }
 
 // Handles all input for this demo
@@ -451,22 +637,22 @@ void Cityscape::ProcessInput(float delta)
         glm::vec2 mouseOffset = (mousePos - prevMousePos) * mouseSensitivity;
 
         // Rotate the camera according to mouse movement
-        mainCamera.Rotate(mouseOffset.x, -mouseOffset.y);
+        simCamera.Rotate(mouseOffset.x, -mouseOffset.y);
 
         // Boost if shift is held
         float boost = IsKeyDown(GLFW_KEY_LEFT_SHIFT) ? 4 : 1;
 
         // Move the camera according to WASD
-        if (IsKeyDown(GLFW_KEY_W)) mainCamera.Translate(mainCamera.GetDirection() * delta * cameraSpeed * boost);
-        if (IsKeyDown(GLFW_KEY_S)) mainCamera.Translate(-mainCamera.GetDirection() * delta * cameraSpeed * boost);
-        if (IsKeyDown(GLFW_KEY_A)) mainCamera.Translate(-mainCamera.GetRight() * delta * cameraSpeed * boost);
-        if (IsKeyDown(GLFW_KEY_D)) mainCamera.Translate(mainCamera.GetRight() * delta * cameraSpeed * boost);
+        if (IsKeyDown(GLFW_KEY_W)) simCamera.Translate(simCamera.GetDirection() * delta * cameraSpeed * boost);
+        if (IsKeyDown(GLFW_KEY_S)) simCamera.Translate(-simCamera.GetDirection() * delta * cameraSpeed * boost);
+        if (IsKeyDown(GLFW_KEY_A)) simCamera.Translate(-simCamera.GetRight() * delta * cameraSpeed * boost);
+        if (IsKeyDown(GLFW_KEY_D)) simCamera.Translate(simCamera.GetRight() * delta * cameraSpeed * boost);
 
-        // Unload blocks and regenerate if we press R
-        if (IsKeyJustDown(GLFW_KEY_R)) Regenerate();
+        // Unload blocks and regenerate a new city if we press R
+        if (IsKeyJustDown(GLFW_KEY_R)) { worldSeed = rng.Next64(); regenerateRequested = true; }
 
         // Zoom the camera according to scroll
-        mainCamera.Zoom(GetMouseScroll().y);
+        simCamera.Zoom(GetMouseScroll().y);
 
         // Keep track of previous mouse position
         prevMousePos = mousePos;
@@ -478,10 +664,10 @@ void Cityscape::ProcessInput(float delta)
         paused = !paused;
 
         // Capture / uncapture mouse
-        if (paused) glfwSetInputMode(GetWindow(), GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        if (paused) SetCursorMode(GLFW_CURSOR_NORMAL);
         else 
         {
-            glfwSetInputMode(GetWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            SetCursorMode(GLFW_CURSOR_DISABLED);
             prevMousePos = GetMousePos();
         }
     }
@@ -491,219 +677,295 @@ void Cityscape::ProcessInput(float delta)
 // a grid of city blocks around the camera
 void Cityscape::Regenerate()
 {
+    PHI_TRACE_SCOPE("Regenerate");
+
     // Delete all loaded blocks
-    for (const auto&[id, entityList] : cityBlocks)
-    {
-        DeleteBlock(id);
-    }
-    cityBlocks.clear();
+    blockGrid.Clear([this](BlockGrid::Slot& slot) { DeleteBlock(slot); });
+
+    // Discard any blocks still being generated for the old city
+    blockEpoch++;
+    blockGenerator.CancelPending();
 
     // Generate a grid of city blocks around the camera
-    glm::ivec3 pos = mainCamera.GetPosition() / (float)BLOCK_SIZE;
-    for (int x = pos.x - renderDistance; x < pos.x + renderDistance; x++)
+    UpdateBlocks();
+
+    // Wait for the workers so the whole grid appears at once
+    // The upload budget is ignored here since we're stalling anyway
+    std::vector<BlockData> finishedBlocks;
     {
-        for (int z = pos.z - renderDistance; z < pos.z + renderDistance; z++)
-        {
-            GenerateBlock({x, z});
-        }
+        PHI_TRACE_SCOPE("Wait For Blocks");
+        blockGenerator.WaitIdle();
+    }
+    blockGenerator.Collect(finishedBlocks, INT_MAX);
+    for (BlockData& block : finishedBlocks)
+    {
+        BlockGrid::Slot* slot = blockGrid.Find(block.id);
+        if (slot && block.epoch == blockEpoch) InsertBlock(*slot, block);
     }
-
-    // Clear queues
-    generationQueue.clear();
-    deletionQueue.clear();
 }
 
 // Updates the blocks that should be loaded / deleted
 void Cityscape::UpdateBlocks()
 {
-    // Update which chunks should be loaded
-    static std::vector<glm::ivec2> shouldBeLoaded;
-    shouldBeLoaded.clear();
-
-    // Calculate which chunks should be loaded given the camera's position
-    glm::ivec3 pos = mainCamera.GetPosition() / (float)BLOCK_SIZE;
-    for (int x = pos.x - renderDistance; x < pos.x + renderDistance; ++x)
+    // Move the grid window with the camera
+    // Blocks are only loaded / deleted when the camera crosses a block boundary or the view distance changes
+    glm::ivec2 pos = glm::floor(glm::vec2(mainCamera.GetPosition().x, mainCamera.GetPosition().z) / (float)BLOCK_SIZE);
+    blockGrid.Update(pos - renderDistance, renderDistance * 2,
+                     [this](BlockGrid::Slot& slot) { DeleteBlock(slot); },
+                     [this](BlockGrid::Slot& slot) { GenerateBlock(slot); });
+
+    // Insert finished blocks, up to the upload budget per frame
+    // Generation itself happens on the workers, so this only has to create entities and GPU resources
+    static std::vector<BlockData> finishedBlocks;
+    finishedBlocks.clear();
+    blockGenerator.Collect(finishedBlocks, blockUploadBudget);
+    for (BlockData& block : finishedBlocks)
     {
-        for (int z = pos.z - renderDistance; z < pos.z + renderDistance; ++z)
-        {
-            shouldBeLoaded.push_back(glm::ivec2(x, z));
-        }
-    }
+        // Discard blocks generated before the last regeneration
+        if (block.epoch != blockEpoch) continue;
 
-    // Ensure all chunks are added to generation queue if necessary
-    for (const auto& id : shouldBeLoaded)
-    {
-        if (cityBlocks.count(id) == 0)
-        {
-            if (std::find(generationQueue.begin(), generationQueue.end(), id) == generationQueue.end())
-            {
-                generationQueue.push_back(id);
-            }
-        }
+        // Discard blocks that went out of range (or were already replaced) while they were being generated
+        BlockGrid::Slot* slot = blockGrid.Find(block.id);
+        if (!slot || slot->state != BlockGrid::SlotState::Generating) continue;
+
+        InsertBlock(*slot, block);
     }
 
-    // Ensure any unnecessary chunks are deleted ASAP
-    for (const auto&[id, entityList] : cityBlocks)
+    UpdateLODs();
+}
+
+// Picks a building level of detail for every loaded block from its distance to the camera
+// A block only switches once it is LOD_HYSTERESIS past a boundary, so it can't flicker between levels
+void Cityscape::UpdateLODs()
+{
+    glm::vec2 cameraPos = {mainCamera.GetPosition().x, mainCamera.GetPosition().z};
+
+    for (BlockGrid::Slot& slot : blockGrid.GetSlots())
     {
-        if (std::find(shouldBeLoaded.begin(), shouldBeLoaded.end(), id) == shouldBeLoaded.end())
+        if (slot.state != BlockGrid::SlotState::Loaded) continue;
+
+        if (!buildingLODs)
         {
-            deletionQueue.push_back(id);
+            slot.lod = 0;
+            continue;
         }
-    }
 
-    // Delete all blocks from deletion queue once per frame
-    for (const auto& id : deletionQueue)
-    {
-        DeleteBlock(id);
-        cityBlocks.erase(id);
-    }
-    deletionQueue.clear();
+        glm::vec2 center = (glm::vec2(slot.min.x, slot.min.z) + glm::vec2(slot.max.x, slot.max.z)) * 0.5f;
+        float distance = glm::distance(cameraPos, center);
 
-    // Generate a max of one chunk per frame from the generation queue
-    // This helps reduce the impact of any generation stutter on lower end systems when moving around
-    if (!generationQueue.empty())
-    {
-        GenerateBlock(generationQueue.front());
-        generationQueue.pop_front();
+        // Step towards coarser levels, then back towards finer ones
+        while (slot.lod < Building::NUM_LODS - 1 && distance > lodDistances[slot.lod] + LOD_HYSTERESIS) slot.lod++;
+        while (slot.lod > 0 && distance < lodDistances[slot.lod - 1] - LOD_HYSTERESIS) slot.lod--;
     }
 }
 
 // Updates all of the loaded lights in the city
 void Cityscape::UpdateLights()
 {
-    // Update automatic lights unless we want them always on
-    if (!lightsAlwaysOn && automaticLights)
-    {
-        if (sky.IsNight())
-        {
-            // Turn on lights at night
-            for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
-            {
-                if (!pointLight.IsOn()) pointLight.TurnOn();
-            }
-        }
-        else
-        {
-            // Turn off lights during the day
-            for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
-            {
-                if (pointLight.IsOn()) pointLight.TurnOff();
-            }
-        }
-    }
-    else
-    {
-        // Ensure all loaded lights are in correct state
-        for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
-        {
-            if (lightsAlwaysOn) pointLight.TurnOn();
-            else pointLight.TurnOff();
-        }
-    }
+    // Lights are on at night (if automatic), or always with the override
+    // NOTE: Only flips the pool's on / off bitmask when the state actually changes
+    PointLight::SetAllOn(renderState.lightsOn);
 
-    // Update light colors
-    if (partyMode)
+    // Party mode's timer fired, or festive colors were toggled
+    // NOTE: Uses the same per-light streams as generation, so regenerated blocks keep matching
+    if (recolorRequested)
     {
-        static float lightTimeAccum = 0;
-        lightTimeAccum += lastFrameTime;
-        if (lightTimeAccum >= lightTimer)
+        for (BlockGrid::Slot& slot : blockGrid.GetSlots())
         {
-            for (auto &&[entity, pointLight] : registry.view<PointLight>().each())
+            if (slot.state != BlockGrid::SlotState::Loaded) continue;
+
+            PointLightGroup& lights = registry.get<PointLightGroup>(slot.entity);
+            for (int i = 0; i < lights.GetCount(); i++)
             {
-                pointLight.SetColor(RandomColor());
+                lights[i].SetColor(BlockGenerator::LightColor(worldSeed, slot.id, i, festiveMode, lightColorCycle));
             }
-            lightTimeAccum = 0.0f;
         }
+        recolorRequested = false;
     }
 }
 
-// Generates a city block by id
-// Deletes and regenerates if one already exists with the given ID
-void Cityscape::GenerateBlock(const glm::ivec2& id)
+// Queues a city block for generation on the worker threads
+// The block is inserted into the scene by InsertBlock() once it has finished
+void Cityscape::GenerateBlock(BlockGrid::Slot& slot)
+{
+    slot.state = BlockGrid::SlotState::Generating;
+    blockGenerator.Submit(slot.id, worldSeed, festiveMode, lightColorCycle, blockEpoch);
+}
+
+// Inserts a generated city block into the registry
+// Deletes and replaces the slot's contents if it is already loaded
+void Cityscape::InsertBlock(BlockGrid::Slot& slot, BlockData& block)
 {
+    PHI_TRACE_SCOPE("Insert Block");
+
+    const glm::ivec2& id = block.id;
+
     // Delete if already generated
-    if (cityBlocks.count(id) > 0) DeleteBlock(id);
+    if (slot.state == BlockGrid::SlotState::Loaded) DeleteBlock(slot);
 
-    // Create a ground tile component
-    entt::entity temp = registry.create();
-    registry.emplace<GroundTile>(temp, id);
+    // Bounds cover the ground tile up to the tallest building
+    slot.id = id;
+    slot.state = BlockGrid::SlotState::Loaded;
+    slot.min = glm::vec3(id.x * BLOCK_SIZE, 0.0f, id.y * BLOCK_SIZE);
+    slot.max = glm::vec3((id.x + 1) * BLOCK_SIZE, block.height, (id.y + 1) * BLOCK_SIZE);
+    slot.occluders.swap(block.occluders);
+    shadowCascades.Invalidate(slot.min, slot.max);
 
-    // Retrieve the block position
-    glm::vec3 blockPos = registry.get<GroundTile>(temp).GetPosition();
+    // Every component of the block lives on a single entity
+    slot.entity = registry.create();
 
-    // Register the entity with the block
-    cityBlocks[id].push_back(temp);
+    // Create a ground tile component
+    registry.emplace<GroundTile>(slot.entity, id);
 
     // Create point lights for each street lamp
-    temp = registry.create();
-    registry.emplace<PointLight>(temp, glm::vec4{blockPos + glm::vec3(8.0f, 1.7f, 1.65f), 8.0f}, RandomColor());
-    cityBlocks[id].push_back(temp);
-
-    temp = registry.create();
-    registry.emplace<PointLight>(temp, glm::vec4{blockPos + glm::vec3(1.65f, 1.7f, 8.0f), 8.0f}, RandomColor());
-    cityBlocks[id].push_back(temp);
+    PointLightGroup& lights = registry.emplace<PointLightGroup>(slot.entity, (int)block.lights.size());
+    for (int i = 0; i < lights.GetCount(); i++)
+    {
+        lights[i].SetPosition(block.lights[i].pos);
+        lights[i].SetColor(block.lights[i].color);
+    }
 
-    temp = registry.create();
-    registry.emplace<PointLight>(temp, glm::vec4{blockPos + glm::vec3(14.35f, 1.7f, 8.0f), 8.0f}, RandomColor());
-    cityBlocks[id].push_back(temp);
+    // Take ownership of each generated building mesh
+    Building::Group& buildings = registry.emplace<Building::Group>(slot.entity);
+    buildings.Reserve((int)block.buildings.size());
+    for (BlockData::BuildingData& building : block.buildings)
+    {
+        buildings.Add(std::move(building.meshes));
+    }
+}
 
-    temp = registry.create();
-    registry.emplace<PointLight>(temp, glm::vec4{blockPos + glm::vec3(8.0f, 1.7f, 14.35f), 8.0f}, RandomColor());
-    cityBlocks[id].push_back(temp);
+// Unloads a city block, leaving its slot empty
+// If the block is still being generated, its result will be discarded when it finishes
+void Cityscape::DeleteBlock(BlockGrid::Slot& slot)
+{
+    // Cached shadows may contain the block's buildings
+    if (slot.state == BlockGrid::SlotState::Loaded) shadowCascades.Invalidate(slot.min, slot.max);
+
+    // Destroy the block's entity, releasing all of its components at once
+    if (slot.entity != entt::null) registry.destroy(slot.entity);
+    slot.entity = entt::null;
+    slot.occluders.clear();
+    slot.state = BlockGrid::SlotState::Empty;
+    slot.lod = 0;
+}
 
-    // Generate buildings for each quadrant
-    for (int i = 0; i < 4; i++)
+// Copies the bounds and render data of every loaded block into loadedBlocks, blockBounds and lightBounds
+void Cityscape::GatherBlocks()
+{
+    loadedBlocks.Clear();
+    blockBounds.Clear();
+    lightBounds.Clear();
+    for (const BlockGrid::Slot& block : blockGrid.GetSlots())
     {
-        // Decide whether to place 3 small buildings or one large building
-        if (boolDist(rng))
+        if (block.state != BlockGrid::SlotState::Loaded) continue;
+
+        auto [ground, buildings, lights] = registry.get<GroundTile, Building::Group, PointLightGroup>(block.entity);
+        loadedBlocks.entities.push_back(block.entity);
+        loadedBlocks.lods.push_back(block.lod);
+        loadedBlocks.positions.push_back(ground.GetPosition());
+
+        // Every building has one allocation per LOD, so a single range covers all of them
+        loadedBlocks.buildings.push_back({(int)loadedBlocks.buildingAllocations[0].size(), buildings.GetCount()});
+        if (Building::staticGeometry)
         {
-            temp = registry.create();
-            registry.emplace<Building>(temp, blockPos + smallBuildingOffsets[3 * i], storyDist(rng), 2,
-                                       variantDist(rng), smallBuildingOrientations[3 * i]);
-            cityBlocks[id].push_back(temp);
-
-            temp = registry.create();
-            registry.emplace<Building>(temp, blockPos + smallBuildingOffsets[3 * i + 1], storyDist(rng), 2,
-                                       variantDist(rng), smallBuildingOrientations[3 * i + 1]);
-            cityBlocks[id].push_back(temp);
-
-            temp = registry.create();
-            registry.emplace<Building>(temp, blockPos + smallBuildingOffsets[3 * i + 2], storyDist(rng), 2,
-                                       variantDist(rng), smallBuildingOrientations[3 * i + 2]);
-            cityBlocks[id].push_back(temp);
+            for (int lod = 0; lod < Building::NUM_LODS; lod++)
+            {
+                const std::vector<Building::Allocation>& allocations = buildings.GetAllocations(lod);
+                loadedBlocks.buildingAllocations[lod].insert(loadedBlocks.buildingAllocations[lod].end(), allocations.begin(), allocations.end());
+            }
         }
-        else
+
+        loadedBlocks.lights.push_back({(int)loadedBlocks.lightIndices.size(), lights.GetCount()});
+        for (const PointLight& light : lights)
         {
-            temp = registry.create();
-            registry.emplace<Building>(temp, blockPos + largeBuildingOffsets[i], storyDist(rng), 4,
-                                       variantDist(rng), largeBuildingOrientations[i]);
-            cityBlocks[id].push_back(temp);
+            loadedBlocks.lightIndices.push_back(light.GetIndex());
         }
+
+        loadedBlocks.occluders.push_back({(int)loadedBlocks.occluderBoxes.size(), (int)block.occluders.size()});
+        loadedBlocks.occluderBoxes.insert(loadedBlocks.occluderBoxes.end(), block.occluders.begin(), block.occluders.end());
+
+        blockBounds.Add(block.min, block.max);
+        lightBounds.Add(block.min - BlockGenerator::STREET_LIGHT_RADIUS, block.max + BlockGenerator::STREET_LIGHT_RADIUS);
+    }
+}
+
+// Draws the buildings of loadedBlocks[block]
+// Static geometry draws straight from the gathered allocations, streaming needs the group's meshes
+void Cityscape::DrawBuildings(size_t block, const Phi::Shader& shader, int lod)
+{
+    if (Building::staticGeometry)
+    {
+        const LoadedBlocks::Range& buildings = loadedBlocks.buildings[block];
+        Building::DrawStatic(loadedBlocks.buildingAllocations[lod].data() + buildings.first, buildings.count);
+        return;
     }
+
+    registry.get<Building::Group>(loadedBlocks.entities[block]).Draw(shader, lod);
 }
 
-// Unloads and deletes a city block by id
-void Cityscape::DeleteBlock(const glm::ivec2& id)
+// Culls the bounds of all loaded blocks against frustum, returns the number of visible blocks
+// If frustum culling is disabled, every block is marked visible
+int Cityscape::CullBlocks(const Phi::Frustum& frustum, const Phi::AABBList& bounds, std::vector<uint8_t>& visible)
 {
-    // Destroy all entites associated with the block
-    for (entt::entity entity : cityBlocks[id])
+    if (!renderSettings.frustumCulling)
     {
-        registry.destroy(entity);
+        visible.assign(bounds.Size(), 1);
+        return (int)bounds.Size();
     }
+
+    return frustum.Cull(bounds, visible);
 }
 
-// Generates the next random color to be used for a street light
-glm::vec4 Cityscape::RandomColor() const
+// Draws the buildings of the nearest visible blocks into the occlusion buffer,
+// then removes blocks and light volumes that are completely hidden behind them
+void Cityscape::OcclusionCullBlocks()
 {
-    static std::uniform_real_distribution<float> colorDist{0.2f, 1.0f};
+    renderStats.occludedBlockCount = 0;
+    renderStats.occludedLightCount = 0;
+    if (!renderSettings.occlusionCulling) return;
+
+    const glm::vec3& cameraPos = mainCamera.GetPosition();
+    occlusionBuffer.Begin(mainCamera.GetViewProj());
 
-    if (festiveMode)
+    // Add occluders from nearby visible blocks
+    for (size_t i = 0; i < loadedBlocks.Size(); i++)
     {
-        return boolDist(rng) ? glm::vec4{1.0f, 0.0f, 0.0f, 1.0f} : glm::vec4{0.0f, 1.0f, 0.0f, 1.0f};
+        if (!blockVisible[i]) continue;
+
+        glm::vec3 blockMin = {blockBounds.minX[i], blockBounds.minY[i], blockBounds.minZ[i]};
+        glm::vec3 blockMax = {blockBounds.maxX[i], blockBounds.maxY[i], blockBounds.maxZ[i]};
+        glm::vec3 closest = glm::clamp(cameraPos, blockMin, blockMax);
+        if (glm::distance(closest, cameraPos) > OCCLUDER_DISTANCE) continue;
+
+        const LoadedBlocks::Range& occluders = loadedBlocks.occluders[i];
+        for (int j = occluders.first; j < occluders.first + occluders.count; j++)
+        {
+            const Phi::AABB& occluder = loadedBlocks.occluderBoxes[j];
+            // Skip the building the camera is inside of, it would hide everything
+            if (glm::all(glm::greaterThanEqual(cameraPos, occluder.min)) && glm::all(glm::lessThanEqual(cameraPos, occluder.max))) continue;
+            occlusionBuffer.AddOccluder(occluder);
+        }
     }
-    else
+
+    occlusionBuffer.Rasterize();
+
+    // Test the remaining blocks and light volumes
+    for (size_t i = 0; i < loadedBlocks.Size(); i++)
     {
-        return std::move(glm::vec4{glm::normalize(glm::vec3(colorDist(rng), colorDist(rng), colorDist(rng))), 1.0f});
+        if (blockVisible[i] && !occlusionBuffer.IsVisible({blockBounds.minX[i], blockBounds.minY[i], blockBounds.minZ[i]},
+                                                          {blockBounds.maxX[i], blockBounds.maxY[i], blockBounds.maxZ[i]}))
+        {
+            blockVisible[i] = 0;
+            renderStats.visibleBlockCount--;
+            renderStats.occludedBlockCount++;
+        }
+
+        if (lightVisible[i] && !occlusionBuffer.IsVisible({lightBounds.minX[i], lightBounds.minY[i], lightBounds.minZ[i]},
+                                                          {lightBounds.maxX[i], lightBounds.maxY[i], lightBounds.maxZ[i]}))
+        {
+            lightVisible[i] = 0;
+            renderStats.occludedLightCount++;
+        }
     }
 }
 
@@ -721,23 +983,46 @@ void Cityscape::RecreateFBO()
     }
 
     // Generate geometry buffer textures
-    gPositionTex = new Phi::Texture2D(wWidth, wHeight, GL_RGBA32F, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
-    gNormalTex = new Phi::Texture2D(wWidth, wHeight, GL_RGBA8_SNORM, GL_RGBA, GL_BYTE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    if (renderSettings.compactGBuffer)
+    {
+        gPositionTex = nullptr;
+        gNormalTex = new Phi::Texture2D(wWidth, wHeight, GL_RG16_SNORM, GL_RG, GL_SHORT, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    }
+    else
+    {
+        gPositionTex = new Phi::Texture2D(wWidth, wHeight, GL_RGBA32F, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+        gNormalTex = new Phi::Texture2D(wWidth, wHeight, GL_RGBA8_SNORM, GL_RGBA, GL_BYTE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    }
     gColorSpecTex = new Phi::Texture2D(wWidth, wHeight, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
     gDepthStencilTex = new Phi::Texture2D(wWidth, wHeight, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
 
     // Attach textures to geometry buffer
     gBuffer = new Phi::FrameBuffer();
     gBuffer->Bind();
-    gBuffer->AttachTexture(gPositionTex, GL_COLOR_ATTACHMENT0);
+    if (gPositionTex) gBuffer->AttachTexture(gPositionTex, GL_COLOR_ATTACHMENT0);
     gBuffer->AttachTexture(gNormalTex, GL_COLOR_ATTACHMENT1);
     gBuffer->AttachTexture(gColorSpecTex, GL_COLOR_ATTACHMENT2);
     gBuffer->AttachTexture(gDepthStencilTex, GL_DEPTH_STENCIL_ATTACHMENT);
 
     // Set the draw buffers for the currently bound FBO
-    GLenum drawBuffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    // NOTE: Shaders always write positions to location 0, the compact layout just discards them
+    GLenum drawBuffers[3] = {renderSettings.compactGBuffer ? (GLenum)GL_NONE : (GLenum)GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
     glDrawBuffers(3, drawBuffers);
 
+    // Tell every shader which layout is in use, waiting for any frame still reading the old value
+    gBufferUBO->Lock();
+    gBufferUBO->Sync();
+    gBufferUBO->SetOffset(0);
+    gBufferUBO->Write((int)renderSettings.compactGBuffer);
+
     // Check for completeness :)
     gBuffer->CheckCompleteness();
+}
+
+// Returns the size in bytes of all geometry buffer textures (including depth / stencil)
+size_t Cityscape::GetGBufferSize() const
+{
+    // Position + normal + color / spec + depth / stencil
+    size_t bytesPerPixel = renderSettings.compactGBuffer ? (4 + 4 + 4) : (16 + 4 + 4 + 4);
+    return bytesPerPixel * wWidth * wHeight;
 }
\ No newline at end of file
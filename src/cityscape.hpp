@@ -1,13 +1,7 @@
 #pragma once
 
+#include <climits>
 #include <iostream>
-#include <unordered_map>
-#include <deque>
-#include <random>
-
-// Required for hashing glm vectors for use as keys in a std::unordered_map
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 // EnTT: https://github.com/skypjack/entt
 #include <entt.hpp>
@@ -16,8 +10,12 @@
 #include <phi/phi.hpp>
 
 // Cityscape components
+#include "blockgenerator.hpp"
+#include "blockgrid.hpp"
 #include "building.hpp"
+#include "clusteredlighting.hpp"
 #include "groundtile.hpp"
+#include "shadowcascades.hpp"
 #include "sky.hpp"
 
 class Cityscape: public Phi::App
@@ -28,9 +26,16 @@ class Cityscape: public Phi::App
         Cityscape();
         ~Cityscape();
 
-        // Simulates all city blocks and handles generation
+        // Simulates one step of camera movement, time of day, weather and light timing
+        // NOTE: Runs on the simulation thread when pipelined, so it must only touch simulation state
         void Update(float delta) override;
 
+        // Builds the ImGui windows
+        void UpdateGUI() override;
+
+        // Hands the simulation state to the renderer, then loads / deletes blocks and applies settings
+        void Sync() override;
+
         // Renders the cityscape
         void Render() override;
 
@@ -48,15 +53,55 @@ class Cityscape: public Phi::App
         // Registry of all active entities
         entt::registry registry;
 
-        // City block map and simulation queues
-        std::unordered_map<glm::ivec2, std::vector<entt::entity>> cityBlocks;
-        std::deque<glm::ivec2> generationQueue;
-        std::deque<glm::ivec2> deletionQueue;
+        // Toroidal grid of all loaded / generating city blocks around the camera
+        BlockGrid blockGrid;
+
+        // Background block generation
+        // Blocks from an old epoch (before the last Regenerate()) are discarded when they finish
+        // Block contents only depend on worldSeed and the block's id
+        BlockGenerator blockGenerator{BLOCK_SIZE};
+        int blockEpoch = 0;
+        uint64_t worldSeed = 4545;
 
         // Main components
+        // The simulation moves simCamera, Sync() copies its position / rotation to mainCamera for rendering
+        // NOTE: simCamera's UBO is never written, it is declared first so mainCamera owns UBO binding 0
+        Phi::Camera simCamera;
         Phi::Camera mainCamera;
         Sky sky;
 
+        // Everything Render() needs from a simulation step, captured at the end of every Update()
+        // Sync() blends the last two into renderState when using a fixed timestep
+        struct FrameState
+        {
+            glm::vec3 cameraPosition{0.0f};
+            float cameraYaw = 0.0f;
+            float cameraPitch = 0.0f;
+            float fov = 60.0f;
+            float timeOfDay = 0.0f;
+            float dayCycle = 45.0f;
+            float frameTime = 0.0f;
+            float snowAccumulation = 0.0f;
+            float snowIntensity = 1.0f;
+            bool snow = false;
+            bool lightsOn = false;
+            bool bulbsOn = false;
+        };
+        FrameState previousState;
+        FrameState currentState;
+        FrameState renderState;
+        FrameState CaptureState() const;
+
+        // Point light shading
+        // Volumes draws a sphere per light, the clustered modes shade all lights in one fullscreen pass
+        enum class LightPass : int
+        {
+            Volumes,
+            ClusteredGPU,
+            ClusteredCPU
+        };
+        ClusteredLighting* clusteredLighting = nullptr;
+
         // Models
         Phi::Model* streetLightModel = nullptr;
         Phi::Model* snowbankModel = nullptr;
@@ -71,9 +116,15 @@ class Cityscape: public Phi::App
         Phi::Shader snowEffectShader;
         Phi::Shader snowbankShader;
 
+        // Uniform handles, resolved once after linking
+        Phi::Shader::Uniform<glm::mat4> shadowViewProjUniform;
+        Phi::Shader::Uniform<glm::mat4> shadowInstanceViewProjUniform;
+        Phi::Shader::Uniform<glm::vec3> deltaTimeWindUniform;
+        Phi::Shader::Uniform<float> accumulationHeightUniform;
+
         // Other resources
         Phi::GPUBuffer* snowBuffer = nullptr;
-        Phi::GPUBuffer* lightSpaceUBO = nullptr;
+        Phi::GPUBuffer* gBufferUBO = nullptr;
         Phi::VertexAttributes snowVAO;
         GLuint dummyVAO;
 
@@ -81,11 +132,36 @@ class Cityscape: public Phi::App
         glm::vec2 prevMousePos;
 
         // Graphics settings
+        // The GUI edits settings, Render() reads renderSettings, which Sync() copies and applies
+        struct GraphicsSettings
+        {
+            bool fullscreen = false;
+            bool vsync = false;
+            bool shadows = false;
+            bool staticGeometry = true;
+            bool parallelBatchFill = true;
+            bool frustumCulling = true;
+            bool occlusionCulling = true;
+            bool glStateCache = true;
+            bool compactGBuffer = false;
+            LightPass lightPass = LightPass::ClusteredGPU;
+        };
+        GraphicsSettings settings;
+        GraphicsSettings renderSettings;
+        void ApplySettings();
         bool keepGUIOpen = false;
-        bool fullscreen = false;
-        bool vsync = false;
-        bool shadows = false;
+
+        // Frame pipelining settings (see Phi::App)
+        bool fixedSimulationRate = false;
+        int simulationRate = 60;
+
+        // Building LOD settings
+        // lodDistances[i] is the distance from the camera where blocks switch from LOD i to i + 1
+        bool buildingLODs = true;
+        float lodDistances[Building::NUM_LODS - 1] = {48.0f, 96.0f};
+        const float LOD_HYSTERESIS = 4.0f;
         int renderDistance = 5;
+        int blockUploadBudget = 4;
 
         // Simulation settings
         float mouseSensitivity = 0.045f;
@@ -103,39 +179,131 @@ class Cityscape: public Phi::App
         float maxAccumulation = 1.5f;
 
         // Timing
+        // NOTE: The simulation keeps its own time of day, Sync() hands it to the sky
         bool paused = false;
         bool timeAdvance = true;
+        float timeOfDay = 0.0f;
+        float dayCycle = 45.0f;
         float lightTimer = 0.2f;
+        float lightTimeAccum = 0.0f;
+        int lightColorCycle = 0;
         float lastFrameTime = 0.0f;
+        inline bool IsNight() const { return timeOfDay > dayCycle / 2.0f; };
+
+        // Work the simulation asks the main thread to do in the next Sync()
+        bool regenerateRequested = false;
+        bool recolorRequested = false;
 
         // Internal statistics
-        int buildingDrawCount = 0;
-        int lightDrawCount = 0;
+        // Render() fills renderStats, the GUI shows stats, which Sync() copies
+        struct Stats
+        {
+            int buildingDrawCount = 0;
+            int buildingLODCounts[Building::NUM_LODS] = {0};
+            int lightDrawCount = 0;
+            int loadedBlockCount = 0;
+            int visibleBlockCount = 0;
+            int shadowBlockCount = 0;
+            int shadowCascadeCount = 0;
+            int occludedBlockCount = 0;
+            int occludedLightCount = 0;
+            int occluderTriangleCount = 0;
+            int lightPoolCount = 0;
+            int lightPoolCapacity = 0;
+            int lightUploadSize = 0;
+            size_t geometryPoolSize = 0;
+            size_t gBufferSize = 0;
+        };
+        Stats renderStats;
+        Stats stats;
+
+        // Render data of every loaded block, copied into parallel arrays once per frame
+        // A block's buildings, lights and occluders are flattened into dense arrays, and the block keeps its range of each
+        // Render / culling passes only walk these, the registry is read once per block while gathering
+        struct LoadedBlocks
+        {
+            // Items [first, first + count) of a flattened array
+            struct Range
+            {
+                int first = 0;
+                int count = 0;
+            };
+
+            std::vector<entt::entity> entities;
+            std::vector<int> lods;
+            std::vector<glm::vec4> positions;
+
+            // Building ranges index the allocations of every LOD, which are only gathered with static geometry
+            std::vector<Range> buildings;
+            std::array<std::vector<Building::Allocation>, Building::NUM_LODS> buildingAllocations;
+
+            // Street light pool indices
+            std::vector<Range> lights;
+            std::vector<int> lightIndices;
+
+            std::vector<Range> occluders;
+            std::vector<Phi::AABB> occluderBoxes;
+
+            inline size_t Size() const { return lods.size(); };
+            inline void Clear()
+            {
+                entities.clear();
+                lods.clear();
+                positions.clear();
+                buildings.clear();
+                for (std::vector<Building::Allocation>& allocations : buildingAllocations) allocations.clear();
+                lights.clear();
+                lightIndices.clear();
+                occluders.clear();
+                occluderBoxes.clear();
+            };
+        };
+
+        // Per-frame block culling state, indices match loadedBlocks
+        // NOTE: Light bounds are the block bounds grown by the street light radius
+        LoadedBlocks loadedBlocks;
+        Phi::AABBList blockBounds;
+        Phi::AABBList lightBounds;
+        std::vector<uint8_t> blockVisible;
+        std::vector<uint8_t> lightVisible;
+        std::vector<uint8_t> shadowVisible;
+        void GatherBlocks();
+        int CullBlocks(const Phi::Frustum& frustum, const Phi::AABBList& bounds, std::vector<uint8_t>& visible);
+
+        // Draws the buildings of loadedBlocks[block]
+        void DrawBuildings(size_t block, const Phi::Shader& shader, int lod);
+
+        // Software occlusion culling
+        // Buildings of visible blocks closer than OCCLUDER_DISTANCE are drawn into the buffer as occluders
+        Phi::OcclusionBuffer occlusionBuffer{256, 128};
+        const float OCCLUDER_DISTANCE = 48.0f;
+        void OcclusionCullBlocks();
 
         // Internal methods for simulation / generation
         void Regenerate();
         void UpdateBlocks();
+        void UpdateLODs();
         void UpdateLights();
-        void GenerateBlock(const glm::ivec2& id);
-        void DeleteBlock(const glm::ivec2& id);
+        void GenerateBlock(BlockGrid::Slot& slot);
+        void InsertBlock(BlockGrid::Slot& slot, BlockData& block);
+        void DeleteBlock(BlockGrid::Slot& slot);
 
-        // RNG
-        glm::vec4 RandomColor() const;
-        static inline std::default_random_engine rng{4545L};
-        static inline std::uniform_int_distribution<int> storyDist{3, Building::MAX_STORIES};
-        static inline std::uniform_int_distribution<int> variantDist{0, Building::NUM_VARIANTS - 1};
-        static inline std::uniform_int_distribution<int> boolDist{0, 1};
+        // RNG for non-generation effects (snow, new world seeds)
+        Phi::Random rng{4545};
 
         // Geometry buffer + textures for deferred rendering
+        // The compact layout has no position texture (positions are reconstructed from depth)
+        // and stores octahedral encoded normals in RG16
         Phi::FrameBuffer* gBuffer = nullptr;
         Phi::Texture2D* gPositionTex = nullptr;
         Phi::Texture2D* gNormalTex = nullptr;
         Phi::Texture2D* gColorSpecTex = nullptr;
         Phi::Texture2D* gDepthStencilTex = nullptr;
 
-        // Shadow map depth texture
-        Phi::Texture2D* shadowDepthTex = nullptr;
+        // Cached, cascaded shadow maps for the global light
+        ShadowCascades shadowCascades;
 
         // Framebuffer update / regen methods
         void RecreateFBO();
+        size_t GetGBufferSize() const;
 };
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "clusteredlighting.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor, loads the binning / shading shaders
+ClusteredLighting::ClusteredLighting()
+{
+    binningShader.LoadShaderSource(GL_COMPUTE_SHADER, "data/shaders/lightClusters.cs");
+    binningShader.Link();
+    binningCameraNear = binningShader.GetUniform<float>("cameraNear");
+    binningClusterNear = binningShader.GetUniform<float>("clusterNear");
+    binningClusterFar = binningShader.GetUniform<float>("clusterFar");
+
+    shadingShader.LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/globalLightPass.vs");
+    shadingShader.LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/clusteredLight.fs");
+    shadingShader.Link();
+    shadingClusterNear = shadingShader.GetUniform<float>("clusterNear");
+    shadingClusterFar = shadingShader.GetUniform<float>("clusterFar");
+
+    // Fullscreen triangle is generated from gl_VertexID
+    glGenVertexArrays(1, &dummyVAO);
+}
+
+// Destructor
+ClusteredLighting::~ClusteredLighting()
+{
+    Phi::GLState::DeleteVertexArray(dummyVAO);
+    delete visibleBuffer;
+}
+
+// Clears the light list
+void ClusteredLighting::Begin()
+{
+    lightIndices.clear();
+}
+
+// Adds a light from the PointLight pool for this frame
+void ClusteredLighting::AddLight(int poolIndex)
+{
+    lightIndices.push_back((uint32_t)poolIndex);
+}
+
+// View space depth of the near side of a slice, matches SliceDepth() in lightClusters.cs
+float ClusteredLighting::SliceDepth(int slice, float cameraNear, float cameraFar) const
+{
+    if (slice == 0) return cameraNear;
+    return CLUSTER_NEAR * std::pow(cameraFar / CLUSTER_NEAR, (float)slice / CLUSTER_Z);
+}
+
+// Tests every light's sphere against the view space box of every cluster
+void ClusteredLighting::BinLights(const glm::mat4& view, const glm::mat4& proj, float cameraNear, float cameraFar, const PointLightPool& pool,
+                                  std::vector<uint32_t>& counts, std::vector<uint32_t>& lists) const
+{
+    counts.assign(CLUSTER_COUNT, 0);
+    lists.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+
+    // Lights in view space (xyz = center, w = radius)
+    std::vector<glm::vec4> viewLights(lightIndices.size());
+    for (size_t i = 0; i < lightIndices.size(); i++)
+    {
+        const glm::vec4& position = pool.GetPosition(lightIndices[i]);
+        viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(position), 1.0f)), position.w);
+    }
+
+    // Tile edges at a view space depth of 1
+    glm::vec2 scale = 1.0f / glm::vec2(proj[0][0], proj[1][1]);
+    glm::vec2 grid{CLUSTER_X, CLUSTER_Y};
+
+    for (int z = 0; z < CLUSTER_Z; z++)
+    {
+        float nearDepth = SliceDepth(z, cameraNear, cameraFar);
+        float farDepth = SliceDepth(z + 1, cameraNear, cameraFar);
+
+        for (int y = 0; y < CLUSTER_Y; y++)
+        {
+            for (int x = 0; x < CLUSTER_X; x++)
+            {
+                // View space bounds of the cluster, built from the tile's corner rays at both slice depths
+                glm::vec2 tileMin = (glm::vec2(x, y) / grid * 2.0f - 1.0f) * scale;
+                glm::vec2 tileMax = (glm::vec2(x + 1, y + 1) / grid * 2.0f - 1.0f) * scale;
+                glm::vec3 boundsMin{glm::min(tileMin * nearDepth, tileMin * farDepth), -farDepth};
+                glm::vec3 boundsMax{glm::max(tileMax * nearDepth, tileMax * farDepth), -nearDepth};
+
+                int cluster = x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y;
+                uint32_t* list = &lists[cluster * MAX_LIGHTS_PER_CLUSTER];
+                uint32_t count = 0;
+
+                for (size_t i = 0; i < viewLights.size() && count < MAX_LIGHTS_PER_CLUSTER; i++)
+                {
+                    glm::vec3 center{viewLights[i]};
+                    glm::vec3 offset = glm::clamp(center, boundsMin, boundsMax) - center;
+                    if (glm::dot(offset, offset) <= viewLights[i].w * viewLights[i].w) list[count++] = lightIndices[i];
+                }
+
+                counts[cluster] = count;
+            }
+        }
+    }
+}
+
+// Bins all lights into clusters and shades every pixel with its cluster's lights
+void ClusteredLighting::Draw(const Phi::Camera& camera, bool cpuBinning)
+{
+    const PointLightPool* pool = PointLight::GetPool();
+    if (lightIndices.empty() || !pool) return;
+
+    // Grow the visible light buffer to fit this frame's lights
+    // NOTE: Frames still in flight keep reading the old buffer, OpenGL only frees it once they are done
+    GLuint visibleSize = VISIBLE_HEADER_SIZE + sizeof(uint32_t) * lightIndices.size();
+    if (!visibleBuffer || !visibleBuffer->CanAllocate(visibleSize))
+    {
+        size_t capacity = visibleBuffer ? visibleBuffer->GetSize() * 2 : 0;
+        delete visibleBuffer;
+        visibleBuffer = new Phi::GPUBuffer(Phi::BufferType::DynamicPerFrame, std::max<size_t>(capacity, visibleSize));
+    }
+
+    // Upload this frame's pool indices
+    GLintptr visibleOffset = visibleBuffer->Allocate(visibleSize);
+    if (visibleOffset < 0) return;
+    GLuint header[VISIBLE_HEADER_SIZE / sizeof(GLuint)] = {(GLuint)lightIndices.size()};
+    visibleBuffer->Write(header, VISIBLE_HEADER_SIZE);
+    visibleBuffer->Write(lightIndices.data(), sizeof(uint32_t) * lightIndices.size());
+    visibleBuffer->BindRange(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visibleOffset, visibleSize);
+
+    if (cpuBinning)
+    {
+        // Reference path, bin on the CPU and upload the results
+        BinLights(camera.GetView(), camera.GetProj(), camera.GetNear(), camera.GetFar(), *pool, clusterCounts, clusterLists);
+
+        GLintptr clusterOffset = clusterUploadBuffer.Allocate(CLUSTER_BUFFER_SIZE);
+        if (clusterOffset < 0) return;
+        clusterUploadBuffer.Write(clusterCounts.data(), sizeof(uint32_t) * clusterCounts.size());
+        clusterUploadBuffer.Write(clusterLists.data(), sizeof(uint32_t) * clusterLists.size());
+        clusterUploadBuffer.BindRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, clusterOffset, CLUSTER_BUFFER_SIZE);
+    }
+    else
+    {
+        // One invocation per cluster
+        clusterBuffer.BindBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING);
+        binningShader.Use();
+        binningShader.SetUniform(binningCameraNear, camera.GetNear());
+        binningShader.SetUniform(binningClusterNear, CLUSTER_NEAR);
+        binningShader.SetUniform(binningClusterFar, camera.GetFar());
+        glDispatchCompute((CLUSTER_COUNT + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Shade every pixel with a fullscreen triangle
+    shadingShader.Use();
+    shadingShader.SetUniform(shadingClusterNear, CLUSTER_NEAR);
+    shadingShader.SetUniform(shadingClusterFar, camera.GetFar());
+    Phi::GLState::BindVertexArray(dummyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
\ No newline at end of file
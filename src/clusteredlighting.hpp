@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <phi/phi.hpp>
+
+#include "lights.hpp"
+
+// Clustered deferred shading for point lights
+// The view frustum is split into screen tiles and exponential depth slices, every cluster gets
+// the list of lights touching it, and one fullscreen pass shades each pixel with only its cluster's lights
+// Usage:
+// 1. Every frame, Begin() then AddLight() for every light that may be visible
+// 2. Draw() bins the lights (compute shader, or the CPU reference path) and shades the scene
+// NOTE: Light data is read from the PointLight pool, only pool indices are uploaded per frame
+// Draw() expects the pool's changes uploaded, the geometry buffer textures bound to units 0 - 2 and additive blending enabled
+class ClusteredLighting
+{
+    // Interface
+    public:
+
+        // Cluster grid, must match lightClusters.cs / clusteredLight.fs
+        static const int CLUSTER_X = 16;
+        static const int CLUSTER_Y = 9;
+        static const int CLUSTER_Z = 24;
+        static const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+        static const int MAX_LIGHTS_PER_CLUSTER = 64;
+
+        // Depth slices are exponential between CLUSTER_NEAR and the camera's far plane
+        // NOTE: The first slice always starts at the camera's near plane
+        static constexpr float CLUSTER_NEAR = 1.0f;
+
+        ClusteredLighting();
+        ~ClusteredLighting();
+
+        // Delete copy constructor/assignment
+        ClusteredLighting(const ClusteredLighting&) = delete;
+        ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+        // Delete move constructor/assignment
+        ClusteredLighting(ClusteredLighting&& other) = delete;
+        void operator=(ClusteredLighting&& other) = delete;
+
+        // Clears the light list
+        void Begin();
+
+        // Adds a light from the PointLight pool for this frame
+        void AddLight(int poolIndex);
+
+        // Bins all lights into clusters and shades every pixel with its cluster's lights
+        void Draw(const Phi::Camera& camera, bool cpuBinning = false);
+
+        // CPU reference binning, produces exactly what lightClusters.cs writes into the cluster buffer
+        // counts[c] is the number of lights in cluster c, lists[c * MAX_LIGHTS_PER_CLUSTER + i] their pool indices
+        void BinLights(const glm::mat4& view, const glm::mat4& proj, float cameraNear, float cameraFar, const PointLightPool& pool,
+                       std::vector<uint32_t>& counts, std::vector<uint32_t>& lists) const;
+
+        // Accessors
+        inline int GetLightCount() const { return (int)lightIndices.size(); };
+
+    // Data / implementation
+    private:
+
+        // Pool indices of this frame's lights
+        std::vector<uint32_t> lightIndices;
+
+        // CPU binning results
+        std::vector<uint32_t> clusterCounts;
+        std::vector<uint32_t> clusterLists;
+
+        // View space depth of the near side of a slice
+        float SliceDepth(int slice, float cameraNear, float cameraFar) const;
+
+        // Buffer sizes
+        // NOTE: The visible light range starts with a 16 byte header holding the light count
+        static const int VISIBLE_HEADER_SIZE = 16;
+        static const int CLUSTER_BUFFER_SIZE = sizeof(uint32_t) * CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER);
+
+        // Shader storage bindings
+        static const int CLUSTER_BINDING = 3;
+        static const int VISIBLE_BINDING = 4;
+
+        // OpenGL resources
+        // The visible light buffer grows with the number of lights added in a frame
+        // The GPU path writes clusters into clusterBuffer, the CPU path uploads into clusterUploadBuffer
+        Phi::GPUBuffer* visibleBuffer = nullptr;
+        Phi::GPUBuffer clusterBuffer{Phi::BufferType::Static, CLUSTER_BUFFER_SIZE};
+        Phi::GPUBuffer clusterUploadBuffer{Phi::BufferType::DynamicPerFrame, CLUSTER_BUFFER_SIZE};
+        Phi::Shader binningShader;
+        Phi::Shader shadingShader;
+        Phi::Shader::Uniform<float> binningCameraNear;
+        Phi::Shader::Uniform<float> binningClusterNear;
+        Phi::Shader::Uniform<float> binningClusterFar;
+        Phi::Shader::Uniform<float> shadingClusterNear;
+        Phi::Shader::Uniform<float> shadingClusterFar;
+        GLuint dummyVAO = 0;
+};
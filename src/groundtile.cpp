@@ -29,7 +29,7 @@ GroundTile::GroundTile(const glm::ivec2& id) : position(id.x * TILE_SIZE, 0, id.
         ebo = new Phi::GPUBuffer(Phi::BufferType::Static, sizeof(GROUND_INDICES), GROUND_INDICES);
         vao = new Phi::VertexAttributes(Phi::VertexFormat::POS_NORM_UV, vbo, ebo);
 
-        instanceUBO = new Phi::GPUBuffer(Phi::BufferType::Dynamic, sizeof(glm::vec4) * MAX_INSTANCES);
+        instanceUBO = new Phi::GPUBuffer(Phi::BufferType::DynamicPerFrame, sizeof(glm::vec4) * MAX_INSTANCES * MAX_FLUSHES_PER_FRAME);
 
         // Load the default shader
         shader = new Phi::Shader();
@@ -59,8 +59,8 @@ GroundTile::~GroundTile()
     }
 }
 
-// Draws into instance buffer, flushing if it is full
-void GroundTile::Draw()
+// Draws a tile at position into instance buffer, flushing if it is full
+void GroundTile::Draw(const glm::vec4& position)
 {
     // Flush if the buffer is already full
     if (drawCount >= MAX_INSTANCES)
@@ -68,7 +68,8 @@ void GroundTile::Draw()
         FlushDrawCalls();
     };
 
-    if (drawCount == 0) instanceUBO->Sync();
+    if (drawCount == 0) instanceOffset = instanceUBO->Allocate(sizeof(glm::vec4) * MAX_INSTANCES);
+    if (instanceOffset < 0) return;
 
     // Increase counter and write instance position to buffer
     drawCount++;
@@ -82,19 +83,14 @@ void GroundTile::FlushDrawCalls()
     if (drawCount == 0) return;
 
     // Bind resources
-    instanceUBO->BindBase(GL_UNIFORM_BUFFER, 1);
+    instanceUBO->BindRange(GL_UNIFORM_BUFFER, 1, instanceOffset, sizeof(glm::vec4) * MAX_INSTANCES);
     vao->Bind();
     texture->Bind();
     shader->Use();
 
     // Issue draw call
     glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, drawCount);
-    glBindVertexArray(0);
     
-    // Lock the buffer and reset the pointer
-    instanceUBO->Lock();
-    instanceUBO->SetOffset(0);
-
     // Reset counter
     drawCount = 0;
 }
\ No newline at end of file
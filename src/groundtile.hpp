@@ -19,8 +19,8 @@ class GroundTile
         GroundTile(GroundTile&& other) = delete;
         void operator=(GroundTile&& other) = delete;
 
-        // Draws into instance buffer, flushing if it is full
-        void Draw();
+        // Draws a tile at position (see GetPosition()) into instance buffer, flushing if it is full
+        static void Draw(const glm::vec4& position);
 
         // Flushes all grounds drawn since the last flush
         static void FlushDrawCalls();
@@ -34,8 +34,11 @@ class GroundTile
         glm::vec4 position;
 
         // Instancing information
+        // Every flush gets its own block of the per-frame instance UBO, starting at instanceOffset
         static const int MAX_INSTANCES = 512;
+        static const int MAX_FLUSHES_PER_FRAME = 4;
         static inline int drawCount = 0;
+        static inline GLintptr instanceOffset = -1;
 
         // Static resources
         static inline Phi::Texture2D* texture = nullptr;
@@ -14,7 +14,119 @@ DirectionalLight::~DirectionalLight()
 }
 
 // Constructor
-PointLight::PointLight(const glm::vec4& pos, const glm::vec4& col) : position(pos), color(col)
+PointLightPool::PointLightPool(int capacity) : capacity(std::max(capacity, 64))
+{
+    lights.resize(this->capacity);
+    onMask.resize((this->capacity + 63) / 64, 0);
+
+    storage = new Phi::GPUBuffer(Phi::BufferType::Static, sizeof(Light) * this->capacity);
+    staging = new Phi::GPUBuffer(Phi::BufferType::DynamicPerFrame, sizeof(Light) * this->capacity);
+}
+
+// Destructor
+PointLightPool::~PointLightPool()
+{
+    delete storage;
+    delete staging;
+}
+
+// Allocates a slot, reusing freed slots first
+int PointLightPool::Allocate(const glm::vec4& position, const glm::vec4& color, bool on)
+{
+    int index;
+    if (!freeSlots.empty())
+    {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        if (highWater >= capacity) Grow();
+        index = highWater++;
+    }
+
+    lights[index] = {position, color};
+    SetOn(index, on);
+    MarkDirty(index);
+    count++;
+
+    return index;
+}
+
+// Releases a slot, its data is simply overwritten by the next allocation
+void PointLightPool::Free(int index)
+{
+    SetOn(index, false);
+    freeSlots.push_back(index);
+    count--;
+}
+
+// Updates a light's position / radius
+void PointLightPool::SetPosition(int index, const glm::vec4& position)
+{
+    lights[index].position = position;
+    MarkDirty(index);
+}
+
+// Updates a light's color
+void PointLightPool::SetColor(int index, const glm::vec4& color)
+{
+    lights[index].color = color;
+    MarkDirty(index);
+}
+
+// Sets the state of every slot, free slots are never drawn so their bits don't matter
+void PointLightPool::SetAllOn(bool on)
+{
+    std::fill(onMask.begin(), onMask.end(), on ? ~0ull : 0ull);
+}
+
+// Doubles the capacity, everything in use is uploaded again
+void PointLightPool::Grow()
+{
+    capacity *= 2;
+    lights.resize(capacity);
+    onMask.resize((capacity + 63) / 64, 0);
+
+    // NOTE: OpenGL defers deleting the old buffers until the GPU is done with them
+    delete storage;
+    delete staging;
+    storage = new Phi::GPUBuffer(Phi::BufferType::Static, sizeof(Light) * capacity);
+    staging = new Phi::GPUBuffer(Phi::BufferType::DynamicPerFrame, sizeof(Light) * capacity);
+
+    dirtyMin = 0;
+    dirtyMax = std::max(dirtyMax, highWater);
+}
+
+// Writes the dirty range into the current frame's staging section, then copies it into storage
+void PointLightPool::Upload()
+{
+    lastUploadSize = 0;
+    if (dirtyMin >= dirtyMax) return;
+
+    // Keep the range dirty if it doesn't fit, it is uploaded again next frame
+    GLuint size = sizeof(Light) * (dirtyMax - dirtyMin);
+    GLintptr offset = staging->Allocate(size);
+    if (offset < 0) return;
+    staging->Write(&lights[dirtyMin], size);
+
+    Phi::GLState::BindBuffer(GL_COPY_READ_BUFFER, staging->GetName());
+    Phi::GLState::BindBuffer(GL_COPY_WRITE_BUFFER, storage->GetName());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, sizeof(Light) * dirtyMin, size);
+
+    lastUploadSize = size;
+    dirtyMin = INT_MAX;
+    dirtyMax = 0;
+}
+
+// Binds the storage buffer to a shader storage binding point
+void PointLightPool::Bind(GLuint index) const
+{
+    storage->BindBase(GL_SHADER_STORAGE_BUFFER, index);
+}
+
+// Constructor
+PointLight::PointLight(const glm::vec4& pos, const glm::vec4& col)
 {
     // Initialize static resources on first instance created
     if (refCount == 0)
@@ -29,17 +141,20 @@ PointLight::PointLight(const glm::vec4& pos, const glm::vec4& col) : position(po
         shader->LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/pointLight.fs");
         shader->Link();
 
-        // Instance buffer data
-        // 512 * 2 * sizeof(glm::vec4) = 16,384 = minimum UBO limit required by OpenGL
-        instanceUBO = new Phi::GPUBuffer(Phi::BufferType::Dynamic, sizeof(glm::vec4) * 2 * MAX_INSTANCES);
+        // Light data lives in the pool, instances are just indices into it
+        pool = new PointLightPool();
     }
 
     refCount++;
+
+    index = pool->Allocate(pos, col, allOn);
 }
 
 // Destructor
 PointLight::~PointLight()
 {
+    pool->Free(index);
+
     refCount--;
 
     // Destroy static resources on last instance destroyed
@@ -49,45 +164,69 @@ PointLight::~PointLight()
         delete ebo;
         delete vao;
         delete shader;
-        delete instanceUBO;
+        delete pool;
+        delete instanceBuffer;
+        pool = nullptr;
+        instanceBuffer = nullptr;
+        instanceCapacity = 0;
+        drawIndices.clear();
     }
 }
 
-// Draws into instance buffer, flushing if it is full
-void PointLight::Draw()
+// Queues the volume of the light in a pool slot to be drawn
+void PointLight::Draw(int poolIndex)
 {
-    // Flush if the buffer is already full
-    if (drawCount >= MAX_INSTANCES)
-    {
-        FlushDrawCalls();
-    };
-
-    instanceUBO->Sync();
-
-    // Increase counter and write instance position to buffer
-    drawCount++;
-    instanceUBO->Write(position);
-    instanceUBO->Write(color);
+    drawIndices.push_back(poolIndex);
 }
 
+// Draws all light volumes queued since the last flush in a single instanced call
 void PointLight::FlushDrawCalls()
 {
     // Only flush if there is something to render
-    if (drawCount == 0) return;
+    if (drawIndices.empty()) return;
+
+    // Grow the instance buffer to fit every queued light
+    // NOTE: Frames still in flight keep reading the old buffer, OpenGL only frees it once they are done
+    if ((int)drawIndices.size() > instanceCapacity)
+    {
+        delete instanceBuffer;
+        instanceCapacity = std::max(instanceCapacity * 2, ((int)drawIndices.size() + 63) & ~63);
+        instanceBuffer = new Phi::GPUBuffer(Phi::BufferType::DynamicPerFrame, sizeof(uint32_t) * instanceCapacity);
+    }
+
+    // Write the indices into the current frame's section
+    size_t instanceBytes = sizeof(uint32_t) * drawIndices.size();
+    GLintptr offset = instanceBuffer->Allocate(instanceBytes);
+    if (offset < 0)
+    {
+        drawIndices.clear();
+        return;
+    }
+    instanceBuffer->Write(drawIndices.data(), instanceBytes);
 
     // Bind objects
-    instanceUBO->BindBase(GL_UNIFORM_BUFFER, 1);
+    instanceBuffer->BindRange(GL_SHADER_STORAGE_BUFFER, 1, offset, instanceBytes);
     vao->Bind();
     shader->Use();
 
     // Issue draw call
-    glDrawElementsInstanced(GL_TRIANGLES, 60, GL_UNSIGNED_INT, 0, drawCount);
-    glBindVertexArray(0);
+    glDrawElementsInstanced(GL_TRIANGLES, 60, GL_UNSIGNED_INT, 0, (GLsizei)drawIndices.size());
+
+    drawIndices.clear();
+}
 
-    // Lock buffer and reset pointer
-    instanceUBO->Lock();
-    instanceUBO->SetOffset(0);
+// Turns every light on / off, lights created later start in the same state
+void PointLight::SetAllOn(bool on)
+{
+    if (pool && on != allOn) pool->SetAllOn(on);
+    allOn = on;
+}
+
+// Uploads changed light data and binds the pool's storage buffer
+void PointLight::UploadChanges()
+{
+    if (!pool) return;
 
-    // Reset counter
-    drawCount = 0;
+    pool->Upload();
+    pool->Bind(POOL_BINDING);
 }
\ No newline at end of file
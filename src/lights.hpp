@@ -1,5 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <glm/glm.hpp>
 
 #include <phi/phi.hpp>
@@ -43,6 +49,86 @@ class DirectionalLight
         bool on = true;
 };
 
+// Persistent pool of point light data, kept resident in a shader storage buffer
+// Lights are allocated when their block is inserted and freed when it is deleted,
+// only the range of lights changed since the last Upload() is copied to the GPU
+// NOTE: On / off state is a CPU side bitmask, it never needs uploading
+class PointLightPool
+{
+    // Interface
+    public:
+
+        PointLightPool(int capacity = 1024);
+        ~PointLightPool();
+
+        // Delete copy constructor/assignment
+        PointLightPool(const PointLightPool&) = delete;
+        PointLightPool& operator=(const PointLightPool&) = delete;
+
+        // Delete move constructor/assignment
+        PointLightPool(PointLightPool&& other) = delete;
+        void operator=(PointLightPool&& other) = delete;
+
+        // Allocation, the pool grows when it runs out of slots
+        int Allocate(const glm::vec4& position, const glm::vec4& color, bool on);
+        void Free(int index);
+
+        // Mutators, marking the light dirty
+        void SetPosition(int index, const glm::vec4& position);
+        void SetColor(int index, const glm::vec4& color);
+
+        // On / off state
+        inline void SetOn(int index, bool on) { if (on) onMask[index / 64] |= (1ull << (index % 64)); else onMask[index / 64] &= ~(1ull << (index % 64)); };
+        inline bool IsOn(int index) const { return (onMask[index / 64] >> (index % 64)) & 1; };
+        void SetAllOn(bool on);
+
+        // Copies the dirty range of lights into the storage buffer
+        void Upload();
+
+        // Binds the storage buffer (array of position + radius, color pairs) to a shader storage binding point
+        void Bind(GLuint index) const;
+
+        // Accessors
+        inline const glm::vec4& GetPosition(int index) const { return lights[index].position; };
+        inline const glm::vec4& GetColor(int index) const { return lights[index].color; };
+        inline int GetCapacity() const { return capacity; };
+        inline int GetCount() const { return count; };
+        inline int GetLastUploadSize() const { return lastUploadSize; };
+
+    // Data / implementation
+    private:
+
+        // GPU layout of a single light
+        struct Light
+        {
+            glm::vec4 position; // w = radius
+            glm::vec4 color;
+        };
+
+        // Doubles the capacity, everything in use is uploaded again
+        void Grow();
+
+        // Extends the dirty range to include index
+        inline void MarkDirty(int index) { dirtyMin = std::min(dirtyMin, index); dirtyMax = std::max(dirtyMax, index + 1); };
+
+        // CPU copy of every slot
+        std::vector<Light> lights;
+        std::vector<uint64_t> onMask;
+        std::vector<int> freeSlots;
+        int capacity = 0;
+        int count = 0;
+        int highWater = 0;
+
+        // Range of slots [dirtyMin, dirtyMax) changed since the last upload
+        int dirtyMin = INT_MAX;
+        int dirtyMax = 0;
+        int lastUploadSize = 0;
+
+        // Device storage + per-frame staging buffer, dirty ranges are copied between them on the GPU
+        Phi::GPUBuffer* storage = nullptr;
+        Phi::GPUBuffer* staging = nullptr;
+};
+
 class PointLight
 {
     // Interface
@@ -59,41 +145,87 @@ class PointLight
         void operator=(PointLight&& other) = delete;
 
         // Mutators
-        inline void SetPosition(const glm::vec4& pos) { position = pos; };
-        inline void SetColor(const glm::vec4& col) { color = col; };
-        inline void TurnOn() { on = true; };
-        inline void TurnOff() { on = false; };
-        inline bool IsOn() const { return on; };
+        inline void SetPosition(const glm::vec4& pos) { pool->SetPosition(index, pos); };
+        inline void SetColor(const glm::vec4& col) { pool->SetColor(index, col); };
+        inline void TurnOn() { pool->SetOn(index, true); };
+        inline void TurnOff() { pool->SetOn(index, false); };
+        inline bool IsOn() const { return pool->IsOn(index); };
 
         // Accessors
-        inline const glm::vec4& GetPosition() const { return position; };
-        inline const glm::vec4& GetColor() const { return color; };
+        inline const glm::vec4& GetPosition() const { return pool->GetPosition(index); };
+        inline const glm::vec4& GetColor() const { return pool->GetColor(index); };
+        inline int GetIndex() const { return index; };
 
-        // Draws into instance buffer, flushing if it is full
-        void Draw();
+        // Queues the volume of the light in a pool slot (see GetIndex()) to be drawn
+        static void Draw(int poolIndex);
 
-        // Flushes all grounds drawn since the last flush
+        // Draws all light volumes queued since the last flush in a single instanced call
         static void FlushDrawCalls();
-    
+
+        // Turns every light on / off, lights created later start in the same state
+        static void SetAllOn(bool on);
+
+        // Uploads changed light data and binds the pool's storage buffer, call once per frame before lighting
+        static void UploadChanges();
+
+        // Pool of all light data, nullptr while no lights exist
+        static inline PointLightPool* GetPool() { return pool; };
+
+        // Shader storage binding of the pool's light array
+        static const int POOL_BINDING = 2;
+
     // Data / implementation
     private:
-        // Per-Instance data
-        glm::vec4 position;
-        glm::vec4 color;
-        bool on = true;
+        // Slot in the light pool
+        int index = -1;
 
-        // Instancing information
-        static const int MAX_INSTANCES = 512;
-        static inline int drawCount = 0;
+        // Instancing information, light volumes index into the pool
+        static inline std::vector<uint32_t> drawIndices;
+        static inline int instanceCapacity = 0;
+        static inline bool allOn = false;
 
         // Static resources
         static inline Phi::GPUBuffer* vbo = nullptr;
         static inline Phi::GPUBuffer* ebo = nullptr;
         static inline Phi::VertexAttributes* vao = nullptr;
 
-        static inline Phi::GPUBuffer* instanceUBO = nullptr;
+        static inline PointLightPool* pool = nullptr;
+        static inline Phi::GPUBuffer* instanceBuffer = nullptr;
         static inline Phi::Shader* shader = nullptr;
 
         // Reference counting for static resources
         static inline int refCount = 0;
+};
+
+// Every street light of a single city block, stored contiguously
+// NOTE: A PointLight is just its slot in the pool, so this is effectively a dense array of pool indices
+class PointLightGroup
+{
+    // Interface
+    public:
+        PointLightGroup(int count) : lights(std::make_unique<PointLight[]>(count)), count(count) {};
+        ~PointLightGroup() = default;
+
+        // Delete copy constructor/assignment
+        PointLightGroup(const PointLightGroup&) = delete;
+        PointLightGroup& operator=(const PointLightGroup&) = delete;
+
+        // Delete move constructor/assignment
+        PointLightGroup(PointLightGroup&& other) = delete;
+        void operator=(PointLightGroup&& other) = delete;
+
+        // Iteration
+        inline PointLight* begin() { return lights.get(); };
+        inline PointLight* end() { return lights.get() + count; };
+        inline const PointLight* begin() const { return lights.get(); };
+        inline const PointLight* end() const { return lights.get() + count; };
+
+        // Accessors
+        inline PointLight& operator[](int index) { return lights[index]; };
+        inline int GetCount() const { return count; };
+
+    // Data / implementation
+    private:
+        std::unique_ptr<PointLight[]> lights;
+        int count;
 };
\ No newline at end of file
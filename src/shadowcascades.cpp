@@ -0,0 +1,150 @@
+#include "shadowcascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor, creates the depth only framebuffer for the atlas
+ShadowCascades::ShadowCascades()
+{
+    // Everything outside the atlas is unshadowed
+    depthAtlas.Bind();
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+    fbo.Bind();
+    fbo.AttachTexture(&depthAtlas, GL_DEPTH_ATTACHMENT);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    fbo.CheckCompleteness();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Destructor
+ShadowCascades::~ShadowCascades()
+{
+
+}
+
+// Marks cascades dirty if the light has turned or the camera left their region
+void ShadowCascades::Update(const glm::vec3& lightPos, const glm::vec3& cameraPos)
+{
+    glm::vec3 lightDir = glm::normalize(lightPos);
+    float cosThreshold = std::cos(glm::radians(DIRECTION_THRESHOLD));
+
+    for (int i = 0; i < CASCADE_COUNT; i++)
+    {
+        Cascade& cascade = cascades[i];
+        float extent = CASCADE_EXTENTS[i];
+
+        // Distance from the center, ignoring height since the boxes cover the whole city vertically
+        glm::vec2 offset{cameraPos.x - cascade.center.x, cameraPos.z - cascade.center.z};
+        bool turned = glm::dot(lightDir, cascade.lightDir) < cosThreshold;
+        bool moved = glm::length(offset) > extent * RECENTER_FRACTION;
+
+        // Only move a cascade when it is going to be re-rendered anyway, so the pending matrix stays stable
+        if (turned || moved || cascade.dirty)
+        {
+            Recenter(cascade, extent, lightDir, cameraPos);
+            cascade.dirty = true;
+        }
+    }
+}
+
+// Rebuilds a cascade's matrix around a new center, snapped to whole shadow map texels
+// Snapping in light space keeps shadow edges from shimmering when the box moves
+void ShadowCascades::Recenter(Cascade& cascade, float extent, const glm::vec3& lightDir, const glm::vec3& cameraPos)
+{
+    // Light looks down lightDir from far enough away to see the tallest buildings
+    const float LIGHT_DISTANCE = 512.0f;
+    glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 target{cameraPos.x, 0.0f, cameraPos.z};
+    glm::mat4 lightView = glm::lookAt(target + lightDir * LIGHT_DISTANCE, target, up);
+
+    // Snap the target to the texel grid in light space
+    float texelSize = extent * 2.0f / RESOLUTION;
+    glm::vec4 origin = lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec2 snapOffset = glm::vec2(origin) - glm::floor(glm::vec2(origin) / texelSize) * texelSize;
+    glm::mat4 snap = glm::translate(glm::mat4(1.0f), glm::vec3(-snapOffset, 0.0f));
+
+    glm::mat4 lightProj = glm::ortho(-extent, extent, -extent, extent, 1.0f, LIGHT_DISTANCE * 2.0f);
+    cascade.pendingViewProj = lightProj * snap * lightView;
+    cascade.center = target;
+    cascade.lightDir = lightDir;
+}
+
+// Marks every cascade whose volume touches the box as dirty
+void ShadowCascades::Invalidate(const glm::vec3& min, const glm::vec3& max)
+{
+    for (Cascade& cascade : cascades)
+    {
+        // Test against both the rendered and pending volumes, either may be in use
+        if (Phi::Frustum(cascade.renderedViewProj).Intersects(min, max) || Phi::Frustum(cascade.pendingViewProj).Intersects(min, max))
+        {
+            cascade.dirty = true;
+        }
+    }
+}
+
+// Marks every cascade as dirty
+void ShadowCascades::InvalidateAll()
+{
+    for (Cascade& cascade : cascades) cascade.dirty = true;
+}
+
+// Returns a bitmask of the cascades to render this frame
+int ShadowCascades::GetCascadesToRender()
+{
+    int mask = cascades[0].dirty ? 1 : 0;
+
+    // Spread outer cascade updates over multiple frames
+    for (int i = 0; i < CASCADE_COUNT - 1; i++)
+    {
+        int cascade = nextOuterCascade;
+        nextOuterCascade = nextOuterCascade % (CASCADE_COUNT - 1) + 1;
+        if (cascades[cascade].dirty)
+        {
+            mask |= 1 << cascade;
+            break;
+        }
+    }
+
+    renderCount = 0;
+    for (int i = 0; i < CASCADE_COUNT; i++) renderCount += (mask >> i) & 1;
+    return mask;
+}
+
+// Binds the shadow framebuffer and clears the cascade's square of the atlas
+void ShadowCascades::BeginCascade(int cascade)
+{
+    fbo.Bind();
+    glViewport(cascade * RESOLUTION, 0, RESOLUTION, RESOLUTION);
+    glScissor(cascade * RESOLUTION, 0, RESOLUTION, RESOLUTION);
+    Phi::GLState::Enable(GL_SCISSOR_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    Phi::GLState::Disable(GL_SCISSOR_TEST);
+}
+
+// Marks the cascade as clean
+void ShadowCascades::EndCascade(int cascade)
+{
+    cascades[cascade].renderedViewProj = cascades[cascade].pendingViewProj;
+    cascades[cascade].dirty = false;
+}
+
+// Writes the rendered cascades' matrices into the light space UBO
+void ShadowCascades::UpdateUBO(bool enabled)
+{
+    // Written into the current frame's section
+    GLintptr offset = ubo.Allocate(UBO_SIZE);
+    if (offset < 0) return;
+
+    for (const Cascade& cascade : cascades) ubo.Write(cascade.renderedViewProj);
+
+    // Shadow bias grows with the size of a cascade's texels
+    glm::vec4 texelScales{1.0f};
+    for (int i = 0; i < CASCADE_COUNT; i++) texelScales[i] = CASCADE_EXTENTS[i] / CASCADE_EXTENTS[0];
+    ubo.Write(texelScales);
+    ubo.Write(enabled ? CASCADE_COUNT : 0);
+
+    ubo.BindRange(GL_UNIFORM_BUFFER, 5, offset, UBO_SIZE);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <phi/phi.hpp>
+
+// Cached, cascaded shadow maps for the global light
+// Each cascade is a camera centered orthographic box of increasing size, rendered into its own
+// square of a single depth atlas. A cascade is only re-rendered when it is dirty:
+// - The light direction moved past DIRECTION_THRESHOLD since it was rendered
+// - A block inside its volume was loaded / unloaded (see Invalidate())
+// - The camera moved far enough from its center
+// Usage:
+// 1. Every frame, Update() with the light / camera state
+// 2. For each cascade from GetCascadesToRender(): BeginCascade(), draw all casters with GetPendingViewProj(), EndCascade()
+// 3. UpdateUBO() before the lighting pass, then bind GetTexture()
+class ShadowCascades
+{
+    // Interface
+    public:
+
+        // Cascade setup, must match globalLightPass.fs
+        static const int CASCADE_COUNT = 3;
+        static const int RESOLUTION = 1024;
+
+        // Half width of each cascade's box, in world units
+        static constexpr float CASCADE_EXTENTS[CASCADE_COUNT] = {24.0f, 64.0f, 160.0f};
+        static_assert(CASCADE_COUNT >= 1 && CASCADE_COUNT <= 4, "Cascade texel scales are packed into a single vec4");
+
+        // Re-render thresholds
+        static constexpr float DIRECTION_THRESHOLD = 0.5f; // Degrees
+        static constexpr float RECENTER_FRACTION = 0.25f; // Of the cascade's extent
+
+        ShadowCascades();
+        ~ShadowCascades();
+
+        // Delete copy constructor/assignment
+        ShadowCascades(const ShadowCascades&) = delete;
+        ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+        // Delete move constructor/assignment
+        ShadowCascades(ShadowCascades&& other) = delete;
+        void operator=(ShadowCascades&& other) = delete;
+
+        // Marks cascades dirty if the light has turned or the camera left their region
+        // lightPos is the position of the light relative to the scene's origin
+        void Update(const glm::vec3& lightPos, const glm::vec3& cameraPos);
+
+        // Marks every cascade whose volume touches the box as dirty
+        void Invalidate(const glm::vec3& min, const glm::vec3& max);
+        void InvalidateAll();
+
+        // Returns a bitmask of the cascades to render this frame
+        // The first cascade is re-rendered whenever it is dirty, the others at most one per frame
+        int GetCascadesToRender();
+
+        // Binds the shadow framebuffer and clears the cascade's square of the atlas
+        void BeginCascade(int cascade);
+
+        // Marks the cascade as clean, the view projection it was rendered with becomes visible to the lighting pass
+        void EndCascade(int cascade);
+
+        // Writes the rendered cascades' matrices into the light space UBO (binding 5)
+        // When disabled, the lighting pass skips all shadow lookups
+        void UpdateUBO(bool enabled);
+
+        // Accessors
+        inline const glm::mat4& GetPendingViewProj(int cascade) const { return cascades[cascade].pendingViewProj; };
+        inline const Phi::Texture2D& GetTexture() const { return depthAtlas; };
+        inline int GetRenderCount() const { return renderCount; };
+
+    // Data / implementation
+    private:
+
+        // Cached state of a single cascade
+        struct Cascade
+        {
+            glm::mat4 pendingViewProj{1.0f};
+            glm::mat4 renderedViewProj{1.0f};
+            glm::vec3 center{0.0f};
+            glm::vec3 lightDir{0.0f};
+            bool dirty = true;
+        };
+        Cascade cascades[CASCADE_COUNT];
+
+        // Rebuilds a cascade's matrix around a new center, snapped to whole shadow map texels
+        void Recenter(Cascade& cascade, float extent, const glm::vec3& lightDir, const glm::vec3& cameraPos);
+
+        // Round robin position for the outer cascades
+        int nextOuterCascade = 1;
+
+        // Number of cascades rendered this frame
+        int renderCount = 0;
+
+        // OpenGL resources
+        Phi::Texture2D depthAtlas{RESOLUTION * CASCADE_COUNT, RESOLUTION,
+                                  GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_FLOAT,
+                                  GL_CLAMP_TO_BORDER, GL_CLAMP_TO_BORDER,
+                                  GL_NEAREST, GL_NEAREST};
+        Phi::FrameBuffer fbo;
+        Phi::GPUBuffer ubo{Phi::BufferType::DynamicPerFrame, UBO_SIZE};
+
+        // Light space UBO layout: one matrix per cascade, texel scale per cascade, cascade count
+        static const int UBO_SIZE = sizeof(glm::mat4) * CASCADE_COUNT + sizeof(glm::vec4) * 2;
+};
@@ -46,28 +46,28 @@ static const Phi::VertexPos SKYBOX_VERTICES[] =
     {1.0f, -1.0f,  1.0f}
 };
 
+// Returns the files of a skybox, a pre-baked container (path + ".phtex") is used if it exists
+static std::vector<std::string> SkyboxFaces(const std::string& path)
+{
+    if (std::filesystem::exists(path + ".phtex")) return {path + ".phtex"};
+
+    return {
+        path + "/right.png",
+        path + "/left.png",
+        path + "/top.png",
+        path + "/bottom.png",
+        path + "/front.png",
+        path + "/back.png"
+    };
+}
+
 // Contruct a sky component
 // daySkyboxPath, nightSkyboxPath: path to a folder containing skybox face images in the below format
 Sky::Sky(const std::string& daySkyboxPath, const std::string& nightSkyboxPath)
-    : dayBox({
-        daySkyboxPath + "/right.png",
-        daySkyboxPath + "/left.png",
-        daySkyboxPath + "/top.png",
-        daySkyboxPath + "/bottom.png",
-        daySkyboxPath + "/front.png",
-        daySkyboxPath + "/back.png"
-    }),
-    
-    nightBox({
-        nightSkyboxPath + "/right.png",
-        nightSkyboxPath + "/left.png",
-        nightSkyboxPath + "/top.png",
-        nightSkyboxPath + "/bottom.png",
-        nightSkyboxPath + "/front.png",
-        nightSkyboxPath + "/back.png"
-    }),
-
-    lightUBO(Phi::BufferType::Dynamic, sizeof(DirectionalLight) * 2 + sizeof(GLfloat) * 2)
+    : dayBox(SkyboxFaces(daySkyboxPath)),
+    nightBox(SkyboxFaces(nightSkyboxPath)),
+
+    lightUBO(Phi::BufferType::DynamicPerFrame, LIGHT_UBO_SIZE)
 {
     // Bind UBO to default light binding point
     lightUBO.BindBase(GL_UNIFORM_BUFFER, 2);
@@ -82,6 +82,7 @@ Sky::Sky(const std::string& daySkyboxPath, const std::string& nightSkyboxPath)
         skyboxShader->LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/skybox.vs");
         skyboxShader->LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/skybox.fs");
         skyboxShader->Link();
+        skyboxTimeUniform = skyboxShader->GetUniform<float>("time");
 
         // Create resources for rendering sun and moon
         sphereVBO = new Phi::GPUBuffer(Phi::BufferType::Static, sizeof(Phi::Icosphere::ICOSPHERE_VERTICES), Phi::Icosphere::ICOSPHERE_VERTICES);
@@ -91,6 +92,8 @@ Sky::Sky(const std::string& daySkyboxPath, const std::string& nightSkyboxPath)
         celestialBodyShader->LoadShaderSource(GL_VERTEX_SHADER, "data/shaders/celestialBody.vs");
         celestialBodyShader->LoadShaderSource(GL_FRAGMENT_SHADER, "data/shaders/celestialBody.fs");
         celestialBodyShader->Link();
+        positionRadiusUniform = celestialBodyShader->GetUniform<glm::vec4>("positionRadius");
+        colorUniform = celestialBodyShader->GetUniform<glm::vec4>("color");
     }
 
     refCount++;
@@ -148,19 +151,21 @@ void Sky::Update()
 // Renders the sky
 void Sky::Draw()
 {
-    // Wait for buffer to be free
-    lightUBO.Sync();
-
-    // Update UBO
-    const DirectionalLight& activeLight = IsNight() ? moon : sun;
-    lightUBO.Write(activeLight.GetPosition());
-    lightUBO.Write(activeLight.GetDirection());
-    lightUBO.Write(activeLight.GetColor());
-    lightUBO.Write(ambient);
+    // Update UBO, the lighting pass reads it from the next frame on
+    GLintptr offset = lightUBO.Allocate(LIGHT_UBO_SIZE);
+    if (offset >= 0)
+    {
+        const DirectionalLight& activeLight = IsNight() ? moon : sun;
+        lightUBO.Write(activeLight.GetPosition());
+        lightUBO.Write(activeLight.GetDirection());
+        lightUBO.Write(activeLight.GetColor());
+        lightUBO.Write(ambient);
+        lightUBO.BindRange(GL_UNIFORM_BUFFER, 2, offset, LIGHT_UBO_SIZE);
+    }
 
     // Calculate normalized time (t for lerping between day / night skyboxes)
     skyboxShader->Use();
-    skyboxShader->SetUniform("time", 1 - ((st + 1) / 2));
+    skyboxShader->SetUniform(skyboxTimeUniform, 1 - ((st + 1) / 2));
 
     // First pass: Draw skybox
 
@@ -173,12 +178,11 @@ void Sky::Draw()
     nightBox.Bind(1);
 
     // Change depth function so max distance still renders
-    glDepthFunc(GL_LEQUAL);
+    Phi::GLState::DepthFunc(GL_LEQUAL);
     
-    // Draw, unbind, and reset depth function
+    // Draw and reset depth function
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS);
+    Phi::GLState::DepthFunc(GL_LESS);
 
     // Second pass: Draw sun / moon
 
@@ -195,20 +199,15 @@ void Sky::Draw()
     celestialBodyShader->Use();
 
     // Draw sun
-    celestialBodyShader->SetUniform("positionRadius", {sunPos.x, sunPos.y, sunPos.z, sunRadius});
-    celestialBodyShader->SetUniform("color", {sunCol.r, sunCol.g, sunCol.b, 1.0f});
+    celestialBodyShader->SetUniform(positionRadiusUniform, {sunPos.x, sunPos.y, sunPos.z, sunRadius});
+    celestialBodyShader->SetUniform(colorUniform, {sunCol.r, sunCol.g, sunCol.b, 1.0f});
     glDrawElements(GL_TRIANGLES, 60, GL_UNSIGNED_INT, 0);
     
     // Draw moon
-    celestialBodyShader->SetUniform("positionRadius", {moonPos.x, moonPos.y, moonPos.z, moonRadius});
-    celestialBodyShader->SetUniform("color", {moonCol.r, moonCol.g, moonCol.b, 1.0f});
+    celestialBodyShader->SetUniform(positionRadiusUniform, {moonPos.x, moonPos.y, moonPos.z, moonRadius});
+    celestialBodyShader->SetUniform(colorUniform, {moonCol.r, moonCol.g, moonCol.b, 1.0f});
     glDrawElements(GL_TRIANGLES, 60, GL_UNSIGNED_INT, 0);
 
-    // Unbind and reset to default winding order
-    glBindVertexArray(0);
+    // Reset to default winding order
     glFrontFace(GL_CCW);
-
-    // Lock the UBO
-    lightUBO.Lock();
-    lightUBO.SetOffset(0);
 }
\ No newline at end of file
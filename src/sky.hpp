@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <vector>
 #include <string>
 
@@ -48,7 +49,8 @@ class Sky
         Phi::Cubemap dayBox;
         Phi::Cubemap nightBox;
 
-        // Global light data
+        // Global light data, written into the current frame's section of the UBO every Draw()
+        static const int LIGHT_UBO_SIZE = sizeof(DirectionalLight) * 2 + sizeof(GLfloat) * 2;
         Phi::GPUBuffer lightUBO;
         DirectionalLight sun;
         DirectionalLight moon;
@@ -65,11 +67,14 @@ class Sky
         static inline Phi::GPUBuffer* skyboxVBO = nullptr;
         static inline Phi::VertexAttributes* skyboxVAO = nullptr;
         static inline Phi::Shader* skyboxShader = nullptr;
+        static inline Phi::Shader::Uniform<float> skyboxTimeUniform;
 
         static inline Phi::GPUBuffer* sphereVBO = nullptr;
         static inline Phi::GPUBuffer* sphereEBO = nullptr;
         static inline Phi::VertexAttributes* sphereVAO = nullptr;
         static inline Phi::Shader* celestialBodyShader = nullptr;
+        static inline Phi::Shader::Uniform<glm::vec4> positionRadiusUniform;
+        static inline Phi::Shader::Uniform<glm::vec4> colorUniform;
 
         // Reference counting for static resources
         static inline int refCount = 0;
@@ -0,0 +1,260 @@
+// phitex: Converts images into Phi texture containers (.phtex)
+// Usage:
+//   phitex [--bc3] output.phtex input.png                 2D texture (flipped vertically, like Texture2D)
+//   phitex [--bc3] --cubemap output.phtex right.png left.png top.png bottom.png front.png back.png
+//
+// Every mip level is generated with a 2x2 box filter, and optionally compressed to BC3 (DXT5)
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <phi/texturefile.hpp>
+
+using Phi::TextureFile;
+
+// RGBA8 image
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    inline const unsigned char* At(int x, int y) const
+    {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return &pixels[((size_t)y * width + x) * 4];
+    };
+};
+
+// Loads an image as RGBA8, optionally flipped so the first row is the bottom one
+static bool LoadImage(const std::string& path, bool flip, Image& image)
+{
+    int channelCount;
+    stbi_set_flip_vertically_on_load(flip);
+    unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &channelCount, STBI_rgb_alpha);
+    if (!data)
+    {
+        std::cout << "ERROR: Couldn't load file: " << path << std::endl;
+        return false;
+    }
+
+    image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+    stbi_image_free(data);
+    return true;
+}
+
+// Halves an image with a 2x2 box filter, odd edges repeat their last row / column
+static Image Downsample(const Image& source)
+{
+    Image result;
+    result.width = std::max(source.width / 2, 1);
+    result.height = std::max(source.height / 2, 1);
+    result.pixels.resize((size_t)result.width * result.height * 4);
+
+    for (int y = 0; y < result.height; y++)
+    {
+        for (int x = 0; x < result.width; x++)
+        {
+            const unsigned char* p[4] = {source.At(x * 2, y * 2), source.At(x * 2 + 1, y * 2),
+                                         source.At(x * 2, y * 2 + 1), source.At(x * 2 + 1, y * 2 + 1)};
+            for (int c = 0; c < 4; c++)
+            {
+                result.pixels[((size_t)y * result.width + x) * 4 + c] = (unsigned char)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+// Packs a color into RGB565
+static uint16_t To565(const unsigned char* color)
+{
+    return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+// Expands RGB565 back to 8 bits per channel
+static void From565(uint16_t packed, int* color)
+{
+    color[0] = ((packed >> 11) & 31) * 255 / 31;
+    color[1] = ((packed >> 5) & 63) * 255 / 63;
+    color[2] = (packed & 31) * 255 / 31;
+}
+
+// Compresses one 4x4 block to BC3: an interpolated alpha block followed by a BC1 color block
+// Endpoints are the (slightly inset) bounds of the block's colors, every pixel picks the nearest palette entry
+static void CompressBlock(const unsigned char block[16][4], unsigned char* out)
+{
+    // Alpha: 8 value mode (alpha0 > alpha1), 3 bit indices
+    int minA = 255, maxA = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        minA = std::min(minA, (int)block[i][3]);
+        maxA = std::max(maxA, (int)block[i][3]);
+    }
+
+    out[0] = (unsigned char)maxA;
+    out[1] = (unsigned char)minA;
+    uint64_t alphaBits = 0;
+    if (maxA > minA)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            // Palette order is a0, a1, then 6 values from a0 towards a1
+            int step = ((maxA - block[i][3]) * 7 + (maxA - minA) / 2) / (maxA - minA);
+            int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            alphaBits |= (uint64_t)index << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(alphaBits >> (i * 8));
+
+    // Color: bounding box endpoints inset by 1/16 to reduce error
+    int minC[3] = {255, 255, 255}, maxC[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minC[c] = std::min(minC[c], (int)block[i][c]);
+            maxC[c] = std::max(maxC[c], (int)block[i][c]);
+        }
+    }
+    unsigned char c0[3], c1[3];
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (maxC[c] - minC[c]) / 16;
+        c0[c] = (unsigned char)(maxC[c] - inset);
+        c1[c] = (unsigned char)(minC[c] + inset);
+    }
+
+    uint16_t color0 = To565(c0);
+    uint16_t color1 = To565(c1);
+
+    // BC3 always decodes 4 colors, but keep color0 >= color1 like BC1's 4 color mode
+    if (color0 < color1) std::swap(color0, color1);
+
+    int palette[4][3];
+    From565(color0, palette[0]);
+    From565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t colorBits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = INT32_MAX;
+        for (int p = 0; p < 4; p++)
+        {
+            int error = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int d = block[i][c] - palette[p][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                best = p;
+                bestError = error;
+            }
+        }
+        colorBits |= (uint32_t)best << (i * 2);
+    }
+
+    out[8] = (unsigned char)(color0 & 0xFF);
+    out[9] = (unsigned char)(color0 >> 8);
+    out[10] = (unsigned char)(color1 & 0xFF);
+    out[11] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++) out[12 + i] = (unsigned char)(colorBits >> (i * 8));
+}
+
+// Encodes a level in the requested format
+static std::vector<unsigned char> Encode(const Image& image, TextureFile::Format format)
+{
+    if (format == TextureFile::Format::RGBA8) return image.pixels;
+
+    std::vector<unsigned char> result(TextureFile::GetLevelSize(format, image.width, image.height));
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            // Blocks past the edge repeat the last row / column
+            unsigned char block[16][4];
+            for (int i = 0; i < 16; i++)
+            {
+                memcpy(block[i], image.At(bx * 4 + i % 4, by * 4 + i / 4), 4);
+            }
+            CompressBlock(block, &result[((size_t)by * blocksX + bx) * 16]);
+        }
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    TextureFile::Format format = TextureFile::Format::RGBA8;
+    bool cubemap = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bc3") format = TextureFile::Format::BC3;
+        else if (arg == "--cubemap") cubemap = true;
+        else paths.push_back(arg);
+    }
+
+    size_t faceCount = cubemap ? 6 : 1;
+    if (paths.size() != faceCount + 1)
+    {
+        std::cout << "Usage: phitex [--bc3] output.phtex input.png" << std::endl;
+        std::cout << "       phitex [--bc3] --cubemap output.phtex right.png left.png top.png bottom.png front.png back.png" << std::endl;
+        return 1;
+    }
+
+    // Load every face, 2D textures are flipped to match Texture2D
+    std::vector<Image> faces(faceCount);
+    for (size_t i = 0; i < faceCount; i++)
+    {
+        if (!LoadImage(paths[i + 1], !cubemap, faces[i])) return 1;
+        if (faces[i].width != faces[0].width || faces[i].height != faces[0].height)
+        {
+            std::cout << "ERROR: Cubemap faces differ in size" << std::endl;
+            return 1;
+        }
+    }
+
+    TextureFile::Header header;
+    header.format = format;
+    header.width = faces[0].width;
+    header.height = faces[0].height;
+    header.faceCount = (uint32_t)faceCount;
+    header.levelCount = 1;
+    while (std::max(header.width, header.height) >> header.levelCount) header.levelCount++;
+
+    // Levels are stored by level, then face
+    std::vector<std::vector<unsigned char>> levels;
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        for (Image& face : faces)
+        {
+            if (level > 0) face = Downsample(face);
+            levels.push_back(Encode(face, format));
+        }
+    }
+
+    if (!TextureFile::Write(paths[0], header, levels)) return 1;
+
+    std::cout << paths[0] << ": " << header.width << "x" << header.height << ", " << faceCount << " face(s), "
+              << header.levelCount << " levels" << (format == TextureFile::Format::BC3 ? ", BC3" : "") << std::endl;
+    return 0;
+}